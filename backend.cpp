@@ -0,0 +1,180 @@
+#include "backend.h"
+#include "btrfsioctl.h"
+
+#include <QDataStream>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QSaveFile>
+
+// Written at the start of every capture file, followed by the version of its layout
+static const quint32 captureMagic = 0x42414350;
+static const quint32 captureVersion = 1;
+
+static QDataStream &operator<<(QDataStream &stream, const BtrfsFilesystem &filesystem) {
+    return stream << filesystem.uuid << filesystem.label << filesystem.devices << filesystem.mountpoint << filesystem.features
+                  << filesystem.dataTotal << filesystem.dataUsed << filesystem.metadataTotal << filesystem.metadataUsed
+                  << filesystem.systemTotal << filesystem.systemUsed;
+}
+
+static QDataStream &operator>>(QDataStream &stream, BtrfsFilesystem &filesystem) {
+    return stream >> filesystem.uuid >> filesystem.label >> filesystem.devices >> filesystem.mountpoint >> filesystem.features >>
+           filesystem.dataTotal >> filesystem.dataUsed >> filesystem.metadataTotal >> filesystem.metadataUsed >> filesystem.systemTotal >>
+           filesystem.systemUsed;
+}
+
+static QByteArray encodeFilesystems(const QVector<BtrfsFilesystem> &filesystems) {
+    QByteArray data;
+    QDataStream stream(&data, QIODevice::WriteOnly);
+    stream << filesystems;
+    return data;
+}
+
+static QVector<BtrfsFilesystem> decodeFilesystems(const QByteArray &data) {
+    QVector<BtrfsFilesystem> filesystems;
+    QDataStream stream(data);
+    stream >> filesystems;
+    return filesystems;
+}
+
+// The probe finds more filesystems, so the two lists are captured apart
+static QString filesystemsKey(bool probeUnmounted) { return probeUnmounted ? "filesystems:unmounted" : "filesystems"; }
+
+/*
+ *
+ * SystemBackend
+ *
+ */
+
+QByteArray SystemBackend::run(const QString &command) {
+    QProcess proc;
+    proc.start("/bin/bash", QStringList() << "-c" << command);
+    proc.waitForFinished(1000 * 60);
+    return proc.readAllStandardOutput();
+}
+
+QByteArray SystemBackend::readFile(const QString &path) {
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+QVector<BtrfsFilesystem> SystemBackend::filesystems(bool probeUnmounted) { return discoverFilesystems(probeUnmounted); }
+
+quint64 SystemBackend::generation(const QString &mountpoint) { return readGeneration(mountpoint); }
+
+quint64 SystemBackend::committedGeneration(const QString &mountpoint) { return readCommittedGeneration(mountpoint); }
+
+/*
+ *
+ * RecordingBackend
+ *
+ */
+
+RecordingBackend::~RecordingBackend() {
+    delete backend;
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        qWarning() << "Failed to write the capture" << path << ":" << file.errorString();
+        return;
+    }
+
+    QDataStream stream(&file);
+    stream << captureMagic << captureVersion << capture;
+    if (!file.commit())
+        qWarning() << "Failed to write the capture" << path << ":" << file.errorString();
+}
+
+QByteArray RecordingBackend::record(const QString &key, const QByteArray &value) {
+    // The last answer is kept when the same thing is read more than once, replaying it shows the final state
+    QMutexLocker locker(&mutex);
+    capture.insert(key, value);
+    return value;
+}
+
+QByteArray RecordingBackend::run(const QString &command) { return record("run:" + command, backend->run(command)); }
+
+QByteArray RecordingBackend::readFile(const QString &path) { return record("file:" + path, backend->readFile(path)); }
+
+QVector<BtrfsFilesystem> RecordingBackend::filesystems(bool probeUnmounted) {
+    const QVector<BtrfsFilesystem> filesystems = backend->filesystems(probeUnmounted);
+    record(filesystemsKey(probeUnmounted), encodeFilesystems(filesystems));
+    return filesystems;
+}
+
+quint64 RecordingBackend::generation(const QString &mountpoint) {
+    const quint64 generation = backend->generation(mountpoint);
+    record("generation:" + mountpoint, QByteArray::number(generation));
+    return generation;
+}
+
+quint64 RecordingBackend::committedGeneration(const QString &mountpoint) {
+    const quint64 generation = backend->committedGeneration(mountpoint);
+    record("committed:" + mountpoint, QByteArray::number(generation));
+    return generation;
+}
+
+/*
+ *
+ * ReplayBackend
+ *
+ */
+
+bool ReplayBackend::load(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    quint32 magic = 0;
+    quint32 version = 0;
+    stream >> magic >> version;
+    if (magic != captureMagic || version != captureVersion)
+        return false;
+
+    stream >> capture;
+    return stream.status() == QDataStream::Ok;
+}
+
+QByteArray ReplayBackend::lookup(const QString &key) const {
+    const auto it = capture.constFind(key);
+    if (it == capture.constEnd()) {
+        qWarning() << "Not in the capture:" << key;
+        return QByteArray();
+    }
+
+    return *it;
+}
+
+QByteArray ReplayBackend::run(const QString &command) { return lookup("run:" + command); }
+
+QByteArray ReplayBackend::readFile(const QString &path) { return lookup("file:" + path); }
+
+QVector<BtrfsFilesystem> ReplayBackend::filesystems(bool probeUnmounted) {
+    return decodeFilesystems(lookup(filesystemsKey(probeUnmounted)));
+}
+
+quint64 ReplayBackend::generation(const QString &mountpoint) { return lookup("generation:" + mountpoint).toULongLong(); }
+
+quint64 ReplayBackend::committedGeneration(const QString &mountpoint) { return lookup("committed:" + mountpoint).toULongLong(); }
+
+Backend *createBackend() {
+    const QString replay = qEnvironmentVariable("BTRFS_ASSISTANT_REPLAY");
+    if (!replay.isEmpty()) {
+        auto *backend = new ReplayBackend;
+        if (backend->load(replay))
+            return backend;
+
+        qWarning() << "Failed to read the capture" << replay << ", using the system instead";
+        delete backend;
+    }
+
+    const QString record = qEnvironmentVariable("BTRFS_ASSISTANT_RECORD");
+    if (!record.isEmpty())
+        return new RecordingBackend(new SystemBackend, record);
+
+    return new SystemBackend;
+}
@@ -0,0 +1,90 @@
+#ifndef BACKEND_H
+#define BACKEND_H
+
+#include "btrfsdiscovery.h"
+
+#include <QByteArray>
+#include <QHash>
+#include <QMutex>
+#include <QString>
+#include <QVector>
+
+// Where the application reads the state of the system from: the output of commands, files, the btrfs filesystems and
+// their generations.
+//
+// The SystemBackend reads the real system.  A RecordingBackend passes everything through to another backend and saves
+// what was read to a capture file when it is destroyed, and a ReplayBackend answers from such a capture without touching
+// the system.  A capture taken on a machine with a problem, such as a huge subvolume list or a filesystem in the middle of
+// a profile conversion, can so be loaded on another one to reproduce what the parsers do with it.
+//
+// The methods may be called from several threads at once.  Anything which changes the system doesn't go through here
+class Backend {
+  public:
+    virtual ~Backend() = default;
+
+    // Returns the stdout of the bash command @p command
+    virtual QByteArray run(const QString &command) = 0;
+    // Returns the contents of @p path, or an empty array if it can't be read
+    virtual QByteArray readFile(const QString &path) = 0;
+    // Returns the btrfs filesystems, with @p probeUnmounted also the ones which aren't mounted, see discoverFilesystems()
+    virtual QVector<BtrfsFilesystem> filesystems(bool probeUnmounted) = 0;
+    // Returns the generation of the filesystem mounted at @p mountpoint, see readGeneration()
+    virtual quint64 generation(const QString &mountpoint) = 0;
+    // Returns the generation of the last committed transaction, see readCommittedGeneration()
+    virtual quint64 committedGeneration(const QString &mountpoint) = 0;
+};
+
+class SystemBackend : public Backend {
+  public:
+    QByteArray run(const QString &command) override;
+    QByteArray readFile(const QString &path) override;
+    QVector<BtrfsFilesystem> filesystems(bool probeUnmounted) override;
+    quint64 generation(const QString &mountpoint) override;
+    quint64 committedGeneration(const QString &mountpoint) override;
+};
+
+// A capture is a map from what was asked for to the bytes that were returned
+class RecordingBackend : public Backend {
+  public:
+    // Takes ownership of @p backend and writes the capture to @p path when destroyed
+    RecordingBackend(Backend *backend, const QString &path) : backend(backend), path(path) {}
+    ~RecordingBackend();
+
+    QByteArray run(const QString &command) override;
+    QByteArray readFile(const QString &path) override;
+    QVector<BtrfsFilesystem> filesystems(bool probeUnmounted) override;
+    quint64 generation(const QString &mountpoint) override;
+    quint64 committedGeneration(const QString &mountpoint) override;
+
+  private:
+    QByteArray record(const QString &key, const QByteArray &value);
+
+    Backend *backend;
+    const QString path;
+    QMutex mutex;
+    QHash<QString, QByteArray> capture;
+};
+
+// Anything which isn't in the capture reads as empty, which is what a failed command or a missing file returns too
+class ReplayBackend : public Backend {
+  public:
+    // Reads the capture @p path.  Returns false if it isn't a capture
+    bool load(const QString &path);
+
+    QByteArray run(const QString &command) override;
+    QByteArray readFile(const QString &path) override;
+    QVector<BtrfsFilesystem> filesystems(bool probeUnmounted) override;
+    quint64 generation(const QString &mountpoint) override;
+    quint64 committedGeneration(const QString &mountpoint) override;
+
+  private:
+    QByteArray lookup(const QString &key) const;
+
+    QHash<QString, QByteArray> capture;
+};
+
+// Returns the backend the application uses.  That is a SystemBackend unless the environment variable
+// BTRFS_ASSISTANT_REPLAY names a capture to replay or BTRFS_ASSISTANT_RECORD one to record
+Backend *createBackend();
+
+#endif // BACKEND_H
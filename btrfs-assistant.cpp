@@ -1,7 +1,30 @@
 #include "btrfs-assistant.h"
 #include "config.h"
+#include "helperapi.h"
+#include "tokenizer.h"
 #include "ui_btrfs-assistant.h"
+#include <QDBusArgument>
 #include <QDebug>
+#include <QDialog>
+#include <QDialogButtonBox>
+#include <QElapsedTimer>
+#include <QEventLoop>
+#include <QFileDialog>
+#include <QFileSystemModel>
+#include <QFormLayout>
+#include <QFutureWatcher>
+#include <QLabel>
+#include <QPlainTextEdit>
+#include <QPushButton>
+#include <QSplitter>
+#include <QStatusBar>
+#include <QTreeView>
+#include <QtConcurrent>
+
+#include <numeric>
+#include <optional>
+
+#include <unistd.h>
 
 /*
  *
@@ -19,6 +42,21 @@ static bool askSnapshotBoot(const QString &subvol) {
                                      QObject::tr("Would you like to restore it?")) == QMessageBox::Yes;
 }
 
+// Replaces the process with the application run as root through pkexec
+static void relaunchAsRoot(bool skipSnapshotPrompt) {
+    auto args = QCoreApplication::arguments();
+    QString cmd = "pkexec btrfs-assistant";
+    cmd += " --xdg-desktop \"" + qEnvironmentVariable("XDG_CURRENT_DESKTOP", "") + "\"";
+    if (skipSnapshotPrompt)
+        cmd += " --skip-snapshot-prompt";
+
+    for (const QString &arg : args)
+        cmd += " " + arg;
+    cmd += "; true";
+    execlp("sh", "sh", "-c", cmd.toUtf8().constData(), NULL);
+    QApplication::exit(1);
+}
+
 // Util function for getting bash command output and error code
 static const Result runCmd(const QString &cmd, bool includeStderr, int timeout = 60) {
     QProcess proc;
@@ -32,6 +70,20 @@ static const Result runCmd(const QString &cmd, bool includeStderr, int timeout =
     return {proc.exitCode(), proc.readAllStandardOutput().trimmed()};
 }
 
+// Returns @p userdata, in the key=value, key=value form of snapper list, with @p key set to @p value or removed when
+// @p value is empty
+static QString mergeUserdata(const QString &userdata, const QString &key, const QString &value) {
+    QStringList pairs;
+    for (const QString &pair : userdata.split(", ")) {
+        if (!pair.isEmpty() && pair.section('=', 0, 0) != key)
+            pairs.append(pair);
+    }
+    if (!value.isEmpty())
+        pairs.append(key + "=" + value);
+
+    return pairs.join(", ");
+}
+
 // An overloaded version that takes a list so multiple commands can be executed at once
 static const Result runCmd(const QStringList &cmdList, bool includeStderr, int timeout = 60) {
     QString fullCommand;
@@ -46,30 +98,24 @@ static const Result runCmd(const QStringList &cmdList, bool includeStderr, int t
     return runCmd(fullCommand, includeStderr, timeout);
 }
 
-// Returns a list of btrfs filesystems
-static const QStringList getBTRFSFilesystems() {
-    return runCmd("btrfs filesystem show -m | grep uuid | awk -F':' '{gsub(/ /,\"\");print $3}'", false).output.split('\n');
-}
+// Describes @p filesystem for the tooltip of the device selection
+static QString filesystemToolTip(const BtrfsFilesystem &filesystem) {
+    QStringList lines;
+    lines.append(filesystem.label.isEmpty() ? QObject::tr("No label") : QObject::tr("Label: %1").arg(filesystem.label));
+    lines.append(QObject::tr("Devices: %1").arg(filesystem.devices.join(", ")));
+    lines.append(QObject::tr("Mounted at: %1").arg(filesystem.mountpoint));
+    if (!filesystem.features.isEmpty())
+        lines.append(QObject::tr("Features: %1").arg(filesystem.features.join(", ")));
 
-// Returns one of the mountpoints for a given UUID
-static const QString findMountpoint(const QString &uuid) {
-    return runCmd("findmnt --real -rno target,uuid | grep " + uuid + " | head -n 1 | awk '{print $1}'", false).output;
+    return lines.join('\n');
 }
 
-// Finds the direct children of a given subvolid
-static const QStringList findBtrfsChildren(const QString &subvolid, const QString &uuid) {
-    QString output = runCmd("sudo btrfs subvolume list / | awk '{print $7, $9}' | grep " + subvolid, false).output;
-    if (output.isEmpty())
-        return QStringList();
-
+// Returns the paths of the subvolumes directly inside the subvolume @p subvolid of @p btrfs
+static const QStringList findBtrfsChildren(const QString &subvolid, const Btrfs &btrfs) {
     QStringList subvols;
-    const QStringList outputList = output.split('\n');
-    for (const QString &subvolEntry : outputList) {
-        if (subvolEntry.isEmpty())
-            continue;
-
-        if (subvolEntry.split(' ').at(0).trimmed() == subvolid)
-            subvols.append(subvolEntry.split(' ').at(1).trimmed());
+    for (auto it = btrfs.subvolParents.constBegin(); it != btrfs.subvolParents.constEnd(); ++it) {
+        if (it.value() == subvolid)
+            subvols.append(btrfs.subVolumes.value(it.key()));
     }
 
     return subvols;
@@ -112,6 +158,23 @@ static const QString toHumanReadable(double number) {
     return QString::number(number) + " " + units[i];
 }
 
+// Returns how much more data fits into the unallocated space of the devices of @p btrfs and sets @p profile to the data
+// profile it is allocated with.  New chunks use the profile with the most space, during a conversion that is the target
+static quint64 allocatableData(const Btrfs &btrfs, QString &profile, quint64 &stranded) {
+    const BtrfsProfileUsage *data = nullptr;
+    for (const BtrfsProfileUsage &usage : btrfs.profiles) {
+        if (usage.type == "Data" && (data == nullptr || usage.size > data->size))
+            data = &usage;
+    }
+
+    QVector<quint64> unallocated;
+    for (const BtrfsDeviceUsage &device : btrfs.devices)
+        unallocated.append(device.unallocated);
+
+    profile = data == nullptr ? "single" : data->profile;
+    return allocatableSpace(raidProfile(profile), unallocated, stranded);
+}
+
 // Returns the list of subvolume mountpoints
 static const QStringList gatherBtrfsMountpoints() {
     QStringList mountpoints;
@@ -133,69 +196,110 @@ static const QStringList gatherBtrfsMountpoints() {
     return mountpoints;
 }
 
-// Finds the mountpoint of a given btrfs volume.  If it isn't mounted, it will first mount it.
-// returns the mountpoint or a default constructed string if it fails
-static const QString mountRoot(const QString &uuid) {
-    // Check to see if it is already mounted
-    QStringList findmntOutput = runCmd("findmnt -nO subvolid=5 -o uuid,target | head -n 1", false).output.split('\n');
-    QString mountpoint;
-    for (const QString &line : qAsConst(findmntOutput)) {
-        if (line.split(' ').at(0).trimmed() == uuid)
-            mountpoint = line.split(' ').at(1).trimmed();
-    }
-
-    // If it isn't mounted we need to mount it
-    if (mountpoint.isEmpty()) {
-        // Format a temp mountpoint using a GUID
-        mountpoint = QDir::cleanPath(QDir::tempPath() + QDir::separator() + QUuid::createUuid().toString());
-
-        // Create the mountpoint and mount the volume if successful
-        QDir tempMount;
-        if (tempMount.mkpath(mountpoint))
-            runCmd("mount -t btrfs -o subvolid=5 UUID=" + uuid + " " + mountpoint, false);
-        else
-            return QString();
-    }
-
-    return mountpoint;
-}
-
 // Returns true if a given subvolume is a timeshift snapshot
 static bool isTimeshift(const QString &subvolume) { return subvolume.contains("timeshift-btrfs"); }
 
 // Returns true if a given subvolume is a snapper snapshot
 static bool isSnapper(const QString &subvolume) { return subvolume.contains(".snapshots") && !subvolume.endsWith(".snapshots"); }
 
+// Returns the subvolume the snapper snapshot @p subvolume is restored to, the one its .snapshots directory belongs to
+static QString restoreTarget(const QString &subvolume) {
+    const QString prefix = subvolume.split(".snapshots").at(0);
+
+    // If the prefix is empty, that means that we are trying to restore the subvolume mounted as /
+    if (prefix.isEmpty())
+        return findRootSubvol();
+
+    // Strip the trailing /
+    return prefix.left(prefix.length() - 1);
+}
+
 // Returns true if a given btrfs subvolume is mounted
 static bool isMounted(const QString &uuid, const QString &subvolid) {
     return uuid == runCmd("findmnt -nO subvolid=" + subvolid.trimmed() + " -o uuid | head -n 1", false).output.trimmed();
 }
 
-// Renames a btrfs subvolume from source to target.  Both should be absolute paths
-static bool renameSubvolume(const QString &source, const QString &target) {
-    QDir dir;
-    return dir.rename(source, target);
+// Returns the snapper snapshots of the filesystem @p uuid mounted at @p target along with their metadata.  The metadata is
+// read from @p backend through @p topLevel, a mount of the top level subvolume, which is mounted if it is empty
+static QVector<SnapperSubvolume> findSnapperSubvolumes(Backend &backend, MountManager &mounts, const QString &uuid, const QString &target,
+                                                       QString topLevel) {
+    QVector<SnapperSubvolume> snapshots;
+    const QVector<BtrfsSubvolume> subvolumes = listSubvolumes(target);
+    for (const BtrfsSubvolume &subvolume : subvolumes) {
+        if (isSnapper(subvolume.path))
+            snapshots.append({subvolume.path, QString::number(subvolume.id), {}, {}, uuid, {}, {}});
+    }
+
+    if (snapshots.isEmpty())
+        return snapshots;
+
+    // The top level is only mounted here while the info.xml files are read
+    std::optional<TopLevelMount> mount;
+    if (topLevel.isEmpty()) {
+        mount.emplace(mounts, uuid);
+        topLevel = mount->path();
+    }
+
+    // The info.xml files are read in parallel, reading them one at a time is most of the time spent here on a slow disk
+    QVector<SnapperSnapshots> metadata(snapshots.size());
+    QVector<int> indexes(snapshots.size());
+    std::iota(indexes.begin(), indexes.end(), 0);
+    QtConcurrent::blockingMap(indexes, [&backend, &snapshots, &metadata, &topLevel](int i) {
+        const QString &subvol = snapshots.at(i).subvol;
+        const QString snapshotDir = subvol.left(subvol.length() - QString("snapshot").length());
+        metadata[i] = parseSnapperInfo(backend.readFile(QDir::cleanPath(topLevel + "/" + snapshotDir + "info.xml")));
+    });
+
+    QVector<SnapperSubvolume> result;
+    for (int i = 0; i < snapshots.size(); i++) {
+        if (metadata.at(i).number == 0)
+            continue;
+
+        SnapperSubvolume subvol = snapshots.at(i);
+        subvol.desc = metadata.at(i).desc;
+        subvol.time = metadata.at(i).time;
+        subvol.type = metadata.at(i).type;
+        subvol.userdata = metadata.at(i).userdata;
+        result.append(subvol);
+    }
+
+    return result;
 }
 
-// Read a snapper snapshot meta file and return the data
-static SnapperSnapshots getSnapperMeta(const QString &filename) {
-    SnapperSnapshots snap;
-    snap.number = 0;
-    QFile metaFile(filename);
-    if (!metaFile.open(QIODevice::ReadOnly | QIODevice::Text))
-        return snap;
+// Returns the exclusive size of each snapshot of the snapper config for @p subvolume, keyed by snapshot number.  The sizes
+// are only available when quotas are enabled, in which case qgroup 0/<subvolid> tracks each snapshot
+static QHash<int, qint64> readExclusiveSizes(Backend &backend, const QString &subvolume) {
+    QHash<int, qint64> sizes;
+    const QByteArray qgroupOutput = backend.run("btrfs qgroup show --raw " + subvolume);
+    if (qgroupOutput.isEmpty())
+        return sizes;
+
+    QHash<QString, qint64> exclusive;
+    LineTokenizer qgroupLines(qgroupOutput);
+    std::string_view line;
+    while (qgroupLines.next(line)) {
+        const std::string_view qgroup = word(line, 0);
+        if (qgroup.starts_with("0/"))
+            exclusive[toQString(qgroup.substr(2))] = toLong(word(line, 2));
+    }
 
-    while (!metaFile.atEnd()) {
-        QString line = metaFile.readLine();
-        if (line.trimmed().startsWith("<num>"))
-            snap.number = line.trimmed().split("<num>").at(1).split("</num>").at(0).trimmed().toInt();
-        else if (line.trimmed().startsWith("<date>"))
-            snap.time = line.trimmed().split("<date>").at(1).split("</date>").at(0).trimmed();
-        else if (line.trimmed().startsWith("<description>"))
-            snap.desc = line.trimmed().split("<description>").at(1).split("</description>").at(0).trimmed();
+    // Map the subvolids back to snapshot numbers using the paths of the subvolumes under .snapshots
+    const QByteArray listOutput = backend.run("btrfs subvolume list -o " + QDir::cleanPath(subvolume + "/.snapshots"));
+    LineTokenizer listLines(listOutput);
+    while (listLines.next(line)) {
+        const std::string_view path = wordsFrom(line, 8);
+        const std::string_view snapshotsDir = ".snapshots/";
+        const size_t pos = path.find(snapshotsDir);
+        if (pos == std::string_view::npos)
+            continue;
+
+        const int number = static_cast<int>(toLong(field(path.substr(pos + snapshotsDir.size()), '/', 0)));
+        const QString subvolid = toQString(word(line, 1));
+        if (number > 0 && exclusive.contains(subvolid))
+            sizes[number] = exclusive.value(subvolid);
     }
 
-    return snap;
+    return sizes;
 }
 
 // Selects all rows in @p listWidget that match an item in @p items
@@ -210,65 +314,13 @@ static void setListWidgetSelections(const QStringList &items, QListWidget *listW
     }
 }
 
-/*
- *
- * QSettings read/write functions
- *
- */
-
-// Called by QSetting to read the contents of the Btrfs maintenance config file.
-// Populates @p with all the keys and values from the file.  Also populates map
-// with a key named "raw" that contains the original contents
-bool readBmFile(QIODevice &device, QSettings::SettingsMap &map) {
-    QStringList rawList;
-    while (!device.atEnd()) {
-        QString line = device.readLine();
-        rawList.append(line);
-        if (!line.trimmed().isEmpty() && !line.trimmed().startsWith("#")) {
-            const QStringList lineList = line.simplified().trimmed().split("=");
-            map.insert(lineList.at(0).trimmed(), lineList.at(1).trimmed().remove("\""));
-        }
-    }
-
-    map.insert("raw", rawList);
-
-    return true;
-}
-
-// Called by QSetting to write the contents of the Btrfs maintenance config file.
-// Reads the contents of the "raw" key in map and writes a new file based on it
-// and the other key, value pairs in @p map.
-bool writeBmFile(QIODevice &device, const QSettings::SettingsMap &map) {
-    QByteArray data;
-
-    if (!map.contains("raw")) {
-        return false;
-    }
-
-    const QStringList rawList = map.value("raw").toStringList();
-    for (const QString &line : rawList) {
-        if (line.trimmed().startsWith("#")) {
-            data += line.toUtf8();
-        } else {
-            const QString key = line.simplified().split("=").at(0).trimmed();
-            if (map.contains(key)) {
-                data += key.toUtf8() + "=\"" + map.value(key).toString().toUtf8() + "\"\n";
-            }
-        }
-    }
-
-    device.write(data);
-
-    return true;
-}
-
 /*
  *
  * BtrfsAssistant functions
  *
  */
 
-BtrfsAssistant::BtrfsAssistant(QWidget *parent) : QMainWindow(parent), ui(new Ui::BtrfsAssistant) {
+BtrfsAssistant::BtrfsAssistant(QWidget *parent) : QMainWindow(parent), backend(createBackend()), ui(new Ui::BtrfsAssistant) {
     ui->setupUi(this);
 
     this->setWindowTitle(tr("BTRFS Assistant"));
@@ -283,30 +335,89 @@ bool BtrfsAssistant::setup(bool skipSnapshotPrompt, bool snapBootAutostart) {
     bool restoreSnapshotSelected = skipSnapshotPrompt;
     auto sbResult = getSnapshotBoot();
 
-    // If the application wasn't luanched with root access, relaunch it
-    if (runCmd("id -u", false).output != "0") {
+    // If the application wasn't launched with root access, relaunch it as root or, when asked to, keep running as the user
+    if (geteuid() != 0) {
         // If the application is autostarted because of a snapshot boot has been detected,
         // we should ask the user if they want to restore the snapshot or not *before* we ask for root
         if (snapBootAutostart && (!isSnapBoot || !(restoreSnapshotSelected = askSnapshotBoot(sbResult.value("subvol")))))
             return false;
 
-        auto args = QCoreApplication::arguments();
-        QString cmd = "pkexec btrfs-assistant";
-        cmd += " --xdg-desktop \"" + qEnvironmentVariable("XDG_CURRENT_DESKTOP", "") + "\"";
-        if (restoreSnapshotSelected)
-            cmd += " --skip-snapshot-prompt";
-
-        for (const QString &arg : args)
-            cmd += " " + arg;
-        cmd += "; true";
-        execlp("sh", "sh", "-c", cmd.toUtf8().constData(), NULL);
-        QApplication::exit(1);
-        return false;
+        // The restore of the autostart doesn't need the rest of the UI, the helper does it without relaunching.  The full UI
+        // runs as root unless the user chose to run it unprivileged through the helper, which only offers some operations
+        helper.reset(new HelperClient);
+        if (helper->isAvailable() && snapBootAutostart) {
+            // No window is shown, the events are only processed until the restore has been answered
+            QDBusPendingCallWatcher *restore = restoreSnapshotWithHelper(*helper, sbResult.value("uuid"), sbResult.value("subvol"));
+            if (restore != nullptr) {
+                QEventLoop loop;
+                connect(restore, &QDBusPendingCallWatcher::finished, &loop, &QEventLoop::quit);
+                loop.exec();
+            }
+            return false;
+        }
+        if (!settings->value("unprivileged", false).toBool() || !helper->isAvailable()) {
+            helper.reset();
+            relaunchAsRoot(restoreSnapshotSelected);
+            return false;
+        }
     }
 
+    // Load the undo history before anything destructive can happen, a retention of 0 turns it off.  The history is kept by
+    // root, the helper doesn't offer anything which could be undone
+    undoRetention = helper ? 0 : settings->value("undo_retention_hours", 24).toLongLong() * 60 * 60;
+    if (undoRetention > 0 && !undoJournal.load())
+        qWarning() << "Failed to read the undo history, nothing is recorded in it until it is fixed or removed";
+
     if (isSnapBoot && !skipSnapshotPrompt)
         restoreSnapshotSelected = askSnapshotBoot(sbResult.value("subvol"));
 
+    // On a system booted off a snapshot the user asked to restore, restore it before anything else is loaded.  The restore
+    // only reads the subvolumes of the filesystem the snapshot is on, the rest of the UI is loaded once the event loop runs
+    if (isSnapBoot && restoreSnapshotSelected) {
+        restoreSnapshot(sbResult.value("uuid"), sbResult.value("subvol"));
+        QTimer::singleShot(0, this, [this] {
+            setupInterface();
+            if (!helper)
+                switchToSnapperRestore();
+        });
+        return true;
+    }
+
+    setupInterface();
+    if (isSnapBoot && !helper)
+        switchToSnapperRestore();
+
+    return true;
+}
+
+// Connects the signals and loads the data of every tab
+void BtrfsAssistant::setupInterface() {
+    // Keep the unit checkboxes in sync with systemd and report the outcome of applying changes to them.  A checkbox stays
+    // disabled until the state of its unit has arrived, and one the user changed keeps their choice until it is applied
+    systemdUnits = new SystemdUnits(this);
+    const QList<QCheckBox *> unitBoxes = unitCheckBoxes();
+    for (QCheckBox *checkbox : unitBoxes) {
+        checkbox->setEnabled(false);
+        connect(checkbox, &QCheckBox::clicked, this, [this, checkbox] { changedCheckBoxes.insert(checkbox); });
+    }
+    connect(systemdUnits, &SystemdUnits::unitStateChanged, this, [this](const QString &unit, bool enabled) {
+        const QList<QCheckBox *> checkboxes = unitCheckBoxes();
+        for (QCheckBox *checkbox : checkboxes) {
+            if (checkbox->property("actionData").toString() != unit)
+                continue;
+
+            checkbox->setEnabled(true);
+            if (!changedCheckBoxes.contains(checkbox))
+                checkbox->setChecked(enabled);
+        }
+    });
+    connect(systemdUnits, &SystemdUnits::applyFinished, this, [](const QStringList &errors) {
+        if (errors.isEmpty())
+            QMessageBox::information(0, tr("BTRFS Assistant"), tr("Changes applied successfully"));
+        else
+            displayError(tr("Failed to apply systemd changes:") + "\n\n" + errors.join('\n'));
+    });
+
     // Save the state of snapper and btrfsmaintenance being installed since we have to check them so often
     QString snapperPath = settings->value("snapper", "/usr/bin/snapper").toString();
     hasSnapper = QFile::exists(snapperPath);
@@ -322,6 +433,24 @@ bool BtrfsAssistant::setup(bool skipSnapshotPrompt, bool snapBootAutostart) {
         ui->groupBox_snapper_config_edit->hide();
     }
 
+    // Rerun the retention preview whenever one of the limits changes
+    const QList<QSpinBox *> retentionSpinBoxes = {ui->spinBox_snapper_hourly,  ui->spinBox_snapper_daily,  ui->spinBox_snapper_weekly,
+                                                  ui->spinBox_snapper_monthly, ui->spinBox_snapper_yearly, ui->spinBox_snapper_pacman};
+    for (QSpinBox *spinBox : retentionSpinBoxes)
+        connect(spinBox, QOverload<int>::of(&QSpinBox::valueChanged), this, &BtrfsAssistant::updateRetentionPreview);
+
+    // Poll the device error counters of the selected filesystem, the ioctls involved are cheap enough to run on a timer.  An
+    // interval of 0 or less turns polling off, a value which isn't a number falls back to the default and the upper bound
+    // keeps the milliseconds within an int
+    devStatsTimer = new QTimer(this);
+    connect(devStatsTimer, &QTimer::timeout, this, [this] { populateDeviceHealth(ui->comboBox_btrfsdevice->currentText()); });
+    bool validInterval = false;
+    int devStatsInterval = settings->value("devstats_interval", 60).toInt(&validInterval);
+    if (!validInterval)
+        devStatsInterval = 60;
+    if (devStatsInterval > 0)
+        devStatsTimer->start(qMin(devStatsInterval, 24 * 60 * 60) * 1000);
+
     // Populate the UI
     refreshInterface();
     loadBTRFS();
@@ -331,90 +460,130 @@ bool BtrfsAssistant::setup(bool skipSnapshotPrompt, bool snapBootAutostart) {
     populateSnapperGrid();
     populateSnapperConfigSettings();
     ui->pushButton_restore_snapshot->setEnabled(false);
+    ui->pushButton_undo->setVisible(undoRetention > 0);
+    pruneUndoJournal();
+    if (helper)
+        disableRootOnly();
 
     if (hasBtrfsmaintenance) {
-        bmFormat = QSettings::registerFormat("btrfsmaintenance", readBmFile, writeBmFile);
-        bmSettings = new QSettings(btrfsmaintenanceConfig, bmFormat);
+        // Saving settings read from an unreadable file would replace it with only the keys shown in the tab
+        if (!bmConfig.load(btrfsmaintenanceConfig)) {
+            ui->pushButton_bmApply->setEnabled(false);
+            ui->pushButton_bmApply->setToolTip(tr("%1 could not be read").arg(btrfsmaintenanceConfig));
+        }
         populateBmTab();
     } else {
         // Hide the btrfs maintenance tab
         ui->tabWidget->setTabVisible(ui->tabWidget->indexOf(ui->tab_btrfsmaintenance), false);
     }
+}
 
-    if (isSnapBoot) {
-        switchToSnapperRestore();
-        if (restoreSnapshotSelected)
-            restoreSnapshot(sbResult.value("uuid"), sbResult.value("subvol"));
+// Disables the parts of the UI which need root but aren't offered by the helper and says so in the status bar, along with a
+// button which restarts the application as root with all of them
+void BtrfsAssistant::disableRootOnly() {
+    const QList<QWidget *> widgets = {ui->pushButton_scanextents,       ui->pushButton_dedupe,
+                                      ui->pushButton_deletesubvol,      ui->checkBox_snapper_restore,
+                                      ui->pushButton_snapper_edit,      ui->pushButton_snapper_browse,
+                                      ui->pushButton_snapper_replicate, ui->pushButton_snapper_timeline,
+                                      ui->pushButton_snapper_new_config, ui->pushButton_snapper_delete_config,
+                                      ui->pushButton_snapper_save_config, ui->pushButton_bmApply};
+    for (QWidget *widget : widgets) {
+        widget->setEnabled(false);
+        widget->setToolTip(tr("Restart as root to use this"));
     }
 
-    return true;
+    QPushButton *restart = new QPushButton(tr("Restart as Root"));
+    connect(restart, &QPushButton::clicked, this, [] { relaunchAsRoot(false); });
+    statusBar()->addWidget(new QLabel(tr("Running without root: deleting subvolumes, restore mode, the scans, the snapper config "
+                                         "and btrfsmaintenance changes and the undo history are unavailable")));
+    statusBar()->addPermanentWidget(restart);
 }
 
-// Populates servicesEnabledSet with a list of enabled services
-void BtrfsAssistant::loadEnabledUnits() {
-    this->unitsEnabledSet.clear();
-
-    QString bashOutput = runCmd("systemctl list-unit-files --state=enabled -q --no-pager | awk '{print $1}'", false).output;
-    QStringList serviceList = bashOutput.split('\n');
-    this->unitsEnabledSet = QSet<QString>(serviceList.begin(), serviceList.end());
+// Returns the checkboxes which are bound to a systemd unit through their actionData property
+QList<QCheckBox *> BtrfsAssistant::unitCheckBoxes() {
+    QList<QCheckBox *> unitBoxes;
+    const QList<QCheckBox *> checkboxes =
+        ui->scrollArea_bm->findChildren<QCheckBox *>() + ui->groupBox_snapperUnits->findChildren<QCheckBox *>();
+    for (QCheckBox *checkbox : checkboxes) {
+        if (checkbox->property("actionType") == "service")
+            unitBoxes.append(checkbox);
+    }
 
-    return;
+    return unitBoxes;
 }
 
 // Updates the checkboxes and comboboxes with values from the system
 void BtrfsAssistant::refreshInterface() {
-    loadEnabledUnits();
-
-    // Loop through the checkboxes
-    const QList<QCheckBox *> checkboxes =
-        ui->scrollArea_bm->findChildren<QCheckBox *>() + ui->groupBox_snapperUnits->findChildren<QCheckBox *>();
-    for (QCheckBox *checkbox : checkboxes) {
-        if (checkbox->property("actionType") == "service") {
-            checkbox->setChecked(this->unitsEnabledSet.contains(checkbox->property("actionData").toString()));
-        }
+    // Only the units which are bound to a checkbox are queried, the checkboxes are updated as the replies arrive
+    QStringList units;
+    const QList<QCheckBox *> checkboxes = unitCheckBoxes();
+    for (const QCheckBox *checkbox : checkboxes) {
+        units.append(checkbox->property("actionData").toString());
     }
+
+    systemdUnits->setUnits(units);
 }
 
 // Populates the btrfs fsMap with statistics from the btrfs filesystems
 void BtrfsAssistant::loadBTRFS() {
-    fsMap.clear();
+    // Filesystems which haven't changed since they were last read are kept as they are
+    QMap<QString, Btrfs> previous;
+    previous.swap(fsMap);
     ui->comboBox_btrfsdevice->clear();
 
-    QStringList uuidList = getBTRFSFilesystems();
-
-    for (const QString &uuid : qAsConst(uuidList)) {
-        QString mountpoint = findMountpoint(uuid);
+    const QVector<BtrfsFilesystem> filesystems = backend->filesystems(false);
+    for (const BtrfsFilesystem &filesystem : filesystems) {
+        const QString &uuid = filesystem.uuid;
+        const QString &mountpoint = filesystem.mountpoint;
         if (!mountpoint.isEmpty()) {
+            ui->comboBox_btrfsdevice->addItem(uuid);
+            ui->comboBox_btrfsdevice->setItemData(ui->comboBox_btrfsdevice->count() - 1, filesystemToolTip(filesystem), Qt::ToolTipRole);
+
+            const quint64 generation = backend->generation(mountpoint);
+            if (previous.contains(uuid) && previous[uuid].mountPoint == mountpoint && isCurrent(previous[uuid].usageStamp, generation)) {
+                fsMap[uuid] = previous.take(uuid);
+                continue;
+            }
+
+            // The subvolumes are checked on their own when the list is reloaded
             Btrfs btrfs = {};
+            if (previous.contains(uuid)) {
+                btrfs.subVolumes = previous[uuid].subVolumes;
+                btrfs.subvolParents = previous[uuid].subvolParents;
+                btrfs.subvolStamp = previous[uuid].subvolStamp;
+                btrfs.usageStamp = previous[uuid].usageStamp;
+            }
+            const quint64 committed = backend->committedGeneration(mountpoint);
             btrfs.mountPoint = mountpoint;
-            QStringList usageLines = runCmd("LANG=C ; btrfs fi usage -b " + mountpoint, false).output.split('\n');
-            for (const QString &line : qAsConst(usageLines)) {
-                QString type = line.split(':').at(0).trimmed();
-                if (type == "Device size") {
-                    btrfs.totalSize = line.split(':').at(1).trimmed().toLong();
-                } else if (type == "Device allocated") {
-                    btrfs.allocatedSize = line.split(':').at(1).trimmed().toLong();
-                } else if (type == "Used") {
-                    btrfs.usedSize = line.split(':').at(1).trimmed().toLong();
-                } else if (type == "Free (estimated)") {
-                    btrfs.freeSize = line.split(':').at(1).split(QRegExp("\\s+"), Qt::SkipEmptyParts).at(0).trimmed().toLong();
-                } else if (type.startsWith("Data,")) {
-                    btrfs.dataSize = line.split(':').at(2).split(',').at(0).trimmed().toLong();
-                    btrfs.dataUsed = line.split(':').at(3).split(' ').at(0).trimmed().toLong();
-                } else if (type.startsWith("Metadata,")) {
-                    btrfs.metaSize = line.split(':').at(2).split(',').at(0).trimmed().toLong();
-                    btrfs.metaUsed = line.split(':').at(3).split(' ').at(0).trimmed().toLong();
-                } else if (type.startsWith("System,")) {
-                    btrfs.sysSize = line.split(':').at(2).split(',').at(0).trimmed().toLong();
-                    btrfs.sysUsed = line.split(':').at(3).split(' ').at(0).trimmed().toLong();
-                }
+            if (helper) {
+                // The usage and its stamp are filled in once the reply arrives, polkit may be asking for a password first
+                auto *watcher = new QDBusPendingCallWatcher(helper->usage(mountpoint), this);
+                connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, watcher, uuid, mountpoint, generation, committed] {
+                    watcher->deleteLater();
+                    QDBusPendingReply<QVariantMap> reply = *watcher;
+                    if (reply.isError()) {
+                        qWarning() << "Failed to read the usage of" << mountpoint << ":" << reply.error().message();
+                        return;
+                    }
+                    if (!fsMap.contains(uuid) || fsMap[uuid].mountPoint != mountpoint)
+                        return;
+
+                    usageFromVariant(reply.value(), fsMap[uuid]);
+                    updateStamp(fsMap[uuid].usageStamp, generation, committed);
+                    if (ui->comboBox_btrfsdevice->currentText() == uuid)
+                        populateBtrfsUi(uuid);
+                });
+            } else {
+                updateStamp(btrfs.usageStamp, generation, committed);
+                parseFilesystemUsage(backend->run("LANG=C ; btrfs fi usage -b " + mountpoint), btrfs);
             }
             fsMap[uuid] = btrfs;
-            ui->comboBox_btrfsdevice->addItem(uuid);
         }
     }
 
-    populateBtrfsUi(ui->comboBox_btrfsdevice->currentText());
+    // A filesystem whose usage the helper hasn't answered yet is shown when the reply arrives
+    if (fsMap.value(ui->comboBox_btrfsdevice->currentText()).totalSize != 0)
+        populateBtrfsUi(ui->comboBox_btrfsdevice->currentText());
     reloadSubvolList(ui->comboBox_btrfsdevice->currentText());
 }
 
@@ -431,7 +600,13 @@ void BtrfsAssistant::populateBtrfsUi(const QString &uuid) {
     ui->label_btrfsused->setText(toHumanReadable(fsMap[uuid].usedSize));
     ui->label_btrfssize->setText(toHumanReadable(fsMap[uuid].totalSize));
     ui->label_btrfsfree->setText(toHumanReadable(fsMap[uuid].freeSize));
-    float freePercent = (double)fsMap[uuid].allocatedSize / fsMap[uuid].totalSize;
+
+    // Judge the space by what data can still be written, including what the data profile can allocate from the unallocated
+    // space.  The raw allocation alone is misleading for RAID profiles and devices of mixed sizes
+    QString profile;
+    quint64 stranded = 0;
+    const quint64 allocatable = allocatableData(fsMap[uuid], profile, stranded);
+    float freePercent = (double)fsMap[uuid].dataUsed / (fsMap[uuid].dataSize + allocatable);
     if (freePercent < 0.70) {
         ui->label_btrfsmessage->setText(tr("You have lots of free space, did you overbuy?"));
     } else if (freePercent > 0.95) {
@@ -439,6 +614,174 @@ void BtrfsAssistant::populateBtrfsUi(const QString &uuid) {
     } else {
         ui->label_btrfsmessage->setText(tr("Your disk space is well utilized"));
     }
+
+    populateChunkMap(uuid);
+    populateDeviceUsage(uuid);
+    populateDeviceHealth(uuid);
+}
+
+// Shows the chunk map of @p uuid.  The chunk tree is only walked again once the generation has moved, and then on a worker
+// thread since it can take a while on a large filesystem.  The previous map stays up until the new one is read
+void BtrfsAssistant::populateChunkMap(const QString &uuid) {
+    ui->widget_chunkmap->setChunkMap(chunkMaps.value(uuid));
+    if (!fsMap.contains(uuid) || chunkMapsLoading.contains(uuid))
+        return;
+
+    const QString mountpoint = fsMap[uuid].mountPoint;
+    const quint64 generation = backend->generation(mountpoint);
+    if (chunkMaps.contains(uuid) && isCurrent(chunkMapStamps.value(uuid), generation))
+        return;
+
+    const quint64 committed = backend->committedGeneration(mountpoint);
+    chunkMapsLoading.insert(uuid);
+    auto *watcher = new QFutureWatcher<BtrfsChunkMap>(this);
+    connect(watcher, &QFutureWatcher<BtrfsChunkMap>::finished, this, [this, watcher, uuid, generation, committed] {
+        watcher->deleteLater();
+        chunkMapsLoading.remove(uuid);
+        chunkMaps[uuid] = watcher->result();
+        updateStamp(chunkMapStamps[uuid], generation, committed);
+        if (ui->comboBox_btrfsdevice->currentText() == uuid)
+            ui->widget_chunkmap->setChunkMap(chunkMaps[uuid]);
+    });
+    watcher->setFuture(QtConcurrent::run([mountpoint] {
+        // Reading the chunk tree needs root.  The device sizes are filled in before the tree is searched, so a failed read
+        // is replaced by an empty map which the widget shows as having no chunk information rather than as empty devices
+        BtrfsChunkMap map;
+        if (!readChunkMap(mountpoint, map))
+            return BtrfsChunkMap();
+        return map;
+    }));
+}
+
+// Populates the usage panel with the allocation of each profile on each device and how much more data fits
+void BtrfsAssistant::populateDeviceUsage(const QString &uuid) {
+    QTableWidget *table = ui->tableWidget_btrfsusage;
+    table->clear();
+    table->setRowCount(0);
+    ui->label_btrfsusable->clear();
+
+    if (!fsMap.contains(uuid))
+        return;
+
+    const Btrfs &btrfs = fsMap[uuid];
+    QStringList headers = {tr("Device"), tr("Size"), tr("Unallocated")};
+    for (const BtrfsProfileUsage &profile : btrfs.profiles)
+        headers.append(profile.type + "," + profile.profile);
+    table->setColumnCount(headers.size());
+    table->setHorizontalHeaderLabels(headers);
+
+    // The last row holds the logical size and use of each profile
+    table->setRowCount(btrfs.devices.size() + 1);
+    int row = 0;
+    for (auto it = btrfs.devices.constBegin(); it != btrfs.devices.constEnd(); ++it, ++row) {
+        table->setItem(row, 0, new QTableWidgetItem(it.key()));
+        table->setItem(row, 1, new QTableWidgetItem(toHumanReadable(it.value().allocated + it.value().unallocated)));
+        table->setItem(row, 2, new QTableWidgetItem(toHumanReadable(it.value().unallocated)));
+        for (int i = 0; i < btrfs.profiles.size(); i++)
+            table->setItem(row, i + 3, new QTableWidgetItem(toHumanReadable(btrfs.profiles.at(i).devices.value(it.key()))));
+    }
+
+    table->setItem(row, 0, new QTableWidgetItem(tr("Used / Size")));
+    for (int i = 0; i < btrfs.profiles.size(); i++) {
+        const BtrfsProfileUsage &profile = btrfs.profiles.at(i);
+        table->setItem(row, i + 3, new QTableWidgetItem(toHumanReadable(profile.used) + " / " + toHumanReadable(profile.size)));
+    }
+    table->resizeColumnsToContents();
+
+    if (btrfs.profiles.isEmpty())
+        return;
+
+    QString profile;
+    quint64 stranded = 0;
+    const quint64 allocatable = allocatableData(btrfs, profile, stranded);
+    QString message = tr("%1 more data fits using the %2 profile, %3 in allocated chunks and %4 in unallocated space")
+                          .arg(toHumanReadable(allocatable + btrfs.dataSize - btrfs.dataUsed))
+                          .arg(profile)
+                          .arg(toHumanReadable(btrfs.dataSize - btrfs.dataUsed))
+                          .arg(toHumanReadable(allocatable));
+    if (stranded >= 1024 * 1024 * 1024)
+        message += "\n" + tr("%1 of unallocated space can't be used by %2 with these devices, add a device or rebalance to use it")
+                              .arg(toHumanReadable(stranded))
+                              .arg(profile);
+    ui->label_btrfsusable->setText(message);
+}
+
+// Populates the device health panel with the kernel error counters and the last scrub result of each device.
+// Counters which have increased since the previous poll are highlighted
+void BtrfsAssistant::populateDeviceHealth(const QString &uuid) {
+    QTableWidget *table = ui->tableWidget_devstats;
+    table->clear();
+    table->setColumnCount(7);
+    table->setHorizontalHeaderItem(0, new QTableWidgetItem(tr("Device")));
+    table->setHorizontalHeaderItem(1, new QTableWidgetItem(tr("Write Errors")));
+    table->setHorizontalHeaderItem(2, new QTableWidgetItem(tr("Read Errors")));
+    table->setHorizontalHeaderItem(3, new QTableWidgetItem(tr("Flush Errors")));
+    table->setHorizontalHeaderItem(4, new QTableWidgetItem(tr("Corruption Errors")));
+    table->setHorizontalHeaderItem(5, new QTableWidgetItem(tr("Generation Errors")));
+    table->setHorizontalHeaderItem(6, new QTableWidgetItem(tr("Scrub Errors")));
+    table->setRowCount(0);
+    ui->label_scrubstatus->clear();
+
+    if (!fsMap.contains(uuid))
+        return;
+
+    const QVector<BtrfsDevStats> devices = readDevStats(fsMap[uuid].mountPoint);
+    QHash<quint64, BtrfsScrubStatus> scrubByDevice;
+    const QVector<BtrfsScrubStatus> scrubStatus = readScrubStatus(uuid);
+    for (const BtrfsScrubStatus &status : scrubStatus)
+        scrubByDevice[status.devid] = status;
+
+    // Devices seen for the first time have nothing to compare against so they never show a delta
+    const QHash<quint64, BtrfsDevStats> previous = lastDevStats.value(uuid);
+    QHash<quint64, BtrfsDevStats> current;
+
+    table->setRowCount(devices.size());
+    for (int i = 0; i < devices.size(); i++) {
+        const BtrfsDevStats &device = devices.at(i);
+        current[device.devid] = device;
+        table->setItem(i, 0, new QTableWidgetItem(device.path));
+
+        const QVector<quint64> counters = {device.writeErrors, device.readErrors, device.flushErrors, device.corruptionErrors,
+                                           device.generationErrors};
+        QVector<quint64> previousCounters = counters;
+        if (previous.contains(device.devid)) {
+            const BtrfsDevStats &old = previous.value(device.devid);
+            previousCounters = {old.writeErrors, old.readErrors, old.flushErrors, old.corruptionErrors, old.generationErrors};
+        }
+
+        for (int j = 0; j < counters.size(); j++) {
+            QTableWidgetItem *item = new QTableWidgetItem(QString::number(counters.at(j)));
+            if (counters.at(j) > previousCounters.at(j)) {
+                item->setText(item->text() + " (+" + QString::number(counters.at(j) - previousCounters.at(j)) + ")");
+                item->setBackground(QColor(255, 0, 0, 80));
+            } else if (counters.at(j) > 0) {
+                item->setForeground(Qt::red);
+            }
+            table->setItem(i, j + 1, item);
+        }
+
+        const BtrfsScrubStatus scrub = scrubByDevice.value(device.devid);
+        const quint64 scrubErrors = scrub.readErrors + scrub.csumErrors + scrub.verifyErrors + scrub.superErrors;
+        QTableWidgetItem *scrubItem = new QTableWidgetItem(QString::number(scrubErrors));
+        if (scrub.uncorrectableErrors > 0)
+            scrubItem->setBackground(QColor(255, 0, 0, 80));
+        scrubItem->setToolTip(tr("Corrected: %1, Uncorrectable: %2").arg(scrub.correctedErrors).arg(scrub.uncorrectableErrors));
+        table->setItem(i, 6, scrubItem);
+    }
+    table->resizeColumnsToContents();
+
+    lastDevStats[uuid] = current;
+
+    if (scrubStatus.isEmpty()) {
+        ui->label_scrubstatus->setText(tr("This filesystem has never been scrubbed"));
+    } else {
+        const BtrfsScrubStatus &scrub = scrubStatus.first();
+        const QString started = QLocale().toString(QDateTime::fromSecsSinceEpoch(scrub.startTime), QLocale::ShortFormat);
+        ui->label_scrubstatus->setText((scrub.finished ? tr("Last scrub finished, started at %1, took %2 seconds")
+                                                       : tr("Last scrub did not finish, started at %1, ran for %2 seconds"))
+                                           .arg(started)
+                                           .arg(scrub.duration));
+    }
 }
 
 void BtrfsAssistant::on_pushButton_load_clicked() {
@@ -465,38 +808,75 @@ void BtrfsAssistant::reloadSubvolList(const QString &uuid) {
     if (!fsMap.contains(uuid))
         return;
 
-    fsMap[uuid].subVolumes.clear();
+    loadSubvolumes(uuid);
+    populateSubvolList(uuid);
+}
 
-    QString mountpoint = findMountpoint(uuid);
+// Loads the subvolumes of the filesystem @p uuid and the subvolume each of them is directly inside of
+void BtrfsAssistant::loadSubvolumes(const QString &uuid) {
+    const QString mountpoint = fsMap[uuid].mountPoint.isEmpty() ? findBtrfsMountpoint(uuid) : fsMap[uuid].mountPoint;
+    const quint64 generation = backend->generation(mountpoint);
+    if (isCurrent(fsMap[uuid].subvolStamp, generation))
+        return;
+    const quint64 committed = backend->committedGeneration(mountpoint);
+
+    // Through the helper the list is updated and shown again once the reply arrives
+    if (helper) {
+        auto *watcher = new QDBusPendingCallWatcher(helper->listSubvolumes(mountpoint), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, watcher, uuid, generation, committed] {
+            watcher->deleteLater();
+            QDBusPendingReply<QVariantList> reply = *watcher;
+            if (reply.isError()) {
+                displayError(tr("Failed to read the subvolumes") + "\n\n" + reply.error().message());
+                return;
+            }
+            if (!fsMap.contains(uuid))
+                return;
+
+            QMap<QString, QString> subvols;
+            QMap<QString, QString> parents;
+            const QVariantList list = reply.value();
+            for (const QVariant &value : list) {
+                const QVariantMap subvolume = qdbus_cast<QVariantMap>(value);
+                const QString id = subvolume.value("id").toString();
+                subvols[id] = subvolume.value("path").toString();
+                parents[id] = subvolume.value("parent").toString();
+            }
 
-    QStringList output = runCmd("btrfs subvolume list " + mountpoint, false).output.split('\n');
-    QMap<QString, QString> subvols;
-    for (const QString &line : qAsConst(output)) {
-        if (!line.isEmpty())
-            subvols[line.split(' ').at(1)] = line.split(' ').at(8);
+            fsMap[uuid].subVolumes = subvols;
+            fsMap[uuid].subvolParents = parents;
+            updateStamp(fsMap[uuid].subvolStamp, generation, committed);
+            if (ui->comboBox_btrfsdevice->currentText() == uuid)
+                populateSubvolList(uuid);
+        });
+        return;
     }
 
-    fsMap[uuid].subVolumes = subvols;
+    QMap<QString, QString> subvols;
+    QMap<QString, QString> parents;
+    parseSubvolumeList(backend->run("btrfs subvolume list " + mountpoint), subvols, parents);
 
-    populateSubvolList(uuid);
+    fsMap[uuid].subVolumes = subvols;
+    fsMap[uuid].subvolParents = parents;
+    updateStamp(fsMap[uuid].subvolStamp, generation, committed);
 }
 
 // Populate the btrfsmaintenance tab using the settings loaded from the config file
 void BtrfsAssistant::populateBmTab() {
     ui->comboBox_bmBalanceFreq->clear();
     ui->comboBox_bmBalanceFreq->insertItems(0, bmFreqValues);
-    ui->comboBox_bmBalanceFreq->setCurrentText(bmSettings->value("BTRFS_BALANCE_PERIOD").toString());
+    ui->comboBox_bmBalanceFreq->setCurrentText(bmConfig.value("BTRFS_BALANCE_PERIOD"));
     ui->comboBox_bmScrubFreq->clear();
     ui->comboBox_bmScrubFreq->insertItems(0, bmFreqValues);
-    ui->comboBox_bmScrubFreq->setCurrentText(bmSettings->value("BTRFS_SCRUB_PERIOD").toString());
+    ui->comboBox_bmScrubFreq->setCurrentText(bmConfig.value("BTRFS_SCRUB_PERIOD"));
     ui->comboBox_bmDefragFreq->clear();
     ui->comboBox_bmDefragFreq->insertItems(0, bmFreqValues);
-    ui->comboBox_bmDefragFreq->setCurrentText(bmSettings->value("BTRFS_DEFRAG_PERIOD").toString());
+    ui->comboBox_bmDefragFreq->setCurrentText(bmConfig.value("BTRFS_DEFRAG_PERIOD"));
 
     const QStringList mountpoints = gatherBtrfsMountpoints();
     ui->listWidget_bmBalance->clear();
     ui->listWidget_bmBalance->insertItems(0, mountpoints);
-    QStringList balanceMounts = bmSettings->value("BTRFS_BALANCE_MOUNTPOINTS").toString().trimmed().split(":");
+    QStringList balanceMounts = bmConfig.value("BTRFS_BALANCE_MOUNTPOINTS").trimmed().split(":");
     if (balanceMounts.contains("auto")) {
         ui->checkBox_bmBalance->setChecked(true);
         ui->listWidget_bmBalance->setDisabled(true);
@@ -506,7 +886,7 @@ void BtrfsAssistant::populateBmTab() {
     }
     ui->listWidget_bmScrub->clear();
     ui->listWidget_bmScrub->insertItems(0, mountpoints);
-    QStringList scrubMounts = bmSettings->value("BTRFS_SCRUB_MOUNTPOINTS").toString().trimmed().split(":");
+    QStringList scrubMounts = bmConfig.value("BTRFS_SCRUB_MOUNTPOINTS").trimmed().split(":");
     if (scrubMounts.contains("auto")) {
         ui->checkBox_bmScrub->setChecked(true);
         ui->listWidget_bmScrub->setDisabled(true);
@@ -516,7 +896,7 @@ void BtrfsAssistant::populateBmTab() {
     }
     ui->listWidget_bmDefrag->clear();
     ui->listWidget_bmDefrag->insertItems(0, mountpoints);
-    QStringList defragMounts = bmSettings->value("BTRFS_DEFRAG_PATHS").toString().trimmed().split(":");
+    QStringList defragMounts = bmConfig.value("BTRFS_DEFRAG_PATHS").trimmed().split(":");
     if (defragMounts.contains("auto")) {
         ui->checkBox_bmDefrag->setChecked(true);
         ui->listWidget_bmDefrag->setDisabled(true);
@@ -539,6 +919,10 @@ void BtrfsAssistant::populateSubvolList(const QString &uuid) {
 
     while (i.hasNext()) {
         i.next();
+        // The safety snapshots of the undo history are managed by the undo history alone
+        if (isSafetySnapshot(i.value()))
+            continue;
+
         if (includeSnaps || !(isTimeshift(i.value()) || isSnapper(i.value())))
             ui->listWidget_subvols->addItem(i.value());
     }
@@ -553,21 +937,25 @@ void BtrfsAssistant::on_checkBox_bmScrub_clicked(bool checked) { ui->listWidget_
 
 void BtrfsAssistant::on_checkBox_bmDefrag_clicked(bool checked) { ui->listWidget_bmDefrag->setDisabled(checked); }
 
+// Applies the enabled state of each checkbox in @p checkboxList to the unit it is bound to.  This returns immediately,
+// the result is reported when systemdUnits emits applyFinished
 void BtrfsAssistant::updateServices(QList<QCheckBox *> checkboxList) {
-    QStringList cmdList;
+    QStringList enable;
+    QStringList disable;
 
     for (auto checkbox : checkboxList) {
+        // The checkbox follows systemd again once it is applied, units whose state hasn't arrived are left alone
+        changedCheckBoxes.remove(checkbox);
         QString service = checkbox->property("actionData").toString();
-        if (service != "" && unitsEnabledSet.contains(service) != checkbox->isChecked()) {
+        if (service != "" && systemdUnits->hasState(service) && systemdUnits->isEnabled(service) != checkbox->isChecked()) {
             if (checkbox->isChecked())
-                cmdList.append("systemctl enable --now " + service);
+                enable.append(service);
             else
-                cmdList.append("systemctl disable --now " + service);
+                disable.append(service);
         }
     }
 
-    runCmd(cmdList, false);
-    loadEnabledUnits();
+    systemdUnits->apply(enable, disable);
 }
 
 void BtrfsAssistant::on_pushButton_bmApply_clicked() {
@@ -576,46 +964,46 @@ void BtrfsAssistant::on_pushButton_bmApply_clicked() {
     updateServices(ui->scrollArea_bm->findChildren<QCheckBox *>());
 
     // Read and set the Btrfs maintenance settings
-    bmSettings->setValue("BTRFS_BALANCE_PERIOD", ui->comboBox_bmBalanceFreq->currentText());
-    bmSettings->setValue("BTRFS_SCRUB_PERIOD", ui->comboBox_bmScrubFreq->currentText());
-    bmSettings->setValue("BTRFS_DEFRAG_PERIOD", ui->comboBox_bmDefragFreq->currentText());
+    bmConfig.setValue("BTRFS_BALANCE_PERIOD", ui->comboBox_bmBalanceFreq->currentText());
+    bmConfig.setValue("BTRFS_SCRUB_PERIOD", ui->comboBox_bmScrubFreq->currentText());
+    bmConfig.setValue("BTRFS_DEFRAG_PERIOD", ui->comboBox_bmDefragFreq->currentText());
 
     if (ui->checkBox_bmBalance->isChecked()) {
-        bmSettings->setValue("BTRFS_BALANCE_MOUNTPOINTS", "auto");
+        bmConfig.setValue("BTRFS_BALANCE_MOUNTPOINTS", "auto");
     } else {
         const QList<QListWidgetItem *> balanceItems = ui->listWidget_bmBalance->selectedItems();
         QStringList balancePaths;
         for (const QListWidgetItem *item : balanceItems) {
             balancePaths.append(item->text());
         }
-        bmSettings->setValue("BTRFS_BALANCE_MOUNTPOINTS", balancePaths.join(":"));
+        bmConfig.setValue("BTRFS_BALANCE_MOUNTPOINTS", balancePaths.join(":"));
     }
 
     if (ui->checkBox_bmScrub->isChecked()) {
-        bmSettings->setValue("BTRFS_SCRUB_MOUNTPOINTS", "auto");
+        bmConfig.setValue("BTRFS_SCRUB_MOUNTPOINTS", "auto");
     } else {
         const QList<QListWidgetItem *> scrubItems = ui->listWidget_bmScrub->selectedItems();
         QStringList scrubPaths;
         for (const QListWidgetItem *item : scrubItems) {
             scrubPaths.append(item->text());
         }
-        bmSettings->setValue("BTRFS_SCRUB_MOUNTPOINTS", scrubPaths.join(":"));
+        bmConfig.setValue("BTRFS_SCRUB_MOUNTPOINTS", scrubPaths.join(":"));
     }
 
     if (ui->checkBox_bmDefrag->isChecked()) {
-        bmSettings->setValue("BTRFS_DEFRAG_PATHS", "auto");
+        bmConfig.setValue("BTRFS_DEFRAG_PATHS", "auto");
     } else {
         const QList<QListWidgetItem *> defragItems = ui->listWidget_bmDefrag->selectedItems();
         QStringList defragPaths;
         for (const QListWidgetItem *item : defragItems) {
             defragPaths.append(item->text());
         }
-        bmSettings->setValue("BTRFS_DEFRAG_PATHS", defragPaths.join(":"));
+        bmConfig.setValue("BTRFS_DEFRAG_PATHS", defragPaths.join(":"));
     }
 
-    bmSettings->sync();
-
-    QMessageBox::information(0, tr("BTRFS Assistant"), tr("Changes applied successfully"));
+    QString error;
+    if (!bmConfig.save(btrfsmaintenanceConfig, error))
+        displayError(tr("Failed to save %1: %2").arg(btrfsmaintenanceConfig).arg(error));
 
     ui->pushButton_bmApply->clearFocus();
 }
@@ -624,8 +1012,6 @@ void BtrfsAssistant::on_pushButton_SnapperUnitsApply_clicked() {
 
     updateServices(ui->groupBox_snapperUnits->findChildren<QCheckBox *>());
 
-    QMessageBox::information(0, tr("BTRFS Assistant"), tr("Changes applied successfully"));
-
     ui->pushButton_SnapperUnitsApply->clearFocus();
 }
 
@@ -665,25 +1051,360 @@ void BtrfsAssistant::on_pushButton_deletesubvol_clicked() {
         return;
     } else {
         // Everything looks good so far, now we put up a confirmation box
-        if (QMessageBox::question(0, tr("Confirm"), tr("Are you sure you want to delete ") + subvol) != QMessageBox::Yes)
+        QString question = tr("Are you sure you want to delete ") + subvol;
+        if (undoRetention > 0)
+            question += "\n\n" + tr("The delete can be undone from the undo history for %1 hours.  The space the subvolume takes "
+                                     "up isn't freed until then")
+                                      .arg(undoRetention / 3600);
+        if (QMessageBox::question(0, tr("Confirm"), question) != QMessageBox::Yes)
+            return;
+
+        const TopLevelMount topLevel(topLevelMounts, uuid);
+        if (!topLevel.isValid()) {
+            displayError(tr("Failed to mount the filesystem"));
             return;
+        }
 
-        QString mountpoint = mountRoot(uuid);
+        // Keep a read-only snapshot of the subvolume first, it takes no space until the subvolume is gone
+        qint64 undoId = 0;
+        QString error;
+        if (undoRetention > 0) {
+            if (undoJournal.recordSubvolumeDelete(topLevel.path(), uuid, subvol, error))
+                undoId = undoJournal.entries().last().id;
+            else if (QMessageBox::question(0, tr("Confirm"),
+                                           tr("The delete can't be undone:") + "\n\n" + error + "\n\n" + tr("Delete it anyway?")) !=
+                     QMessageBox::Yes)
+                return;
+        }
 
         // Everything checks out, lets delete the subvol
+        QString mountpoint = topLevel.path();
         if (mountpoint.right(1) != "/")
             mountpoint += "/";
         result = runCmd("btrfs subvolume delete " + mountpoint + subvol, true);
+        if (result.exitCode != 0 && undoId != 0)
+            undoJournal.discard(undoId, topLevel.path());
     }
 
     if (result.exitCode == 0) {
         reloadSubvolList(uuid);
+        pruneUndoJournal();
     } else
         displayError(tr("Process failed with output:") + "\n\n");
 
     ui->pushButton_deletesubvol->clearFocus();
 }
 
+// Deletes the safety snapshots of the operations which can't be undone anymore on a background thread
+void BtrfsAssistant::pruneUndoJournal() {
+    // The timer of btrfs-assistant-helper prunes the journal too, the entries are read again for what it has left
+    if (undoRetention <= 0 || !undoJournal.load())
+        return;
+
+    // An entry is only removed once its snapshots are being deleted, those of a filesystem which can't be mounted now are
+    // kept for the next time
+    QList<qint64> pruned;
+    const QVector<UndoEntry> expired = undoJournal.expired(undoRetention);
+    for (const UndoEntry &entry : expired) {
+        // The top level stays mounted until the snapshots are deleted
+        auto topLevel = QSharedPointer<TopLevelMount>::create(topLevelMounts, entry.uuid);
+        if (!topLevel->isValid())
+            continue;
+
+        const QString mountpoint = topLevel->path();
+        auto *watcher = new QFutureWatcher<void>(this);
+        connect(watcher, &QFutureWatcher<void>::finished, this, [watcher, topLevel] { watcher->deleteLater(); });
+        watcher->setFuture(QtConcurrent::run([mountpoint, entry] { pruneSafetySnapshots(mountpoint, entry); }));
+        pruned.append(entry.id);
+    }
+
+    undoJournal.remove(pruned);
+}
+
+// Shows the operations which can still be undone and undoes the selected one
+void BtrfsAssistant::on_pushButton_undo_clicked() {
+    ui->pushButton_undo->clearFocus();
+    pruneUndoJournal();
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Undo History"));
+    dialog.resize(800, 400);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+
+    QTableWidget *table = new QTableWidget(0, 3);
+    table->setHorizontalHeaderLabels({tr("Time"), tr("Operation"), tr("Undo Until")});
+    table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    table->setSelectionBehavior(QAbstractItemView::SelectRows);
+    table->setSelectionMode(QAbstractItemView::SingleSelection);
+    table->verticalHeader()->setVisible(false);
+    table->horizontalHeader()->setStretchLastSection(true);
+    layout->addWidget(table);
+
+    const auto fillTable = [this, table] {
+        // Newest first, the id of each operation is kept in its first column
+        const QVector<UndoEntry> &entries = undoJournal.entries();
+        table->setRowCount(entries.size());
+        for (int i = 0; i < entries.size(); i++) {
+            const UndoEntry &entry = entries.at(entries.size() - 1 - i);
+            QString description;
+            switch (entry.kind) {
+            case UndoEntry::DeleteSubvolume:
+                description = tr("Delete subvolume %1").arg(entry.subvolume);
+                break;
+            case UndoEntry::DeleteSnapperConfig:
+                description = tr("Delete snapper config %1 and its %2 snapshots").arg(entry.name).arg(entry.snapshots.size());
+                break;
+            case UndoEntry::RestoreSnapshot:
+                description = tr("Restore %1, the original was saved as %2").arg(entry.subvolume, entry.backup);
+                break;
+            }
+
+            const QDateTime time = QDateTime::fromMSecsSinceEpoch(entry.id);
+            QTableWidgetItem *timeItem = new QTableWidgetItem(time.toString(Qt::SystemLocaleShortDate));
+            timeItem->setData(Qt::UserRole, entry.id);
+            table->setItem(i, 0, timeItem);
+            table->setItem(i, 1, new QTableWidgetItem(description));
+            table->setItem(i, 2, new QTableWidgetItem(time.addSecs(undoRetention).toString(Qt::SystemLocaleShortDate)));
+        }
+        table->resizeColumnsToContents();
+    };
+    fillTable();
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close);
+    QPushButton *undoButton = buttons->addButton(tr("Undo"), QDialogButtonBox::ActionRole);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout->addWidget(buttons);
+
+    connect(undoButton, &QPushButton::clicked, &dialog, [this, &dialog, table, fillTable] {
+        const QList<QTableWidgetItem *> selected = table->selectedItems();
+        if (selected.isEmpty())
+            return;
+
+        const int row = selected.first()->row();
+        const qint64 id = table->item(row, 0)->data(Qt::UserRole).toLongLong();
+        const QString description = table->item(row, 1)->text();
+        if (QMessageBox::question(&dialog, tr("Confirm"), tr("Are you sure you want to undo: %1").arg(description)) != QMessageBox::Yes)
+            return;
+
+        QString uuid;
+        for (const UndoEntry &entry : undoJournal.entries()) {
+            if (entry.id == id)
+                uuid = entry.uuid;
+        }
+
+        const TopLevelMount topLevel(topLevelMounts, uuid);
+        QString error = tr("Failed to mount the filesystem");
+        if (!topLevel.isValid() || !undoJournal.undo(id, topLevel.path(), error)) {
+            displayError(tr("Failed to undo: %1").arg(description) + "\n\n" + error);
+            return;
+        }
+
+        fillTable();
+        reloadSubvolList(ui->comboBox_btrfsdevice->currentText());
+        loadSnapper();
+        populateSnapperGrid();
+        populateSnapperConfigSettings();
+    });
+
+    dialog.exec();
+}
+
+// Scans the extents of the selected subvolume on a background thread and shows the compression and fragmentation results
+void BtrfsAssistant::on_pushButton_scanextents_clicked() {
+    const QString uuid = ui->comboBox_btrfsdevice->currentText();
+    if (ui->listWidget_subvols->currentItem() == nullptr || uuid.isEmpty()) {
+        displayError(tr("Nothing selected!"));
+        return;
+    }
+
+    const QString subvol = ui->listWidget_subvols->currentItem()->text();
+    const QString subvolid = fsMap[uuid].subVolumes.key(subvol);
+
+    // Prefer scanning through the place the subvolume is mounted so the reported paths can be used as defrag targets
+    QString path;
+    const QStringList mounts = runCmd("findmnt -nO subvolid=" + subvolid + " -o uuid,target", false).output.split('\n');
+    for (const QString &mount : mounts) {
+        if (mount.section(' ', 0, 0) == uuid) {
+            path = mount.section(' ', 1).trimmed();
+            break;
+        }
+    }
+
+    // The top level stays mounted until the scan has finished
+    const bool pathsMounted = !path.isEmpty();
+    QSharedPointer<TopLevelMount> topLevel;
+    if (!pathsMounted) {
+        topLevel = QSharedPointer<TopLevelMount>::create(topLevelMounts, uuid);
+        if (!topLevel->isValid()) {
+            displayError(tr("Failed to mount the filesystem"));
+            return;
+        }
+        path = QDir::cleanPath(topLevel->path() + QDir::separator() + subvol);
+    }
+
+    // The scanner reports its progress through an atomic counter which is polled to update the button
+    auto scanner = QSharedPointer<ExtentScanner>::create();
+    auto *progressTimer = new QTimer(this);
+    connect(progressTimer, &QTimer::timeout, this, [this, scanner] {
+        ui->pushButton_scanextents->setText(tr("Scanning... %1 files").arg(scanner->filesScanned()));
+    });
+    progressTimer->start(250);
+    ui->pushButton_scanextents->setEnabled(false);
+
+    auto *watcher = new QFutureWatcher<ExtentScanResult>(this);
+    connect(watcher, &QFutureWatcher<ExtentScanResult>::finished, this, [this, watcher, progressTimer, subvol, pathsMounted, topLevel] {
+        progressTimer->deleteLater();
+        watcher->deleteLater();
+        ui->pushButton_scanextents->setText(tr("Scan Extents"));
+        ui->pushButton_scanextents->setEnabled(true);
+        showExtentScanResult(watcher->result(), subvol, pathsMounted);
+    });
+    watcher->setFuture(QtConcurrent::run([scanner, path] { return scanner->scan(path); }));
+
+    ui->pushButton_scanextents->clearFocus();
+}
+
+// Deduplicates the files in the selected subvolumes against each other
+void BtrfsAssistant::on_pushButton_dedupe_clicked() {
+    const QString uuid = ui->comboBox_btrfsdevice->currentText();
+    const QList<QListWidgetItem *> selected = ui->listWidget_subvols->selectedItems();
+    if (selected.isEmpty() || uuid.isEmpty()) {
+        displayError(tr("Nothing selected!"));
+        return;
+    }
+
+    QStringList subvols;
+    for (const QListWidgetItem *item : selected)
+        subvols.append(item->text());
+
+    if (QMessageBox::question(this, tr("Confirm"),
+                              tr("Identical data in the following subvolumes will be shared on disk:") + "\n\n" + subvols.join('\n') +
+                                  "\n\n" + tr("This reads every file in them and may take a long time.  Continue?")) != QMessageBox::Yes)
+        return;
+
+    // The top level stays mounted until the deduplication has finished
+    auto topLevel = QSharedPointer<TopLevelMount>::create(topLevelMounts, uuid);
+    if (!topLevel->isValid()) {
+        displayError(tr("Failed to mount the filesystem"));
+        return;
+    }
+    const QString mountpoint = topLevel->path();
+
+    // Block hashes are kept between runs so only new and modified files are read again
+    const QString statePath = "/var/lib/btrfs-assistant/dedupe-" + uuid + ".state";
+    const quint64 memoryLimit = settings->value("dedupe_memory_mb", 256).toULongLong() * 1024 * 1024;
+    auto deduplicator = QSharedPointer<Deduplicator>::create(statePath, memoryLimit);
+
+    auto *progressTimer = new QTimer(this);
+    connect(progressTimer, &QTimer::timeout, this, [this, deduplicator] {
+        ui->pushButton_dedupe->setText(tr("Deduplicating... %1 files").arg(deduplicator->filesProcessed()));
+    });
+    progressTimer->start(250);
+    ui->pushButton_dedupe->setEnabled(false);
+
+    auto *watcher = new QFutureWatcher<DedupeResult>(this);
+    connect(watcher, &QFutureWatcher<DedupeResult>::finished, this, [this, watcher, progressTimer, topLevel] {
+        progressTimer->deleteLater();
+        watcher->deleteLater();
+        ui->pushButton_dedupe->setText(tr("Deduplicate"));
+        ui->pushButton_dedupe->setEnabled(true);
+
+        const DedupeResult result = watcher->result();
+        QString message = tr("Hashed %1 files, %2 unchanged files were skipped").arg(result.filesHashed).arg(result.filesSkipped);
+        message += "\n" + tr("Found %1 duplicate blocks, %2 are now shared")
+                              .arg(result.duplicateBlocks)
+                              .arg(toHumanReadable(result.bytesDeduped));
+        if (!result.errors.isEmpty())
+            message += "\n\n" + tr("Errors:") + "\n" + result.errors.join('\n');
+        QMessageBox::information(this, tr("Deduplication Finished"), message);
+    });
+    watcher->setFuture(QtConcurrent::run([deduplicator, mountpoint, subvols] { return deduplicator->run(mountpoint, subvols); }));
+
+    ui->pushButton_dedupe->clearFocus();
+}
+
+// Shows the result of an extent scan.  When @p pathsMounted is true the most fragmented directories can be added to the
+// btrfs maintenance defrag paths
+void BtrfsAssistant::showExtentScanResult(const ExtentScanResult &result, const QString &subvol, bool pathsMounted) {
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Extent Statistics for %1").arg(subvol));
+    dialog.resize(800, 600);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+
+    layout->addWidget(new QLabel(tr("%1 files in %2 extents, fragmentation score %3%")
+                                     .arg(result.files)
+                                     .arg(result.extents)
+                                     .arg(QString::number(result.fragmentationScore() * 100, 'f', 1))));
+
+    QTableWidget *compressionTable = new QTableWidget(result.compression.size(), 5);
+    compressionTable->setHorizontalHeaderLabels({tr("Compression"), tr("Extents"), tr("Disk Size"), tr("Logical Size"), tr("Ratio")});
+    compressionTable->setEditTriggers(QAbstractItemView::NoEditTriggers);
+    compressionTable->verticalHeader()->setVisible(false);
+    int row = 0;
+    for (auto it = result.compression.constBegin(); it != result.compression.constEnd(); ++it, ++row) {
+        const CompressionStats &stats = it.value();
+        compressionTable->setItem(row, 0, new QTableWidgetItem(it.key()));
+        compressionTable->setItem(row, 1, new QTableWidgetItem(QString::number(stats.extents)));
+        compressionTable->setItem(row, 2, new QTableWidgetItem(toHumanReadable(stats.diskBytes)));
+        compressionTable->setItem(row, 3, new QTableWidgetItem(toHumanReadable(stats.logicalBytes)));
+        const double ratio = stats.logicalBytes == 0 ? 0 : static_cast<double>(stats.diskBytes) / stats.logicalBytes;
+        compressionTable->setItem(row, 4, new QTableWidgetItem(QString::number(ratio * 100, 'f', 1) + "%"));
+    }
+    compressionTable->resizeColumnsToContents();
+    layout->addWidget(compressionTable);
+
+    // The defrag candidates, directories first since those are what btrfsmaintenance takes
+    const auto fillTable = [](QTableWidget *table, const QVector<FragmentationEntry> &entries) {
+        table->setColumnCount(4);
+        table->setRowCount(entries.size());
+        table->setHorizontalHeaderLabels({tr("Path"), tr("Size"), tr("Extents"), tr("Fragments")});
+        table->setEditTriggers(QAbstractItemView::NoEditTriggers);
+        table->setSelectionBehavior(QAbstractItemView::SelectRows);
+        table->verticalHeader()->setVisible(false);
+        for (int i = 0; i < entries.size(); i++) {
+            table->setItem(i, 0, new QTableWidgetItem(entries.at(i).path));
+            table->setItem(i, 1, new QTableWidgetItem(toHumanReadable(entries.at(i).bytes)));
+            table->setItem(i, 2, new QTableWidgetItem(QString::number(entries.at(i).extents)));
+            table->setItem(i, 3, new QTableWidgetItem(QString::number(entries.at(i).fragments)));
+        }
+        table->resizeColumnsToContents();
+    };
+    QTabWidget *candidates = new QTabWidget();
+    QTableWidget *dirTable = new QTableWidget();
+    fillTable(dirTable, result.fragmentedDirs);
+    candidates->addTab(dirTable, tr("Fragmented Directories"));
+    QTableWidget *fileTable = new QTableWidget();
+    fillTable(fileTable, result.fragmentedFiles);
+    candidates->addTab(fileTable, tr("Fragmented Files"));
+    layout->addWidget(candidates);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close);
+    QPushButton *defragButton = buttons->addButton(tr("Add Selected Directories to Defrag Paths"), QDialogButtonBox::ActionRole);
+    defragButton->setEnabled(pathsMounted && hasBtrfsmaintenance);
+    if (!pathsMounted)
+        defragButton->setToolTip(tr("The subvolume is not mounted so its paths can't be used for defragmentation"));
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    connect(defragButton, &QPushButton::clicked, this, [this, dirTable] {
+        const QModelIndexList rows = dirTable->selectionModel()->selectedRows();
+        for (const QModelIndex &index : rows) {
+            const QString path = dirTable->item(index.row(), 0)->text();
+            QList<QListWidgetItem *> existing = ui->listWidget_bmDefrag->findItems(path, Qt::MatchExactly);
+            if (existing.isEmpty()) {
+                ui->listWidget_bmDefrag->addItem(path);
+                existing = ui->listWidget_bmDefrag->findItems(path, Qt::MatchExactly);
+            }
+            existing.first()->setSelected(true);
+        }
+
+        // Explicit paths only take effect when automatic selection is off
+        ui->checkBox_bmDefrag->setChecked(false);
+        ui->listWidget_bmDefrag->setDisabled(false);
+    });
+    layout->addWidget(buttons);
+
+    dialog.exec();
+}
+
 // When a change is detected on the dropdown of btrfs devices, repopulate the UI based on the new selection
 void BtrfsAssistant::on_comboBox_btrfsdevice_activated(int) {
     QString device = ui->comboBox_btrfsdevice->currentText();
@@ -696,6 +1417,11 @@ void BtrfsAssistant::on_comboBox_btrfsdevice_activated(int) {
 
 // Restores a snapper snapshot after extensive error checking
 void BtrfsAssistant::restoreSnapshot(const QString &uuid, QString subvolume) {
+    if (helper) {
+        restoreSnapshotWithHelper(*helper, uuid, subvolume);
+        return;
+    }
+
     // Make sure subvolume doesn't have a leading slash
     if (subvolume.startsWith("/"))
         subvolume = subvolume.right(subvolume.length() - 1);
@@ -705,6 +1431,9 @@ void BtrfsAssistant::restoreSnapshot(const QString &uuid, QString subvolume) {
         return;
     }
 
+    // Read the subvolumes again, they may have changed since the list was loaded and the restore moves them around
+    loadSubvolumes(uuid);
+
     // get the subvolid, if it isn't found abort
     QString subvolid = fsMap[uuid].subVolumes.key(subvolume);
     if (subvolid.isEmpty()) {
@@ -712,17 +1441,7 @@ void BtrfsAssistant::restoreSnapshot(const QString &uuid, QString subvolume) {
         return;
     }
 
-    // Now we need to find out what the target for the restore is
-    QString prefix = subvolume.split(".snapshots").at(0);
-
-    QString targetSubvolume;
-    // If the prefix is empty, that means that we are trying to restore the subvolume mounted as /
-    if (prefix.isEmpty()) {
-        targetSubvolume = findRootSubvol();
-    } else {
-        // Strip the trailing /
-        targetSubvolume = prefix.left(prefix.length() - 1);
-    }
+    const QString targetSubvolume = restoreTarget(subvolume);
 
     // Get the subvolid of the target and do some additional error checking
     QString targetSubvolid = fsMap[uuid].subVolumes.key(targetSubvolume);
@@ -738,70 +1457,84 @@ void BtrfsAssistant::restoreSnapshot(const QString &uuid, QString subvolume) {
         return;
 
     // Ensure the root of the partition is mounted and get the mountpoint
-    QString mountpoint = mountRoot(uuid);
-
-    // Make sure we have a trailing /
-    if (mountpoint.right(1) != "/")
-        mountpoint += "/";
+    const TopLevelMount topLevel(topLevelMounts, uuid);
+    if (!topLevel.isValid()) {
+        displayError(tr("Failed to mount the filesystem"));
+        return;
+    }
+    const QString &mountpoint = topLevel.path();
 
     // We are out of excuses, time to do the restore....carefully
-    QString targetBackup = "restore_backup_" + targetSubvolume + "_" + QTime::currentTime().toString("HHmmsszzz");
-
-    QDir dirWorker;
-
-    // Find the children before we start
-    const QStringList subvols = findBtrfsChildren(targetSubvolid, uuid);
-
-    // Rename the target
-    if (!renameSubvolume(QDir::cleanPath(mountpoint + targetSubvolume), QDir::cleanPath(mountpoint + targetBackup))) {
+    QString targetBackup;
+    const QStringList subvols = findBtrfsChildren(targetSubvolid, fsMap[uuid]);
+    switch (restoreSubvolume(mountpoint, targetSubvolume, subvolume, subvols, targetBackup)) {
+    case RestoreStatus::BackupFailed:
         displayError(tr("Failed to make a backup of target subvolume"));
         return;
+    case RestoreStatus::SnapshotFailed:
+        displayError(tr("Failed to restore subvolume!") + "\n\n" +
+                     tr("Snapshot restore failed.  Please verify the status of your system before rebooting"));
+        return;
+    case RestoreStatus::ChildrenFailed:
+        // If this fails, not much can be done except let the user know
+        displayError(tr("The restore was successful but the migration of the nested subvolumes failed") + "\n\n" +
+                     tr("Please migrate the those subvolumes manually"));
+        return;
+    case RestoreStatus::Restored:
+        break;
     }
 
-    // We moved the snapshot so we need to change the location
-    QString newSubvolume;
-    if (subvolume.startsWith(targetSubvolume))
-        newSubvolume = targetBackup + subvolume.right(subvolume.length() - targetSubvolume.length());
-    else
-        newSubvolume = targetBackup + "/" + subvolume;
+    // The backup is all it takes to undo the restore, it is only recorded where to move things back to
+    QString message = tr("Snapshot restoration complete.") + "\n\n" + tr("A copy of the original subvolume has been saved as ") +
+                      targetBackup;
+    QString error;
+    if (undoRetention > 0 && undoJournal.recordRestore(uuid, targetSubvolume, targetBackup, subvols, error))
+        message += "\n\n" + tr("The restore can be undone from the undo history for %1 hours").arg(undoRetention / 3600);
+
+    // If we get here I guess it worked
+    QMessageBox::information(0, tr("Snapshot Restore"), message + "\n\n" + tr("Please reboot immediately"));
+}
 
-    // Place a snapshot of the source where the target was
-    runCmd("btrfs subvolume snapshot " + mountpoint + newSubvolume + " " + mountpoint + targetSubvolume, false);
+// Restores @p subvolume through the privileged helper so it can be done without running the application as root.  Returns
+// the watcher of the call, which reports the outcome once it finishes, or nullptr if the restore wasn't started
+QDBusPendingCallWatcher *BtrfsAssistant::restoreSnapshotWithHelper(const HelperClient &helper, const QString &uuid, QString subvolume) {
+    // Make sure subvolume doesn't have a leading slash
+    if (subvolume.startsWith("/"))
+        subvolume = subvolume.right(subvolume.length() - 1);
 
-    // Make sure it worked
-    if (!dirWorker.exists(mountpoint + targetSubvolume)) {
-        // That failed, try to put the old one back
-        renameSubvolume(QDir::cleanPath(mountpoint + targetBackup), QDir::cleanPath(mountpoint + targetSubvolume));
-        displayError(tr("Failed to restore subvolume!") + "\n\n" +
-                     tr("Snapshot restore failed.  Please verify the status of your system before rebooting"));
-        return;
+    if (!isSnapper(subvolume)) {
+        displayError(tr("This is not a snapshot that can be restored by this application"));
+        return nullptr;
     }
 
-    // The restore was successful, now we need to move any child subvolumes into the target
-    QString childSubvolPath;
-    for (const QString &childSubvol : subvols) {
-        if (childSubvol.startsWith(targetSubvolume)) {
-            // Strip the old subvolname
-            childSubvolPath = childSubvol.right(childSubvol.length() - (targetSubvolume.length() + 1));
-        } else {
-            childSubvolPath = childSubvol;
-        }
+    // The helper checks that both subvolumes exist
+    const QString targetSubvolume = restoreTarget(subvolume);
+    if (targetSubvolume.isEmpty()) {
+        displayError(tr("Target not found"));
+        return nullptr;
+    }
 
-        // rename snapshot
-        QString sourcePath = QDir::cleanPath(mountpoint + targetBackup + QDir::separator() + childSubvolPath);
-        QString destinationPath = QDir::cleanPath(mountpoint + targetSubvolume + "/.");
-        if (!renameSubvolume(sourcePath, destinationPath)) {
-            // If this fails, not much can be done except let the user know
-            displayError(tr("The restore was successful but the migration of the nested subvolumes failed") + "\n\n" +
-                         tr("Please migrate the those subvolumes manually"));
+    if (QMessageBox::question(0, tr("Confirm"),
+                              tr("Are you sure you want to restore ") + subvolume + tr(" to ", "as in from/to") + targetSubvolume) !=
+        QMessageBox::Yes)
+        return nullptr;
+
+    auto *watcher = new QDBusPendingCallWatcher(helper.restoreSnapshot(uuid, subvolume, targetSubvolume), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [watcher] {
+        watcher->deleteLater();
+        QDBusPendingReply<QString> reply = *watcher;
+        if (reply.isError()) {
+            displayError(tr("Failed to restore subvolume!") + "\n\n" + reply.error().message());
             return;
         }
-    }
 
-    // If we get here I guess it worked
-    QMessageBox::information(0, tr("Snapshot Restore"),
-                             tr("Snapshot restoration complete.") + "\n\n" + tr("A copy of the original subvolume has been saved as ") +
-                                 targetBackup + "\n\n" + tr("Please reboot immediately"));
+        QMessageBox::information(0, tr("Snapshot Restore"),
+                                 tr("Snapshot restoration complete.") + "\n\n" +
+                                     tr("A copy of the original subvolume has been saved as ") + reply.value() + "\n\n" +
+                                     tr("Please reboot immediately"));
+    });
+
+    return watcher;
 }
 
 // Loads the snapper configs and snapshots
@@ -815,19 +1548,41 @@ void BtrfsAssistant::loadSnapper() {
     ui->comboBox_snapper_config_settings->clear();
     snapperConfigs.clear();
     snapperSnapshots.clear();
-    QString outputList = runCmd("snapper list-configs | tail -n +3", false).output;
-
-    if (outputList.isEmpty())
-        return;
+    snapshotIndexStale = true;
+    snapperLoads++;
+    if (!readSnapperConfigs([this](const QString &path) { return backend->readFile(path); }, snapperConfigs)) {
+        snapperConfigs = parseSnapperConfigs(backend->run(snapperConfigsCommand()));
+        if (snapperConfigs.isEmpty())
+            return;
+    }
 
-    const QStringList outputAsList = outputList.split('\n');
-    for (const QString &line : outputAsList) {
-        // for each config, add to the map and add it's snapshots to the vector
-        QString name = line.split('|').at(0).trimmed();
-        snapperConfigs[name] = line.split('|').at(1).trimmed();
+    const QStringList configNames = snapperConfigs.keys();
+    for (const QString &name : configNames) {
+        // for each config, add it's snapshots to the vector
         ui->comboBox_snapper_configs->addItem(name);
         ui->comboBox_snapper_config_settings->addItem(name);
 
+        // Unprivileged, snapper only lists the snapshots of configs which allow the user so the helper lists them.  The
+        // grid is filled in as the replies arrive, replies to an earlier load are dropped
+        if (helper) {
+            auto *watcher = new QDBusPendingCallWatcher(helper->listSnapshots(name), this);
+            connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, watcher, name, load = snapperLoads] {
+                watcher->deleteLater();
+                QDBusPendingReply<QVariantList> reply = *watcher;
+                if (load != snapperLoads)
+                    return;
+                if (reply.isError()) {
+                    qWarning() << "Failed to list the snapshots of" << name << ":" << reply.error().message();
+                    return;
+                }
+
+                snapperSnapshots[name] = snapshotsFromVariant(reply.value());
+                snapshotIndexStale = true;
+                populateSnapperGrid();
+            });
+            continue;
+        }
+
         // If we are booted off the snapshot we need to handle the root snapshots manually
         if (name == "root" && isSnapBoot) {
             QString output = runCmd("LANG=C findmnt -no uuid,options /", false).output;
@@ -869,34 +1624,38 @@ void BtrfsAssistant::loadSnapper() {
                 continue;
 
             // Make sure the root of the partition is mounted
-            QString mountpoint = mountRoot(uuid);
+            const TopLevelMount topLevel(topLevelMounts, uuid);
+            if (!topLevel.isValid())
+                continue;
+            QString mountpoint = topLevel.path();
 
             // Make sure we have a trailing /
             if (mountpoint.right(1) != "/")
                 mountpoint += "/";
 
-            QString findOutput = runCmd("find " + mountpoint + prefix + ".snapshots -maxdepth 2 -name info.xml", false).output;
+            const QString findCommand = "find " + mountpoint + prefix + ".snapshots -maxdepth 2 -name info.xml";
+            const QString findOutput = QString::fromUtf8(backend->run(findCommand)).trimmed();
 
             const QStringList findOutputList = findOutput.split('\n');
             for (const QString &fileName : findOutputList) {
-                SnapperSnapshots snap = getSnapperMeta(fileName);
+                SnapperSnapshots snap = parseSnapperInfo(backend->readFile(fileName));
                 if (snap.number == 0)
                     snapperSnapshots[name].append(snap);
             }
         } else {
-            QString list = runCmd("snapper -c " + name + " list --columns number,date,description | tail -n +4", false).output;
-            if (list.isEmpty())
-                continue;
-            const QStringList snapperList = list.split('\n');
-            for (const QString &snap : snapperList)
-                snapperSnapshots[name].append(
-                    {snap.split('|').at(0).trimmed().toInt(), snap.split('|').at(1).trimmed(), snap.split('|').at(2).trimmed()});
+            snapperSnapshots[name] = parseSnapperList(backend->run(snapperListCommand(name)));
         }
     }
 }
 
 // Populates the main grid on the Snapper tab
 void BtrfsAssistant::populateSnapperGrid() {
+    const QString query = ui->lineEdit_snapper_search->text().trimmed();
+    if (!query.isEmpty()) {
+        populateSnapperSearch(query);
+        return;
+    }
+
     if (ui->checkBox_snapper_restore->isChecked()) {
         QString config = ui->comboBox_snapper_configs->currentText();
 
@@ -922,12 +1681,16 @@ void BtrfsAssistant::populateSnapperGrid() {
     } else {
         QString config = ui->comboBox_snapper_configs->currentText();
 
-        // Clear the table and set the headers
+        // Clear the table and set the headers, the description stays in the third column as it is in the search results
         ui->tableWidget_snapper->clear();
-        ui->tableWidget_snapper->setColumnCount(3);
+        ui->tableWidget_snapper->setColumnCount(7);
         ui->tableWidget_snapper->setHorizontalHeaderItem(0, new QTableWidgetItem(tr("Number", "The number associated with a snapshot")));
         ui->tableWidget_snapper->setHorizontalHeaderItem(1, new QTableWidgetItem(tr("Date/Time")));
         ui->tableWidget_snapper->setHorizontalHeaderItem(2, new QTableWidgetItem(tr("Description")));
+        ui->tableWidget_snapper->setHorizontalHeaderItem(3, new QTableWidgetItem(tr("Type")));
+        ui->tableWidget_snapper->setHorizontalHeaderItem(4, new QTableWidgetItem(tr("Pre", "The pre snapshot a post snapshot belongs to")));
+        ui->tableWidget_snapper->setHorizontalHeaderItem(5, new QTableWidgetItem(tr("Cleanup")));
+        ui->tableWidget_snapper->setHorizontalHeaderItem(6, new QTableWidgetItem(tr("Userdata")));
 
         // Make sure there is something to populate
         if (snapperSnapshots[config].isEmpty())
@@ -936,11 +1699,16 @@ void BtrfsAssistant::populateSnapperGrid() {
         // Populate the table
         ui->tableWidget_snapper->setRowCount(snapperSnapshots[config].size());
         for (int i = 0; i < snapperSnapshots[config].size(); i++) {
-            QTableWidgetItem *number = new QTableWidgetItem(snapperSnapshots[config].at(i).number);
-            number->setData(Qt::DisplayRole, snapperSnapshots[config].at(i).number);
+            const SnapperSnapshots &snapshot = snapperSnapshots[config].at(i);
+            QTableWidgetItem *number = new QTableWidgetItem(snapshot.number);
+            number->setData(Qt::DisplayRole, snapshot.number);
             ui->tableWidget_snapper->setItem(i, 0, number);
-            ui->tableWidget_snapper->setItem(i, 1, new QTableWidgetItem(snapperSnapshots[config].at(i).time));
-            ui->tableWidget_snapper->setItem(i, 2, new QTableWidgetItem(snapperSnapshots[config].at(i).desc));
+            ui->tableWidget_snapper->setItem(i, 1, new QTableWidgetItem(snapshot.time));
+            ui->tableWidget_snapper->setItem(i, 2, new QTableWidgetItem(snapshot.desc));
+            ui->tableWidget_snapper->setItem(i, 3, new QTableWidgetItem(snapshot.type));
+            ui->tableWidget_snapper->setItem(i, 4, new QTableWidgetItem(snapshot.preNumber > 0 ? QString::number(snapshot.preNumber) : ""));
+            ui->tableWidget_snapper->setItem(i, 5, new QTableWidgetItem(snapshot.cleanup));
+            ui->tableWidget_snapper->setItem(i, 6, new QTableWidgetItem(snapshot.userdata));
         }
     }
 
@@ -949,6 +1717,56 @@ void BtrfsAssistant::populateSnapperGrid() {
     ui->tableWidget_snapper->sortItems(0, Qt::DescendingOrder);
 }
 
+// Fills the Snapper grid with the snapshots from every config that match @p query.  The config of each row is in the
+// extra fourth column
+void BtrfsAssistant::populateSnapperSearch(const QString &query) {
+    if (snapshotIndexStale) {
+        snapshotIndex.build(snapperSnapshots, snapperSubvolumes);
+        snapshotIndexStale = false;
+    }
+
+    const bool restore = ui->checkBox_snapper_restore->isChecked();
+    const QVector<int> matches = snapshotIndex.search(query, restore);
+
+    ui->tableWidget_snapper->setUpdatesEnabled(false);
+    ui->tableWidget_snapper->clear();
+    ui->tableWidget_snapper->setColumnCount(4);
+    ui->tableWidget_snapper->setHorizontalHeaderItem(
+        0, new QTableWidgetItem(restore ? tr("Subvolume") : tr("Number", "The number associated with a snapshot")));
+    ui->tableWidget_snapper->setHorizontalHeaderItem(1, new QTableWidgetItem(tr("Date/Time")));
+    ui->tableWidget_snapper->setHorizontalHeaderItem(2, new QTableWidgetItem(tr("Description")));
+    ui->tableWidget_snapper->setHorizontalHeaderItem(3, new QTableWidgetItem(tr("Config")));
+
+    // The matches are already newest first
+    ui->tableWidget_snapper->setRowCount(matches.size());
+    for (int i = 0; i < matches.size(); i++) {
+        const SnapshotIndexEntry &entry = snapshotIndex.entry(matches.at(i));
+        QTableWidgetItem *id = new QTableWidgetItem(entry.id);
+        if (!restore)
+            id->setData(Qt::DisplayRole, entry.id.toInt());
+        ui->tableWidget_snapper->setItem(i, 0, id);
+        ui->tableWidget_snapper->setItem(i, 1, new QTableWidgetItem(entry.time));
+        ui->tableWidget_snapper->setItem(i, 2, new QTableWidgetItem(entry.desc));
+        ui->tableWidget_snapper->setItem(i, 3, new QTableWidgetItem(entry.config));
+    }
+
+    ui->tableWidget_snapper->resizeColumnsToContents();
+    ui->tableWidget_snapper->setUpdatesEnabled(true);
+}
+
+// Returns the config of the snapshot in @p row of the Snapper grid, search results can come from any config
+QString BtrfsAssistant::snapperRowConfig(int row) {
+    if (!ui->lineEdit_snapper_search->text().trimmed().isEmpty() && ui->tableWidget_snapper->item(row, 3) != nullptr)
+        return ui->tableWidget_snapper->item(row, 3)->text();
+
+    return ui->comboBox_snapper_configs->currentText();
+}
+
+// Filter the snapshots of all the configs as the search is typed
+void BtrfsAssistant::on_lineEdit_snapper_search_textChanged(const QString &) {
+    populateSnapperGrid();
+}
+
 // Repopulate the grid when a different config is selected
 void BtrfsAssistant::on_comboBox_snapper_configs_activated(int) {
     populateSnapperGrid();
@@ -970,6 +1788,23 @@ void BtrfsAssistant::on_pushButton_snapper_create_clicked() {
     }
 
     // OK, let's go ahead and take the snapshot
+    if (helper) {
+        // The snapshots are reloaded once the helper has answered
+        auto *watcher = new QDBusPendingCallWatcher(helper->createSnapshot(config, "Manual Snapshot"), this);
+        connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, watcher, config] {
+            watcher->deleteLater();
+            QDBusPendingReply<int> reply = *watcher;
+            if (reply.isError())
+                displayError(tr("Failed to create the snapshot") + "\n\n" + reply.error().message());
+
+            loadSnapper();
+            ui->comboBox_snapper_configs->setCurrentText(config);
+            populateSnapperGrid();
+        });
+        ui->pushButton_snapper_create->clearFocus();
+        return;
+    }
+
     runCmd("snapper -c " + config + " create -d 'Manual Snapshot'", false);
 
     loadSnapper();
@@ -979,6 +1814,208 @@ void BtrfsAssistant::on_pushButton_snapper_create_clicked() {
     ui->pushButton_snapper_create->clearFocus();
 }
 
+// Opens a file browser over the selected snapshot so individual files can be restored from it
+void BtrfsAssistant::on_pushButton_snapper_browse_clicked() {
+    const int row = ui->tableWidget_snapper->currentRow();
+    if (row == -1) {
+        displayError(tr("Nothing selected!"));
+        return;
+    }
+
+    const QString config = snapperRowConfig(row);
+    const QString id = ui->tableWidget_snapper->item(row, 0)->text();
+
+    QString snapshotPath;
+    QString liveRoot;
+    std::optional<TopLevelMount> topLevel;
+    if (ui->checkBox_snapper_restore->isChecked()) {
+        // Restore mode lists the snapshots by subvolume so they are browsed through the top level of the filesystem.  There
+        // is no mounted copy of the subvolume to restore into so the files can only be restored to a chosen directory
+        if (!snapperSubvolumes.contains(config) || snapperSubvolumes[config].isEmpty()) {
+            displayError(tr("Failed to find the snapshot"));
+            return;
+        }
+        topLevel.emplace(topLevelMounts, snapperSubvolumes[config].at(0).uuid);
+        snapshotPath = QDir::cleanPath(topLevel->path() + QDir::separator() + id);
+    } else {
+        snapshotPath = QDir::cleanPath(snapperConfigs[config] + "/.snapshots/" + id + "/snapshot");
+        liveRoot = snapperConfigs[config];
+    }
+
+    if (!QFileInfo(snapshotPath).isDir()) {
+        displayError(tr("Failed to find the snapshot at %1").arg(snapshotPath));
+        return;
+    }
+
+    showSnapshotBrowser(snapshotPath, liveRoot, config + " " + id);
+
+    ui->pushButton_snapper_browse->clearFocus();
+}
+
+// Shows the files in the snapshot at @p snapshotPath so they can be restored to the same place under @p liveRoot or to a
+// chosen directory.  Restore to the original location is unavailable when @p liveRoot is empty
+void BtrfsAssistant::showSnapshotBrowser(const QString &snapshotPath, const QString &liveRoot, const QString &title) {
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Browse Snapshot %1").arg(title));
+    dialog.resize(900, 600);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+
+    // QFileSystemModel only reads a directory when it is expanded so even a huge snapshot opens instantly
+    QFileSystemModel *model = new QFileSystemModel(&dialog);
+    model->setReadOnly(true);
+    model->setFilter(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
+    model->setRootPath(snapshotPath);
+
+    QTreeView *tree = new QTreeView;
+    tree->setModel(model);
+    tree->setRootIndex(model->index(snapshotPath));
+    tree->setSelectionMode(QAbstractItemView::ExtendedSelection);
+    tree->setColumnWidth(0, 400);
+    layout->addWidget(tree);
+
+    QLabel *status = new QLabel;
+    layout->addWidget(status);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close);
+    QPushButton *restoreButton = buttons->addButton(tr("Restore"), QDialogButtonBox::ActionRole);
+    QPushButton *restoreToButton = buttons->addButton(tr("Restore To..."), QDialogButtonBox::ActionRole);
+    restoreButton->setEnabled(!liveRoot.isEmpty());
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout->addWidget(buttons);
+
+    const auto selectedPaths = [tree, model] {
+        QStringList paths;
+        const QModelIndexList rows = tree->selectionModel()->selectedRows();
+        for (const QModelIndex &index : rows)
+            paths.append(model->filePath(index));
+        return paths;
+    };
+
+    const auto startRestore = [this, &dialog, status, buttons](const QList<QPair<QString, QString>> &paths) {
+        buttons->setEnabled(false);
+        status->setText(tr("Restoring..."));
+
+        auto *watcher = new QFutureWatcher<FileRestoreResult>(&dialog);
+        connect(watcher, &QFutureWatcher<FileRestoreResult>::finished, &dialog, [this, &dialog, watcher, status, buttons] {
+            watcher->deleteLater();
+            buttons->setEnabled(true);
+
+            const FileRestoreResult result = watcher->result();
+            const QString message = tr("Restored %1 files, %2 of which %3 is shared with the snapshot")
+                                        .arg(result.files)
+                                        .arg(toHumanReadable(result.bytes))
+                                        .arg(toHumanReadable(result.clonedBytes));
+            status->setText(message);
+            if (!result.errors.isEmpty())
+                QMessageBox::warning(&dialog, tr("Restore"), message + "\n\n" + tr("Errors:") + "\n" + result.errors.join('\n'));
+        });
+        watcher->setFuture(QtConcurrent::run([paths] { return restoreFiles(paths); }));
+    };
+
+    connect(restoreButton, &QPushButton::clicked, &dialog, [this, &dialog, snapshotPath, liveRoot, selectedPaths, startRestore] {
+        const QStringList paths = selectedPaths();
+        if (paths.isEmpty())
+            return;
+
+        const QString question = tr("Replace the selected files in %1 with the versions from the snapshot?").arg(liveRoot);
+        if (QMessageBox::question(&dialog, tr("Confirm"), question) != QMessageBox::Yes)
+            return;
+
+        QList<QPair<QString, QString>> restorePaths;
+        for (const QString &path : paths)
+            restorePaths.append({path, liveRoot + QDir::separator() + path.mid(snapshotPath.length())});
+        startRestore(restorePaths);
+    });
+
+    connect(restoreToButton, &QPushButton::clicked, &dialog, [this, &dialog, selectedPaths, startRestore] {
+        const QStringList paths = selectedPaths();
+        if (paths.isEmpty())
+            return;
+
+        const QString target = QFileDialog::getExistingDirectory(&dialog, tr("Select where to restore the selected files"));
+        if (target.isEmpty())
+            return;
+
+        QList<QPair<QString, QString>> restorePaths;
+        for (const QString &path : paths)
+            restorePaths.append({path, target + QDir::separator() + QFileInfo(path).fileName()});
+        startRestore(restorePaths);
+    });
+
+    dialog.exec();
+}
+
+// Sends the selected snapshots to a directory on another btrfs filesystem
+void BtrfsAssistant::on_pushButton_snapper_replicate_clicked() {
+    if (ui->checkBox_snapper_restore->isChecked()) {
+        displayError(tr("Leave restore mode to select snapshots to replicate"));
+        return;
+    }
+
+    if (ui->tableWidget_snapper->currentRow() == -1) {
+        displayError(tr("Nothing selected!"));
+        return;
+    }
+
+    // Get the snapshot numbers for the selected rows
+    const QList<QTableWidgetItem *> list = ui->tableWidget_snapper->selectedItems();
+    const QString config = snapperRowConfig(ui->tableWidget_snapper->currentRow());
+    QSet<int> numbers;
+    for (const QTableWidgetItem *item : list) {
+        if (snapperRowConfig(item->row()) != config) {
+            displayError(tr("Select snapshots from a single config to replicate"));
+            return;
+        }
+        numbers.insert(ui->tableWidget_snapper->item(item->row(), 0)->text().toInt());
+    }
+
+    const QString target = QFileDialog::getExistingDirectory(this, tr("Select a directory on the target btrfs filesystem"));
+    if (target.isEmpty())
+        return;
+
+    const QString snapshotDir = QDir::cleanPath(snapperConfigs[config] + "/.snapshots");
+
+    auto replicator = QSharedPointer<SnapshotReplicator>::create();
+    auto *progressTimer = new QTimer(this);
+    auto elapsed = QSharedPointer<QElapsedTimer>::create();
+    elapsed->start();
+    connect(progressTimer, &QTimer::timeout, this, [this, replicator, elapsed] {
+        const quint64 bytes = replicator->bytesTransferred();
+        const qint64 ms = qMax<qint64>(1, elapsed->elapsed());
+        ui->pushButton_snapper_replicate->setText(tr("Sending %1... %2 (%3/s)")
+                                                      .arg(replicator->currentSnapshot())
+                                                      .arg(toHumanReadable(bytes))
+                                                      .arg(toHumanReadable(bytes * 1000.0 / ms)));
+    });
+    progressTimer->start(500);
+    ui->pushButton_snapper_replicate->setEnabled(false);
+
+    auto *watcher = new QFutureWatcher<ReplicationResult>(this);
+    connect(watcher, &QFutureWatcher<ReplicationResult>::finished, this, [this, watcher, progressTimer] {
+        progressTimer->deleteLater();
+        watcher->deleteLater();
+        ui->pushButton_snapper_replicate->setText(tr("Replicate Snapshots"));
+        ui->pushButton_snapper_replicate->setEnabled(true);
+
+        const ReplicationResult result = watcher->result();
+        QString message = tr("Sent %1 snapshots, %2 incrementally.  %3 were already on the target")
+                              .arg(result.sent)
+                              .arg(result.incremental)
+                              .arg(result.skipped);
+        message += "\n" + tr("Transferred %1 at %2/s")
+                              .arg(toHumanReadable(result.bytes))
+                              .arg(toHumanReadable(result.bytes * 1000.0 / qMax<qint64>(1, result.elapsedMs)));
+        if (!result.errors.isEmpty())
+            message += "\n\n" + tr("Errors:") + "\n" + result.errors.join('\n');
+        QMessageBox::information(this, tr("Replication Finished"), message);
+    });
+    watcher->setFuture(QtConcurrent::run([replicator, snapshotDir, numbers, target] {
+        return replicator->replicate(snapshotDir, numbers.values(), target);
+    }));
+
+    ui->pushButton_snapper_replicate->clearFocus();
+}
+
 // When the snapper delete config button is clicked, call snapper to remove the config
 void BtrfsAssistant::on_pushButton_snapper_delete_clicked() {
     if (ui->tableWidget_snapper->currentRow() == -1) {
@@ -989,11 +2026,10 @@ void BtrfsAssistant::on_pushButton_snapper_delete_clicked() {
     // Get all the rows that were selected
     const QList<QTableWidgetItem *> list = ui->tableWidget_snapper->selectedItems();
 
-    QSet<QString> numbers;
-
-    // Get the snapshot numbers for the selected rows
+    // Get the snapshot numbers for the selected rows, search results may span several configs
+    QMap<QString, QSet<QString>> numbers;
     for (const QTableWidgetItem *item : list) {
-        numbers.insert(ui->tableWidget_snapper->item(item->row(), 0)->text());
+        numbers[snapperRowConfig(item->row())].insert(ui->tableWidget_snapper->item(item->row(), 0)->text());
     }
 
     // Ask for confirmation
@@ -1002,16 +2038,38 @@ void BtrfsAssistant::on_pushButton_snapper_delete_clicked() {
 
     QString config = ui->comboBox_snapper_configs->currentText();
 
-    // Delete each selected snapshot
-    for (const QString &number : qAsConst(numbers)) {
-        // This shouldn't be possible but we check anyway
-        if (config.isEmpty() || number.isEmpty()) {
-            displayError(tr("Cannot delete snapshot"));
-            return;
+    // Delete each selected snapshot, the helper takes all of the snapshots of a config at once
+    for (auto it = numbers.constBegin(); it != numbers.constEnd(); ++it) {
+        QList<int> helperNumbers;
+        for (const QString &number : it.value()) {
+            // This shouldn't be possible but we check anyway
+            if (it.key().isEmpty() || number.isEmpty()) {
+                displayError(tr("Cannot delete snapshot"));
+                return;
+            }
+
+            // Delete the snapshot
+            if (helper)
+                helperNumbers.append(number.toInt());
+            else
+                runCmd("snapper -c " + it.key() + " delete " + number, false);
         }
 
-        // Delete the snapshot
-        runCmd("snapper -c " + config + " delete " + number, false);
+        // The snapshots are reloaded as each config's deletion is answered
+        if (helper) {
+            const QString deleted = it.key();
+            auto *watcher = new QDBusPendingCallWatcher(helper->deleteSnapshots(deleted, helperNumbers), this);
+            connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, watcher, deleted, config] {
+                watcher->deleteLater();
+                QDBusPendingReply<> reply = *watcher;
+                if (reply.isError())
+                    displayError(tr("Failed to delete the snapshots of %1").arg(deleted) + "\n\n" + reply.error().message());
+
+                loadSnapper();
+                ui->comboBox_snapper_configs->setCurrentText(config);
+                populateSnapperGrid();
+            });
+        }
     }
 
     // Reload the UI since something changed
@@ -1022,43 +2080,335 @@ void BtrfsAssistant::on_pushButton_snapper_delete_clicked() {
     ui->pushButton_snapper_delete->clearFocus();
 }
 
+// Changes the cleanup algorithm, a userdata key or the description of every selected snapshot.  Each config gets a single
+// snapper modify for all of its snapshots and only the changed cells of the grid are updated afterwards
+void BtrfsAssistant::on_pushButton_snapper_edit_clicked() {
+    ui->pushButton_snapper_edit->clearFocus();
+
+    if (ui->checkBox_snapper_restore->isChecked()) {
+        displayError(tr("Leave restore mode to select snapshots to edit"));
+        return;
+    }
+
+    if (ui->tableWidget_snapper->currentRow() == -1) {
+        displayError(tr("Nothing selected!"));
+        return;
+    }
+
+    // Get the snapshot numbers for the selected rows, search results may span several configs
+    QMap<QString, QSet<int>> numbers;
+    const QList<QTableWidgetItem *> list = ui->tableWidget_snapper->selectedItems();
+    for (const QTableWidgetItem *item : list)
+        numbers[snapperRowConfig(item->row())].insert(ui->tableWidget_snapper->item(item->row(), 0)->text().toInt());
+    int count = 0;
+    for (const QSet<int> &configNumbers : qAsConst(numbers))
+        count += configNumbers.size();
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Edit %1 Snapshot(s)").arg(count));
+    QFormLayout *layout = new QFormLayout(&dialog);
+
+    // An empty cleanup algorithm protects the snapshot from every cleanup
+    QComboBox *cleanup = new QComboBox;
+    cleanup->addItem(tr("Unchanged"));
+    cleanup->addItem(tr("None (protected from cleanup)"), QString(""));
+    cleanup->addItem("number", QString("number"));
+    cleanup->addItem("timeline", QString("timeline"));
+    cleanup->addItem("empty-pre-post", QString("empty-pre-post"));
+    layout->addRow(tr("Cleanup algorithm"), cleanup);
+
+    QLineEdit *userdataKey = new QLineEdit;
+    userdataKey->setPlaceholderText(tr("Leave empty to keep the userdata"));
+    layout->addRow(tr("Userdata key"), userdataKey);
+    QLineEdit *userdataValue = new QLineEdit;
+    userdataValue->setPlaceholderText(tr("Leave empty to remove the key"));
+    layout->addRow(tr("Userdata value"), userdataValue);
+
+    QLineEdit *description = new QLineEdit;
+    description->setPlaceholderText(tr("Leave empty to keep the descriptions"));
+    layout->addRow(tr("Description"), description);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Ok | QDialogButtonBox::Cancel);
+    connect(buttons, &QDialogButtonBox::accepted, &dialog, &QDialog::accept);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout->addRow(buttons);
+
+    if (dialog.exec() != QDialog::Accepted)
+        return;
+
+    const bool changeCleanup = cleanup->currentIndex() > 0;
+    const QString cleanupAlgorithm = cleanup->currentData().toString();
+    const QString key = userdataKey->text().trimmed();
+    const QString value = userdataValue->text().trimmed();
+    const QString desc = description->text().trimmed();
+    if (key.contains('=') || key.contains(',') || value.contains(',')) {
+        displayError(tr("Userdata keys can't contain = or , and values can't contain ,"));
+        return;
+    }
+
+    QStringList options;
+    if (changeCleanup)
+        options << "--cleanup-algorithm" << cleanupAlgorithm;
+    if (!key.isEmpty())
+        options << "--userdata" << key + "=" + value;
+    if (!desc.isEmpty())
+        options << "--description" << desc;
+    if (options.isEmpty())
+        return;
+
+    QStringList errors;
+    for (auto it = numbers.constBegin(); it != numbers.constEnd(); ++it) {
+        QStringList arguments = QStringList() << "-c" << it.key() << "modify" << options;
+        for (const int number : it.value())
+            arguments << QString::number(number);
+
+        // The arguments are passed as is so a description or userdata never needs quoting
+        QProcess proc;
+        proc.setProcessChannelMode(QProcess::MergedChannels);
+        proc.start("snapper", arguments);
+        if (!proc.waitForFinished(1000 * 60) || proc.exitStatus() != QProcess::NormalExit || proc.exitCode() != 0) {
+            errors.append(it.key() + ": " + QString::fromUtf8(proc.readAll()).trimmed());
+            continue;
+        }
+
+        for (SnapperSnapshots &snapshot : snapperSnapshots[it.key()]) {
+            if (!it.value().contains(snapshot.number))
+                continue;
+            if (changeCleanup)
+                snapshot.cleanup = cleanupAlgorithm;
+            if (!key.isEmpty())
+                snapshot.userdata = mergeUserdata(snapshot.userdata, key, value);
+            if (!desc.isEmpty())
+                snapshot.desc = desc;
+        }
+    }
+    snapshotIndexStale = true;
+
+    // Update the cells of the edited rows in place, the search results only show the description
+    const bool search = !ui->lineEdit_snapper_search->text().trimmed().isEmpty();
+    for (int row = 0; row < ui->tableWidget_snapper->rowCount(); row++) {
+        const QString config = snapperRowConfig(row);
+        const int number = ui->tableWidget_snapper->item(row, 0)->text().toInt();
+        if (!numbers.value(config).contains(number))
+            continue;
+
+        for (const SnapperSnapshots &snapshot : qAsConst(snapperSnapshots[config])) {
+            if (snapshot.number != number)
+                continue;
+            ui->tableWidget_snapper->item(row, 2)->setText(snapshot.desc);
+            if (!search) {
+                ui->tableWidget_snapper->item(row, 5)->setText(snapshot.cleanup);
+                ui->tableWidget_snapper->item(row, 6)->setText(snapshot.userdata);
+            }
+            break;
+        }
+    }
+
+    if (!errors.isEmpty())
+        displayError(tr("Failed to modify some snapshots:") + "\n\n" + errors.join('\n'));
+}
+
+// Shows the snapshots of the selected config grouped into pre/post transactions.  Selecting a pair lists the files written
+// between its two snapshots, found from the generations of the extents rather than by comparing the snapshots
+void BtrfsAssistant::on_pushButton_snapper_timeline_clicked() {
+    ui->pushButton_snapper_timeline->clearFocus();
+
+    const QString config = ui->comboBox_snapper_configs->currentText();
+    if (!snapperConfigs.contains(config)) {
+        displayError(tr("No snapper config selected"));
+        return;
+    }
+    const QString snapshotDir = QDir::cleanPath(snapperConfigs[config] + "/.snapshots");
+
+    QDialog dialog(this);
+    dialog.setWindowTitle(tr("Transactions of %1").arg(config));
+    dialog.resize(900, 600);
+    QVBoxLayout *layout = new QVBoxLayout(&dialog);
+    QSplitter *splitter = new QSplitter(Qt::Vertical);
+    layout->addWidget(splitter);
+
+    SnapshotTimelineModel *model = new SnapshotTimelineModel(&dialog);
+    model->setSnapshots(snapperSnapshots[config]);
+
+    // Uniform row heights let the view lay out only the visible rows
+    QTreeView *tree = new QTreeView;
+    tree->setUniformRowHeights(true);
+    tree->setSelectionBehavior(QAbstractItemView::SelectRows);
+    tree->setSelectionMode(QAbstractItemView::SingleSelection);
+    tree->setModel(model);
+    for (int column = 0; column < SnapshotTimelineModel::DescriptionColumn; column++)
+        tree->resizeColumnToContents(column);
+    splitter->addWidget(tree);
+
+    QPlainTextEdit *summary = new QPlainTextEdit;
+    summary->setReadOnly(true);
+    summary->setPlaceholderText(tr("Select a pre/post pair to see the files it changed"));
+    splitter->addWidget(summary);
+
+    QDialogButtonBox *buttons = new QDialogButtonBox(QDialogButtonBox::Close);
+    connect(buttons, &QDialogButtonBox::rejected, &dialog, &QDialog::reject);
+    layout->addWidget(buttons);
+
+    // Only the result for the current selection is shown when the selection moves on before the previous one finished
+    auto request = QSharedPointer<int>::create(0);
+    connect(tree->selectionModel(), &QItemSelectionModel::currentRowChanged, &dialog,
+            [this, &dialog, model, summary, snapshotDir, request](const QModelIndex &current) {
+                const SnapshotTransaction pair = model->transaction(current);
+                summary->clear();
+                ++*request;
+                if (pair.second == -1)
+                    return;
+
+                const int pre = model->snapshot(pair.first).number;
+                const int post = model->snapshot(pair.second).number;
+                summary->setPlainText(tr("Reading the changes between snapshot %1 and %2...").arg(pre).arg(post));
+
+                // Every extent written after the pre snapshot was taken has a newer generation in the post snapshot.  The
+                // pre snapshot was read-only from the start so its generation is the one it was taken at
+                const QString prePath = snapshotDir + "/" + QString::number(pre) + "/snapshot";
+                const QString postPath = snapshotDir + "/" + QString::number(post) + "/snapshot";
+                Backend *source = backend.data();
+                auto *watcher = new QFutureWatcher<QStringList>(&dialog);
+                connect(watcher, &QFutureWatcher<QStringList>::finished, &dialog, [watcher, summary, request, pre, post, id = *request] {
+                    watcher->deleteLater();
+                    if (id != *request)
+                        return;
+
+                    const QStringList files = watcher->result();
+                    summary->setPlainText(tr("%1 files written between snapshot %2 and %3, deleted files aren't listed")
+                                              .arg(files.size())
+                                              .arg(pre)
+                                              .arg(post) +
+                                          "\n\n" + files.join('\n'));
+                });
+                watcher->setFuture(QtConcurrent::run([source, prePath, postPath] {
+                    BtrfsSubvolInfo info;
+                    if (!readSubvolInfo(prePath, info))
+                        return QStringList();
+                    return parseFindNew(source->run("btrfs subvolume find-new " + postPath + " " + QString::number(info.generation)));
+                }));
+            });
+
+    dialog.exec();
+}
+
 // Populates a selected config on the Snapper Settings tab
 void BtrfsAssistant::populateSnapperConfigSettings() {
     QString name = ui->comboBox_snapper_config_settings->currentText();
     if (name.isEmpty())
         return;
 
-    QString output = runCmd("snapper -c " + name + " get-config | tail -n +3", false).output;
+    // Read the config file directly, snapper is only asked when it can't be read
+    ShellConfig config;
+    if (!config.load(snapperConfigPath(name))) {
+        const QByteArray output = backend->run("snapper -c " + name + " get-config");
+        LineTokenizer lines(output);
+        lines.skip(2);
+        std::string_view line;
+        while (lines.next(line)) {
+            if (!line.empty())
+                config.setValue(toQString(trimmed(field(line, '|', 0))), toQString(trimmed(field(line, '|', 1))));
+        }
+    }
 
-    if (output.isEmpty())
+    if (!config.contains("SUBVOLUME"))
         return;
 
+    // A key missing from the file has snapper's default value
     ui->label_snapper_config_name->setText(name);
-    const QStringList outputList = output.split('\n');
-    for (const QString &line : outputList) {
-        if (line.isEmpty())
-            continue;
-        QString key = line.split('|').at(0).trimmed();
-        QString value = line.split('|').at(1).trimmed();
-        if (key == "SUBVOLUME")
-            ui->label_snapper_backup_path->setText(value);
-        else if (key == "TIMELINE_CREATE")
-            ui->checkBox_snapper_enabletimeline->setChecked(value.toStdString() == "yes");
-        else if (key == "TIMELINE_LIMIT_HOURLY")
-            ui->spinBox_snapper_hourly->setValue(value.toInt());
-        else if (key == "TIMELINE_LIMIT_DAILY")
-            ui->spinBox_snapper_daily->setValue(value.toInt());
-        else if (key == "TIMELINE_LIMIT_WEEKLY")
-            ui->spinBox_snapper_weekly->setValue(value.toInt());
-        else if (key == "TIMELINE_LIMIT_MONTHLY")
-            ui->spinBox_snapper_monthly->setValue(value.toInt());
-        else if (key == "TIMELINE_LIMIT_YEARLY")
-            ui->spinBox_snapper_yearly->setValue(value.toInt());
-        else if (key == "NUMBER_LIMIT")
-            ui->spinBox_snapper_pacman->setValue(value.toInt());
-    }
+    ui->label_snapper_backup_path->setText(config.value("SUBVOLUME"));
+    ui->checkBox_snapper_enabletimeline->setChecked(config.value("TIMELINE_CREATE", "yes") == "yes");
+    ui->spinBox_snapper_hourly->setValue(config.value("TIMELINE_LIMIT_HOURLY", "10").toInt());
+    ui->spinBox_snapper_daily->setValue(config.value("TIMELINE_LIMIT_DAILY", "10").toInt());
+    ui->spinBox_snapper_weekly->setValue(config.value("TIMELINE_LIMIT_WEEKLY", "0").toInt());
+    ui->spinBox_snapper_monthly->setValue(config.value("TIMELINE_LIMIT_MONTHLY", "10").toInt());
+    ui->spinBox_snapper_yearly->setValue(config.value("TIMELINE_LIMIT_YEARLY", "10").toInt());
+    ui->spinBox_snapper_pacman->setValue(config.value("NUMBER_LIMIT", "50").toInt());
+    retentionLimits.timelineMinAge = config.value("TIMELINE_MIN_AGE", "1800").toLongLong();
+    retentionLimits.numberMinAge = config.value("NUMBER_MIN_AGE", "1800").toLongLong();
 
     snapperTimelineEnable(ui->checkBox_snapper_enabletimeline->isChecked());
+    loadRetentionPreview(name);
+}
+
+// Loads the snapshots of @p config and their exclusive sizes into the retention simulator and fills the preview table
+void BtrfsAssistant::loadRetentionPreview(const QString &config) {
+    const QVector<SnapperSnapshots> snapshots = snapperSnapshots.value(config);
+    retentionSimulator.setSnapshots(snapshots);
+
+    // The sizes take two btrfs commands which can be slow with many snapshots, they are read in the background and the
+    // estimate is added once they arrive.  Sizes for a config which is no longer shown are dropped
+    retentionSimulator.setExclusiveSizes({});
+    retentionSizesLoading = true;
+    const QString subvolume = ui->label_snapper_backup_path->text();
+    auto *watcher = new QFutureWatcher<QHash<int, qint64>>(this);
+    connect(watcher, &QFutureWatcher<QHash<int, qint64>>::finished, this, [this, watcher, load = ++retentionSizesLoads] {
+        watcher->deleteLater();
+        if (load != retentionSizesLoads)
+            return;
+
+        retentionSizesLoading = false;
+        retentionSimulator.setExclusiveSizes(watcher->result());
+        updateRetentionPreview();
+    });
+    watcher->setFuture(QtConcurrent::run([backend = backend.data(), subvolume] { return readExclusiveSizes(*backend, subvolume); }));
+
+    // The table is only filled here, updateRetentionPreview() just updates the result column
+    QTableWidget *table = ui->tableWidget_snapper_retention;
+    table->clear();
+    table->setColumnCount(4);
+    table->setHorizontalHeaderItem(0, new QTableWidgetItem(tr("Number", "The number associated with a snapshot")));
+    table->setHorizontalHeaderItem(1, new QTableWidgetItem(tr("Date/Time")));
+    table->setHorizontalHeaderItem(2, new QTableWidgetItem(tr("Cleanup")));
+    table->setHorizontalHeaderItem(3, new QTableWidgetItem(tr("Result")));
+    table->setRowCount(snapshots.size());
+    for (int i = 0; i < snapshots.size(); i++) {
+        QTableWidgetItem *number = new QTableWidgetItem();
+        number->setData(Qt::DisplayRole, snapshots.at(i).number);
+        table->setItem(i, 0, number);
+        table->setItem(i, 1, new QTableWidgetItem(snapshots.at(i).time));
+        table->setItem(i, 2, new QTableWidgetItem(snapshots.at(i).cleanup));
+        table->setItem(i, 3, new QTableWidgetItem());
+    }
+    table->resizeColumnsToContents();
+
+    updateRetentionPreview();
+}
+
+// Runs the retention simulation with the limits currently shown in the spinboxes
+void BtrfsAssistant::updateRetentionPreview() {
+    retentionLimits.hourly = ui->spinBox_snapper_hourly->value();
+    retentionLimits.daily = ui->spinBox_snapper_daily->value();
+    retentionLimits.weekly = ui->spinBox_snapper_weekly->value();
+    retentionLimits.monthly = ui->spinBox_snapper_monthly->value();
+    retentionLimits.yearly = ui->spinBox_snapper_yearly->value();
+    retentionLimits.number = ui->spinBox_snapper_pacman->value();
+
+    const QVector<bool> kept = retentionSimulator.simulate(retentionLimits);
+
+    const QString keepText = tr("Keep");
+    const QString deleteText = tr("Delete");
+    int deleted = 0;
+    QTableWidget *table = ui->tableWidget_snapper_retention;
+    table->setUpdatesEnabled(false);
+    for (int i = 0; i < kept.size() && i < table->rowCount(); i++) {
+        if (!kept.at(i))
+            deleted++;
+        table->item(i, 3)->setText(kept.at(i) ? keepText : deleteText);
+    }
+    table->setUpdatesEnabled(true);
+
+    QString summary = tr("With these settings %1 of %2 snapshots would be kept and %3 would be deleted.")
+                          .arg(kept.size() - deleted)
+                          .arg(kept.size())
+                          .arg(deleted);
+    if (retentionSimulator.hasExclusiveSizes())
+        summary += " " + tr("At least %1 would be freed.").arg(toHumanReadable(retentionSimulator.reclaimedSize(kept)));
+    else if (retentionSizesLoading)
+        summary += " " + tr("Reading the snapshot sizes...");
+    else
+        summary += " " + tr("Enable quotas to estimate the space that would be freed.");
+    ui->label_snapper_retention_summary->setText(summary);
 }
 
 // Enables or disables the timeline spinboxes to match the timeline checkbox
@@ -1195,15 +2545,37 @@ void BtrfsAssistant::on_pushButton_snapper_delete_config_clicked() {
     }
 
     // Ask for confirmation
-    if (QMessageBox::question(0, tr("Please Confirm"),
-                              tr("Are you sure you want to delete ") + name + "\n\n" + tr("This action cannot be undone")) !=
+    const QString warning = undoRetention > 0 ? tr("The config and its snapshots can be undone from the undo history for %1 hours.  "
+                                                   "The space the snapshots take up isn't freed until then")
+                                                    .arg(undoRetention / 3600)
+                                              : tr("This action cannot be undone");
+    if (QMessageBox::question(0, tr("Please Confirm"), tr("Are you sure you want to delete ") + name + "\n\n" + warning) !=
         QMessageBox::Yes) {
         ui->pushButton_snapper_delete_config->clearFocus();
         return;
     }
 
+    // Save the config and keep read-only snapshots of its snapshots, deleting the config deletes them
+    const QString uuid = readFilesystemUuid(snapperConfigs.value(name));
+    std::optional<TopLevelMount> topLevel;
+    qint64 undoId = 0;
+    if (undoRetention > 0) {
+        QString error = tr("Failed to mount the filesystem");
+        topLevel.emplace(topLevelMounts, uuid);
+        if (topLevel->isValid() && undoJournal.recordConfigDelete(topLevel->path(), uuid, name, error))
+            undoId = undoJournal.entries().last().id;
+        else if (QMessageBox::question(0, tr("Confirm"),
+                                       tr("The delete can't be undone:") + "\n\n" + error + "\n\n" + tr("Delete it anyway?")) !=
+                 QMessageBox::Yes) {
+            ui->pushButton_snapper_delete_config->clearFocus();
+            return;
+        }
+    }
+
     // Delete the config
-    runCmd("snapper -c " + name + " delete-config", false);
+    if (runCmd("snapper -c " + name + " delete-config", false).exitCode != 0 && undoId != 0)
+        undoJournal.discard(undoId, topLevel->path());
+    pruneUndoJournal();
 
     // Reload the UI with the new list of configs
     loadSnapper();
@@ -1250,7 +2622,7 @@ void BtrfsAssistant::on_pushButton_restore_snapshot_clicked() {
         return;
     }
 
-    QString subvolName = ui->comboBox_snapper_configs->currentText();
+    QString subvolName = snapperRowConfig(ui->tableWidget_snapper->currentRow());
     QString subvol = ui->tableWidget_snapper->item(ui->tableWidget_snapper->currentRow(), 0)->text();
 
     // These shouldn't be possible but check anyway
@@ -1305,90 +2677,57 @@ void BtrfsAssistant::loadSnapperRestoreMode() {
 
     // Clear the existing info
     snapperSubvolumes.clear();
+    snapshotIndexStale = true;
     ui->comboBox_snapper_configs->clear();
 
-    // Get a list of the btrfs filesystems and loop over them
-    const QStringList btrfsFilesystems = getBTRFSFilesystems();
-    for (const QString &uuid : btrfsFilesystems) {
-        // First get a mountpoint associated with uuid
-        QString output = runCmd("findmnt --real -nlo UUID,TARGET | grep " + uuid + " | head -n 1", false).output;
-
-        if (output.isEmpty())
-            continue;
-
-        QString target = output.split(' ').at(1);
-
-        if (target.isEmpty())
-            continue;
-
-        // Now we can get all the subvolumes tied to that mountpoint
-        output = runCmd("btrfs subvolume list " + target, false).output;
-
-        if (output.isEmpty())
+    // Read the mount table once.  The first mountpoint of each filesystem is used for the ioctls and a mount of the top
+    // level subvolume, if there is one, to read the snapper metadata
+    QMap<QString, QString> targets;
+    QMap<QString, QString> topLevels;
+    QString rootPrefix = "root";
+    const QByteArray mounts = backend->run("findmnt --real -rn -t btrfs -o UUID,TARGET,OPTIONS");
+    LineTokenizer mountLines(mounts);
+    std::string_view line;
+    while (mountLines.next(line)) {
+        const QString uuid = toQString(word(line, 0));
+        const QString target = toQString(word(line, 1)).replace("\\x20", " ");
+        if (uuid.isEmpty() || target.isEmpty())
             continue;
 
-        // We need to ensure the root is mounted and get the mountpoint
-        QString mountpoint = mountRoot(uuid);
-
-        // Ensure it has a trailing /
-        if (mountpoint.right(1) != "/")
-            mountpoint += "/";
-
-        QStringList outputList = output.split('\n');
-        for (const QString &line : outputList) {
-            SnapperSubvolume subvol;
-            if (line.isEmpty())
-                continue;
-
-            subvol.uuid = uuid;
-            subvol.subvolid = line.split(' ').at(1).trimmed();
-            subvol.subvol = line.split(' ').at(8).trimmed();
-
-            // Check if it is snapper snapshot
-            if (!isSnapper(subvol.subvol))
-                continue;
-
-            // It is a snapshot so now we parse it and read the snapper XML
-            QString end = "snapshot";
-            QString filename = subvol.subvol.left(subvol.subvol.length() - end.length()) + "info.xml";
-
-            // If the normal root is mounted the root snapshots will be at /.snapshots
-            if (subvol.subvol.startsWith(".snapshots"))
-                filename = QDir::cleanPath(QDir::separator() + filename);
-            else
-                filename = QDir::cleanPath(mountpoint + filename);
-
-            SnapperSnapshots snap = getSnapperMeta(filename);
+        if (!targets.contains(uuid))
+            targets[uuid] = target;
+
+        const QStringList options = toQString(word(line, 2)).split(',');
+        for (const QString &option : options) {
+            if (option == "subvolid=5")
+                topLevels[uuid] = target;
+
+            // Snapshots of the subvolume mounted at / are grouped under its name
+            if (target == "/" && option.startsWith("subvol=")) {
+                QString subvol = option.mid(QString("subvol=").length());
+                if (subvol.startsWith("/"))
+                    subvol = subvol.mid(1);
+                if (!subvol.isEmpty())
+                    rootPrefix = subvol;
+            }
+        }
+    }
 
-            if (snap.number == 0)
-                continue;
+    for (auto it = targets.constBegin(); it != targets.constEnd(); ++it) {
+        const QString &uuid = it.key();
 
-            subvol.desc = snap.desc;
-            subvol.time = snap.time;
+        // Nothing has changed on the filesystem since the snapshots were last read if the generation is the same
+        const quint64 generation = backend->generation(it.value());
+        if (!isCurrent(restoreStamps.value(uuid), generation)) {
+            const quint64 committed = backend->committedGeneration(it.value());
+            restoreSnapshots[uuid] = findSnapperSubvolumes(*backend, topLevelMounts, uuid, it.value(), topLevels.value(uuid));
+            updateStamp(restoreStamps[uuid], generation, committed);
+        }
 
+        const QVector<SnapperSubvolume> subvols = restoreSnapshots.value(uuid);
+        for (const SnapperSubvolume &subvol : subvols) {
             QString prefix = subvol.subvol.split(".snapshots").at(0).trimmed();
-
-            if (prefix == "") {
-                QString optionsOutput = runCmd("LANG=C findmnt -no options /", false).output.trimmed();
-                if (optionsOutput.isEmpty())
-                    return;
-
-                QString subvolOption;
-                const QStringList optionsList = optionsOutput.split(',');
-                for (const QString &option : optionsList) {
-                    if (option.startsWith("subvol="))
-                        subvolOption = option.split("subvol=").at(1);
-                }
-                if (subvolOption.startsWith("/"))
-                    subvolOption = subvolOption.right(subvolOption.length() - 1);
-
-                if (subvolOption.isEmpty())
-                    prefix = "root";
-                else
-                    prefix = subvolOption;
-            } else
-                prefix = prefix.left(prefix.length() - 1);
-
+            prefix = prefix.isEmpty() ? rootPrefix : prefix.left(prefix.length() - 1);
             snapperSubvolumes[prefix].append(subvol);
         }
     }
@@ -1,21 +1,43 @@
 #ifndef BTRFSASSISTANT_H
 #define BTRFSASSISTANT_H
 
+#include <QDBusPendingCallWatcher>
 #include <QDir>
 #include <QFile>
 #include <QMainWindow>
 #include <QMap>
 #include <QMessageBox>
 #include <QProcess>
+#include <QScopedPointer>
 #include <QSet>
 #include <QSettings>
 #include <QSignalMapper>
 #include <QThread>
 #include <QTime>
+#include <QTimer>
 #include <QTranslator>
 #include <QUuid>
 #include <QXmlStreamReader>
 
+#include "backend.h"
+#include "btrfsdiscovery.h"
+#include "btrfsioctl.h"
+#include "dedupe.h"
+#include "extentscanner.h"
+#include "filerestore.h"
+#include "helperclient.h"
+#include "mountmanager.h"
+#include "outputparsers.h"
+#include "raidprofile.h"
+#include "replication.h"
+#include "retention.h"
+#include "shellconfig.h"
+#include "snapshotindex.h"
+#include "snapshotrestore.h"
+#include "snapshottimeline.h"
+#include "systemd.h"
+#include "undojournal.h"
+
 QT_BEGIN_NAMESPACE
 namespace Ui {
 class BtrfsAssistant;
@@ -27,76 +49,90 @@ struct Result {
     QString output;
 };
 
-struct Btrfs {
-    QString mountPoint;
-    long totalSize;
-    long allocatedSize;
-    long usedSize;
-    long freeSize;
-    long dataSize;
-    long dataUsed;
-    long metaSize;
-    long metaUsed;
-    long sysSize;
-    long sysUsed;
-    QMap<QString, QString> subVolumes;
-};
-
-struct SnapperSnapshots {
-    int number;
-    QString time;
-    QString desc;
-};
-
-struct SnapperSubvolume {
-    QString subvol;
-    QString subvolid;
-    QString time;
-    QString desc;
-    QString uuid;
-};
-
 class BtrfsAssistant : public QMainWindow {
     Q_OBJECT
 
   protected:
-    QSet<QString> unitsEnabledSet;
+    // Where the state of the system is read from, see Backend
+    QScopedPointer<Backend> backend;
+    SystemdUnits *systemdUnits;
     QHash<QString, QCheckBox *> configCheckBoxes;
     QMap<QString, Btrfs> fsMap;
+    QHash<QString, QHash<quint64, BtrfsDevStats>> lastDevStats;
+    QTimer *devStatsTimer;
 
     QStringList bmFreqValues = {"none", "daily", "weekly", "monthly"};
 
+    // The unit checkboxes the user changed since they were last applied
     QSet<QCheckBox *> changedCheckBoxes;
     QMap<QString, QString> snapperConfigs;
     QMap<QString, QVector<SnapperSnapshots>> snapperSnapshots;
+    // Counts the calls of loadSnapper(), the snapshots listed by the helper arrive later and belong to one of them
+    quint64 snapperLoads = 0;
     QMap<QString, QVector<SnapperSubvolume>> snapperSubvolumes;
+    // The restore mode snapshots of each filesystem and the generation of the filesystem when they were read
+    QMap<QString, QVector<SnapperSubvolume>> restoreSnapshots;
+    QMap<QString, GenerationStamp> restoreStamps;
+    // The chunk map of each filesystem and the generation of the filesystem when it was read.  The chunk tree is walked
+    // in the background, a filesystem is in chunkMapsLoading while that runs
+    QMap<QString, BtrfsChunkMap> chunkMaps;
+    QMap<QString, GenerationStamp> chunkMapStamps;
+    QSet<QString> chunkMapsLoading;
+    // The mounts of the top level of each filesystem made for the operations needing one
+    MountManager topLevelMounts;
+    // Only set when running unprivileged, which the unprivileged setting chooses over relaunching as root.  The subvolumes,
+    // usage, snapshots and restores then go through the helper and the rest of the operations are disabled
+    QScopedPointer<HelperClient> helper;
+    SnapshotIndex snapshotIndex;
+    bool snapshotIndexStale = true;
     bool hasSnapper = false;
     bool hasBtrfsmaintenance = false;
     bool isSnapBoot = false;
     QSettings *settings;
-    QSettings *bmSettings;
+    ShellConfig bmConfig;
     QString btrfsmaintenanceConfig;
-    QSettings::Format bmFormat;
-
+    RetentionSimulator retentionSimulator;
+    RetentionLimits retentionLimits;
+    // The exclusive sizes for the preview are read in the background, only the reply to the latest read is used
+    quint64 retentionSizesLoads = 0;
+    bool retentionSizesLoading = false;
+    // The destructive operations which can still be undone and for how long, in seconds.  Only kept when running as root
+    UndoJournal undoJournal{undoJournalPath};
+    qint64 undoRetention = 0;
+
+    QList<QCheckBox *> unitCheckBoxes();
     void refreshInterface();
-    void loadEnabledUnits();
     void setupConfigBoxes();
+    void setupInterface();
     void apply();
     void loadBTRFS();
     void populateBtrfsUi(const QString &uuid);
+    void populateChunkMap(const QString &uuid);
+    void populateDeviceHealth(const QString &uuid);
+    void populateDeviceUsage(const QString &uuid);
     void populateSubvolList(const QString &uuid);
+    void showExtentScanResult(const ExtentScanResult &result, const QString &subvol, bool pathsMounted);
+    void showSnapshotBrowser(const QString &snapshotPath, const QString &liveRoot, const QString &title);
+    void loadSubvolumes(const QString &uuid);
     void reloadSubvolList(const QString &uuid);
     void loadSnapper();
     void populateSnapperGrid();
+    void populateSnapperSearch(const QString &query);
+    QString snapperRowConfig(int row);
     void populateSnapperConfigSettings();
     void restoreSnapshot(const QString &uuid, QString subvolume);
+    QDBusPendingCallWatcher *restoreSnapshotWithHelper(const HelperClient &helper, const QString &uuid, QString subvolume);
     void switchToSnapperRestore();
     QMap<QString, QString> getSnapshotBoot();
     void enableRestoreMode(bool enable);
     void loadSnapperRestoreMode();
     void snapperTimelineEnable(bool enable);
+    void loadRetentionPreview(const QString &config);
+    void updateRetentionPreview();
     void populateBmTab();
+    void pruneUndoJournal();
     void updateServices(QList<QCheckBox *>);
+    void disableRootOnly();
 
   public:
     explicit BtrfsAssistant(QWidget *parent = 0);
@@ -119,17 +155,25 @@ class BtrfsAssistant : public QMainWindow {
     void on_comboBox_btrfsdevice_activated(int);
     void on_comboBox_snapper_configs_activated(int);
     void on_comboBox_snapper_config_settings_activated(int);
+    void on_lineEdit_snapper_search_textChanged(const QString &);
     void on_pushButton_bmApply_clicked();
+    void on_pushButton_dedupe_clicked();
     void on_pushButton_deletesubvol_clicked();
     void on_pushButton_load_clicked();
     void on_pushButton_loadsubvol_clicked();
     void on_pushButton_restore_snapshot_clicked();
+    void on_pushButton_scanextents_clicked();
+    void on_pushButton_snapper_browse_clicked();
     void on_pushButton_snapper_create_clicked();
     void on_pushButton_snapper_delete_clicked();
     void on_pushButton_snapper_delete_config_clicked();
+    void on_pushButton_snapper_edit_clicked();
+    void on_pushButton_snapper_replicate_clicked();
     void on_pushButton_snapper_new_config_clicked();
     void on_pushButton_snapper_save_config_clicked();
+    void on_pushButton_snapper_timeline_clicked();
     void on_pushButton_SnapperUnitsApply_clicked();
+    void on_pushButton_undo_clicked();
 
   private:
     Ui::BtrfsAssistant *ui;
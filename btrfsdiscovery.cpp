@@ -0,0 +1,205 @@
+#include "btrfsdiscovery.h"
+#include "tokenizer.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QHash>
+#include <QUuid>
+
+#ifdef HAVE_BLKID
+#include <blkid/blkid.h>
+#endif
+
+#include <algorithm>
+#include <cstdlib>
+
+// Every mounted btrfs filesystem has a directory named after its uuid in here
+static const QString sysfsBtrfs = "/sys/fs/btrfs/";
+
+// Returns the trimmed contents of a sysfs attribute
+static QByteArray readAttribute(const QString &path) {
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll().trimmed() : QByteArray();
+}
+
+// A btrfs mount from /proc/self/mountinfo
+struct BtrfsMount {
+    // The kernel name of the device it was mounted from, such as sda2 or dm-0
+    QString device;
+    // The path of the mounted subvolume in the filesystem, / for the top level
+    QString root;
+    QString mountpoint;
+};
+
+static QVector<BtrfsMount> btrfsMounts() {
+    QVector<BtrfsMount> mounts;
+    QFile mountinfo("/proc/self/mountinfo");
+    if (!mountinfo.open(QIODevice::ReadOnly))
+        return mounts;
+
+    const QByteArray data = mountinfo.readAll();
+    LineTokenizer lines(data);
+    std::string_view line;
+    while (lines.next(line)) {
+        // The optional fields end with a lone -, the filesystem type and the mount source follow it
+        const size_t separator = line.find(" - ");
+        if (separator == std::string_view::npos)
+            continue;
+
+        const std::string_view fields = line.substr(separator + 3);
+        if (word(fields, 0) != "btrfs")
+            continue;
+
+        // The source is often a symlink such as /dev/mapper/root, the kernel name is that of the node it points to
+        const QString device = QFileInfo(unescapeMountPath(word(fields, 1))).canonicalFilePath();
+        const QString name = device.mid(device.lastIndexOf('/') + 1);
+        if (!name.isEmpty())
+            mounts.append({name, unescapeMountPath(word(line, 3)), unescapeMountPath(word(line, 4))});
+    }
+
+    return mounts;
+}
+
+// Returns the kernel names of the devices of the mounted filesystem @p uuid
+static QStringList sysfsDevices(const QString &uuid) {
+    return QDir(sysfsBtrfs + uuid + "/devices").entryList(QDir::AllEntries | QDir::System | QDir::NoDotAndDotDot, QDir::Name);
+}
+
+// Returns the first of @p mounts made from one of @p devices, only considering mounts of the top level subvolume if
+// @p topLevel is set.  Returns an empty string if there is none
+static QString findMountpoint(const QVector<BtrfsMount> &mounts, const QStringList &devices, bool topLevel) {
+    for (const BtrfsMount &mount : mounts) {
+        if (devices.contains(mount.device) && (!topLevel || mount.root == "/"))
+            return mount.mountpoint;
+    }
+
+    return QString();
+}
+
+#ifdef HAVE_BLKID
+// Adds the btrfs filesystems libblkid finds on the block devices which aren't in @p filesystems yet
+static void probeBlockDevices(QVector<BtrfsFilesystem> &filesystems) {
+    // A cache of our own that is thrown away afterwards, so nothing stale from /run/blkid is trusted
+    blkid_cache cache = nullptr;
+    if (blkid_get_cache(&cache, "/dev/null") != 0)
+        return;
+    blkid_probe_all(cache);
+
+    QHash<QString, int> known;
+    for (int i = 0; i < filesystems.size(); i++)
+        known.insert(filesystems.at(i).uuid, i);
+    const int mounted = filesystems.size();
+
+    blkid_dev_iterate iter = blkid_dev_iterate_begin(cache);
+    blkid_dev_set_search(iter, "TYPE", "btrfs");
+    blkid_dev dev = nullptr;
+    while (blkid_dev_next(iter, &dev) == 0) {
+        const char *devname = blkid_dev_devname(dev);
+        char *uuid = blkid_get_tag_value(cache, "UUID", devname);
+        char *label = blkid_get_tag_value(cache, "LABEL", devname);
+
+        // Every device of a filesystem made of several has the same uuid
+        const QString uuidString = QString::fromLatin1(uuid);
+        if (!uuidString.isEmpty()) {
+            int index = known.value(uuidString, -1);
+            if (index < 0) {
+                BtrfsFilesystem filesystem;
+                filesystem.uuid = uuidString;
+                filesystem.label = QString::fromUtf8(label);
+                index = filesystems.size();
+                known.insert(uuidString, index);
+                filesystems.append(filesystem);
+            }
+
+            if (index >= mounted)
+                filesystems[index].devices.append(QFile::decodeName(devname));
+        }
+
+        free(uuid);
+        free(label);
+    }
+    blkid_dev_iterate_end(iter);
+    blkid_put_cache(cache);
+
+    std::sort(filesystems.begin() + mounted, filesystems.end(),
+              [](const BtrfsFilesystem &a, const BtrfsFilesystem &b) { return a.uuid < b.uuid; });
+}
+#endif
+
+QVector<BtrfsFilesystem> discoverFilesystems(bool probeUnmounted) {
+    QVector<BtrfsFilesystem> filesystems;
+    const QVector<BtrfsMount> mounts = btrfsMounts();
+
+    const QStringList entries = QDir(sysfsBtrfs).entryList(QDir::Dirs | QDir::NoDotAndDotDot, QDir::Name);
+    for (const QString &uuid : entries) {
+        // The features supported by the kernel are in here too
+        if (QUuid::fromString(uuid).isNull())
+            continue;
+
+        const QString base = sysfsBtrfs + uuid + "/";
+        BtrfsFilesystem filesystem;
+        filesystem.uuid = uuid;
+        filesystem.label = QString::fromUtf8(readAttribute(base + "label"));
+
+        const QStringList devices = sysfsDevices(uuid);
+        for (const QString &device : devices)
+            filesystem.devices.append("/dev/" + device);
+        filesystem.mountpoint = findMountpoint(mounts, devices, false);
+
+        filesystem.features = QDir(base + "features").entryList(QDir::Files, QDir::Name);
+        filesystem.dataTotal = readAttribute(base + "allocation/data/total_bytes").toULongLong();
+        filesystem.dataUsed = readAttribute(base + "allocation/data/bytes_used").toULongLong();
+        filesystem.metadataTotal = readAttribute(base + "allocation/metadata/total_bytes").toULongLong();
+        filesystem.metadataUsed = readAttribute(base + "allocation/metadata/bytes_used").toULongLong();
+        filesystem.systemTotal = readAttribute(base + "allocation/system/total_bytes").toULongLong();
+        filesystem.systemUsed = readAttribute(base + "allocation/system/bytes_used").toULongLong();
+        filesystems.append(filesystem);
+    }
+
+#ifdef HAVE_BLKID
+    if (probeUnmounted)
+        probeBlockDevices(filesystems);
+#else
+    Q_UNUSED(probeUnmounted);
+#endif
+
+    return filesystems;
+}
+
+QString findBtrfsMountpoint(const QString &uuid) {
+    if (QUuid::fromString(uuid).isNull())
+        return QString();
+
+    return findMountpoint(btrfsMounts(), sysfsDevices(uuid), false);
+}
+
+QString findTopLevelMountpoint(const QString &uuid) {
+    if (QUuid::fromString(uuid).isNull())
+        return QString();
+
+    return findMountpoint(btrfsMounts(), sysfsDevices(uuid), true);
+}
+
+bool isTopLevelMountpoint(const QString &uuid, const QString &path) {
+    if (QUuid::fromString(uuid).isNull())
+        return false;
+
+    const QStringList devices = sysfsDevices(uuid);
+    const QVector<BtrfsMount> mounts = btrfsMounts();
+    return std::any_of(mounts.cbegin(), mounts.cend(), [&](const BtrfsMount &mount) {
+        return mount.mountpoint == path && mount.root == "/" && devices.contains(mount.device);
+    });
+}
+
+QStringList findBtrfsDevices(const QString &uuid) {
+    QStringList devices;
+    if (QUuid::fromString(uuid).isNull())
+        return devices;
+
+    const QStringList names = sysfsDevices(uuid);
+    for (const QString &name : names)
+        devices.append("/dev/" + name);
+
+    return devices;
+}
@@ -0,0 +1,45 @@
+#ifndef BTRFSDISCOVERY_H
+#define BTRFSDISCOVERY_H
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// A btrfs filesystem found on the system, mounted or not
+struct BtrfsFilesystem {
+    QString uuid;
+    QString label;
+    // The device nodes of its devices
+    QStringList devices;
+    // Where it is mounted, the first mount in /proc/self/mountinfo.  Empty if it isn't mounted
+    QString mountpoint;
+    // The rest below is only known for mounted filesystems.  The feature names are those of /sys/fs/btrfs/<uuid>/features
+    QStringList features;
+    // The logical allocated and used bytes of each block group type
+    quint64 dataTotal = 0;
+    quint64 dataUsed = 0;
+    quint64 metadataTotal = 0;
+    quint64 metadataUsed = 0;
+    quint64 systemTotal = 0;
+    quint64 systemUsed = 0;
+};
+
+// Finds the btrfs filesystems on the system.  Mounted ones are read from /sys/fs/btrfs and /proc/self/mountinfo without
+// running any commands.  With @p probeUnmounted the block devices are also probed with libblkid for filesystems which
+// aren't mounted, which needs root to read the devices and is skipped unless built with HAVE_BLKID, which only the
+// inventory export is.  Mounted filesystems come first, sorted by uuid
+QVector<BtrfsFilesystem> discoverFilesystems(bool probeUnmounted = false);
+
+// Returns where the filesystem @p uuid is mounted, or an empty string if it isn't
+QString findBtrfsMountpoint(const QString &uuid);
+
+// Returns where the top level subvolume of the filesystem @p uuid is mounted, or an empty string if it isn't
+QString findTopLevelMountpoint(const QString &uuid);
+
+// Returns true if the top level subvolume of the filesystem @p uuid is mounted at @p path
+bool isTopLevelMountpoint(const QString &uuid, const QString &path);
+
+// Returns the device nodes of the mounted filesystem @p uuid
+QStringList findBtrfsDevices(const QString &uuid);
+
+#endif // BTRFSDISCOVERY_H
@@ -0,0 +1,641 @@
+#include "btrfsioctl.h"
+#include "tokenizer.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QUuid>
+
+#include <cstring>
+
+#include <fcntl.h>
+#include <endian.h>
+#include <linux/btrfs.h>
+#include <linux/btrfs_tree.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Opens a directory on a btrfs filesystem for use with the btrfs ioctls.  Returns -1 on failure
+static int openBtrfsDir(const QString &path) { return open(path.toLocal8Bit().constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC); }
+
+QVector<BtrfsDevStats> readDevStats(const QString &mountpoint) {
+    QVector<BtrfsDevStats> devices;
+
+    const int fd = openBtrfsDir(mountpoint);
+    if (fd < 0)
+        return devices;
+
+    btrfs_ioctl_fs_info_args fsInfo = {};
+    if (ioctl(fd, BTRFS_IOC_FS_INFO, &fsInfo) < 0) {
+        close(fd);
+        return devices;
+    }
+
+    // Device ids may have gaps after a device has been removed so every id up to max_id is tried
+    for (quint64 devid = 1; devid <= fsInfo.max_id; devid++) {
+        btrfs_ioctl_dev_info_args devInfo = {};
+        devInfo.devid = devid;
+        if (ioctl(fd, BTRFS_IOC_DEV_INFO, &devInfo) < 0)
+            continue;
+
+        btrfs_ioctl_get_dev_stats stats = {};
+        stats.devid = devid;
+        stats.nr_items = BTRFS_DEV_STAT_VALUES_MAX;
+        if (ioctl(fd, BTRFS_IOC_GET_DEV_STATS, &stats) < 0)
+            continue;
+
+        BtrfsDevStats device;
+        device.devid = devid;
+        device.path = QString::fromLocal8Bit(reinterpret_cast<const char *>(devInfo.path));
+        device.writeErrors = stats.values[BTRFS_DEV_STAT_WRITE_ERRS];
+        device.readErrors = stats.values[BTRFS_DEV_STAT_READ_ERRS];
+        device.flushErrors = stats.values[BTRFS_DEV_STAT_FLUSH_ERRS];
+        device.corruptionErrors = stats.values[BTRFS_DEV_STAT_CORRUPTION_ERRS];
+        device.generationErrors = stats.values[BTRFS_DEV_STAT_GENERATION_ERRS];
+        devices.append(device);
+    }
+
+    close(fd);
+    return devices;
+}
+
+// Returns the name btrfs-progs uses for the profile in the block group @p flags
+static QString profileName(quint64 flags) {
+    if (flags & BTRFS_BLOCK_GROUP_DUP)
+        return "DUP";
+    if (flags & BTRFS_BLOCK_GROUP_RAID0)
+        return "RAID0";
+    if (flags & BTRFS_BLOCK_GROUP_RAID1)
+        return "RAID1";
+    if (flags & BTRFS_BLOCK_GROUP_RAID1C3)
+        return "RAID1C3";
+    if (flags & BTRFS_BLOCK_GROUP_RAID1C4)
+        return "RAID1C4";
+    if (flags & BTRFS_BLOCK_GROUP_RAID10)
+        return "RAID10";
+    if (flags & BTRFS_BLOCK_GROUP_RAID5)
+        return "RAID5";
+    if (flags & BTRFS_BLOCK_GROUP_RAID6)
+        return "RAID6";
+
+    return "single";
+}
+
+bool readSpaceUsage(const QString &mountpoint, BtrfsSpaceUsage &usage) {
+    const int fd = openBtrfsDir(mountpoint);
+    if (fd < 0)
+        return false;
+
+    btrfs_ioctl_fs_info_args fsInfo = {};
+    btrfs_ioctl_space_args count = {};
+    if (ioctl(fd, BTRFS_IOC_FS_INFO, &fsInfo) < 0 || ioctl(fd, BTRFS_IOC_SPACE_INFO, &count) < 0) {
+        close(fd);
+        return false;
+    }
+
+    // The first call only returns the number of entries
+    QByteArray buffer(sizeof(btrfs_ioctl_space_args) + count.total_spaces * sizeof(btrfs_ioctl_space_info), 0);
+    auto *spaces = reinterpret_cast<btrfs_ioctl_space_args *>(buffer.data());
+    spaces->space_slots = count.total_spaces;
+    if (ioctl(fd, BTRFS_IOC_SPACE_INFO, spaces) < 0) {
+        close(fd);
+        return false;
+    }
+
+    usage = BtrfsSpaceUsage();
+    usage.fsid = QByteArray(reinterpret_cast<const char *>(fsInfo.fsid), BTRFS_FSID_SIZE);
+    quint64 largestData = 0;
+    quint64 largestMetadata = 0;
+    for (quint64 i = 0; i < spaces->total_spaces; i++) {
+        const btrfs_ioctl_space_info &space = spaces->spaces[i];
+        if (space.flags & BTRFS_SPACE_INFO_GLOBAL_RSV) {
+            usage.globalReserve = space.total_bytes;
+            continue;
+        }
+
+        // The logical size is reported, the profile with the most space is the one new chunks are allocated with
+        if (space.flags & BTRFS_BLOCK_GROUP_DATA) {
+            usage.dataTotal += space.total_bytes;
+            usage.dataUsed += space.used_bytes;
+            if (space.total_bytes >= largestData) {
+                largestData = space.total_bytes;
+                usage.dataProfile = profileName(space.flags);
+            }
+        } else if (space.flags & BTRFS_BLOCK_GROUP_METADATA) {
+            usage.metadataTotal += space.total_bytes;
+            usage.metadataUsed += space.used_bytes;
+            if (space.total_bytes >= largestMetadata) {
+                largestMetadata = space.total_bytes;
+                usage.metadataProfile = profileName(space.flags);
+            }
+        }
+    }
+
+    for (quint64 devid = 1; devid <= fsInfo.max_id; devid++) {
+        btrfs_ioctl_dev_info_args devInfo = {};
+        devInfo.devid = devid;
+        if (ioctl(fd, BTRFS_IOC_DEV_INFO, &devInfo) == 0)
+            usage.unallocated.append(devInfo.total_bytes - devInfo.bytes_used);
+    }
+
+    close(fd);
+    return true;
+}
+
+// Returns the raw space each stripe of a chunk takes up on its device
+static quint64 stripeSize(quint64 length, quint64 flags, quint64 stripes, quint64 subStripes) {
+    if ((flags & BTRFS_BLOCK_GROUP_RAID0) && stripes > 0)
+        return length / stripes;
+    if ((flags & BTRFS_BLOCK_GROUP_RAID10) && stripes > 0)
+        return length * subStripes / stripes;
+    if ((flags & BTRFS_BLOCK_GROUP_RAID5) && stripes > 1)
+        return length / (stripes - 1);
+    if ((flags & BTRFS_BLOCK_GROUP_RAID6) && stripes > 2)
+        return length / (stripes - 2);
+
+    return length;
+}
+
+// Looks up the used bytes of the block group of a chunk in @p tree.  Returns false if the item isn't there
+static bool readBlockGroupUsed(int fd, quint64 tree, const BtrfsChunk &chunk, quint64 &used) {
+    btrfs_ioctl_search_args args = {};
+    btrfs_ioctl_search_key &key = args.key;
+    key.tree_id = tree;
+    key.min_objectid = key.max_objectid = chunk.logical;
+    key.min_type = key.max_type = BTRFS_BLOCK_GROUP_ITEM_KEY;
+    key.min_offset = key.max_offset = chunk.length;
+    key.max_transid = UINT64_MAX;
+    key.nr_items = 1;
+
+    if (ioctl(fd, BTRFS_IOC_TREE_SEARCH, &args) < 0 || key.nr_items == 0)
+        return false;
+
+    const auto *header = reinterpret_cast<const btrfs_ioctl_search_header *>(args.buf);
+    const auto *item = reinterpret_cast<const btrfs_block_group_item *>(args.buf + sizeof(*header));
+    used = le64toh(item->used);
+    return true;
+}
+
+bool readChunkMap(const QString &mountpoint, BtrfsChunkMap &map) {
+    const int fd = openBtrfsDir(mountpoint);
+    if (fd < 0)
+        return false;
+
+    map = BtrfsChunkMap();
+    btrfs_ioctl_fs_info_args fsInfo = {};
+    if (ioctl(fd, BTRFS_IOC_FS_INFO, &fsInfo) < 0) {
+        close(fd);
+        return false;
+    }
+
+    for (quint64 devid = 1; devid <= fsInfo.max_id; devid++) {
+        btrfs_ioctl_dev_info_args devInfo = {};
+        devInfo.devid = devid;
+        if (ioctl(fd, BTRFS_IOC_DEV_INFO, &devInfo) == 0)
+            map.deviceSizes.insert(devid, devInfo.total_bytes);
+    }
+
+    // Every item of the chunk tree from the first chunk objectid on is a chunk item, keyed by its logical address
+    btrfs_ioctl_search_args args = {};
+    btrfs_ioctl_search_key &key = args.key;
+    key.tree_id = BTRFS_CHUNK_TREE_OBJECTID;
+    key.min_objectid = key.max_objectid = BTRFS_FIRST_CHUNK_TREE_OBJECTID;
+    key.min_type = key.max_type = BTRFS_CHUNK_ITEM_KEY;
+    key.min_offset = 0;
+    key.max_offset = UINT64_MAX;
+    key.max_transid = UINT64_MAX;
+
+    while (true) {
+        key.nr_items = 4096;
+        if (ioctl(fd, BTRFS_IOC_TREE_SEARCH, &args) < 0) {
+            close(fd);
+            return false;
+        }
+        if (key.nr_items == 0)
+            break;
+
+        size_t pos = 0;
+        quint64 lastOffset = 0;
+        for (quint32 i = 0; i < key.nr_items; i++) {
+            const auto *header = reinterpret_cast<const btrfs_ioctl_search_header *>(args.buf + pos);
+            const auto *item = reinterpret_cast<const btrfs_chunk *>(args.buf + pos + sizeof(*header));
+            pos += sizeof(*header) + header->len;
+            lastOffset = header->offset;
+
+            BtrfsChunk chunk;
+            chunk.logical = header->offset;
+            chunk.length = le64toh(item->length);
+            chunk.flags = le64toh(item->type);
+            const quint16 stripes = le16toh(item->num_stripes);
+            chunk.stripeSize = stripeSize(chunk.length, chunk.flags, stripes, le16toh(item->sub_stripes));
+            // The stripes follow the chunk item, the struct only declares the first one
+            const btrfs_stripe *stripe = &item->stripe;
+            for (quint16 n = 0; n < stripes; n++)
+                chunk.stripes.append({le64toh(stripe[n].devid), le64toh(stripe[n].offset)});
+            map.chunks.append(chunk);
+        }
+
+        if (lastOffset == UINT64_MAX)
+            break;
+        key.min_offset = lastOffset + 1;
+    }
+
+    // Block group items are in their own tree when the filesystem has the block-group-tree feature and in the extent tree
+    // otherwise.  Each one is looked up by its exact key so the extent items in between are never read
+    quint64 blockGroupTree = BTRFS_BLOCK_GROUP_TREE_OBJECTID;
+    for (BtrfsChunk &chunk : map.chunks) {
+        if (!readBlockGroupUsed(fd, blockGroupTree, chunk, chunk.used) && blockGroupTree != BTRFS_EXTENT_TREE_OBJECTID) {
+            blockGroupTree = BTRFS_EXTENT_TREE_OBJECTID;
+            readBlockGroupUsed(fd, blockGroupTree, chunk, chunk.used);
+        }
+    }
+
+    close(fd);
+    return true;
+}
+
+QString blockGroupDescription(quint64 flags) {
+    QString type;
+    if ((flags & BTRFS_BLOCK_GROUP_DATA) && (flags & BTRFS_BLOCK_GROUP_METADATA))
+        type = "Data+Metadata";
+    else if (flags & BTRFS_BLOCK_GROUP_DATA)
+        type = "Data";
+    else if (flags & BTRFS_BLOCK_GROUP_METADATA)
+        type = "Metadata";
+    else
+        type = "System";
+
+    return type + ", " + profileName(flags);
+}
+
+QVector<BtrfsScrubStatus> readScrubStatus(const QString &uuid) {
+    QVector<BtrfsScrubStatus> devices;
+
+    QFile statusFile("/var/lib/btrfs/scrub.status." + uuid);
+    if (!statusFile.open(QIODevice::ReadOnly))
+        return devices;
+
+    // Each device is a line of the form <fsid>:<devid>|key:value|key:value...
+    const QByteArray contents = statusFile.readAll();
+    LineTokenizer lines(contents);
+    std::string_view line;
+    while (lines.next(line)) {
+        const std::string_view header = field(line, '|', 0);
+        if (header.find(':') == std::string_view::npos || header.starts_with("scrub status"))
+            continue;
+
+        BtrfsScrubStatus device;
+        device.devid = toLong(field(header, ':', 1));
+        for (int i = 1;; i++) {
+            const std::string_view item = field(line, '|', i);
+            if (item.empty())
+                break;
+
+            const std::string_view key = field(item, ':', 0);
+            const long value = toLong(field(item, ':', 1));
+            if (key == "read_errors")
+                device.readErrors = value;
+            else if (key == "csum_errors")
+                device.csumErrors = value;
+            else if (key == "verify_errors")
+                device.verifyErrors = value;
+            else if (key == "super_errors")
+                device.superErrors = value;
+            else if (key == "uncorrectable_errors")
+                device.uncorrectableErrors = value;
+            else if (key == "corrected_errors")
+                device.correctedErrors = value;
+            else if (key == "t_start")
+                device.startTime = value;
+            else if (key == "duration")
+                device.duration = value;
+            else if (key == "finished")
+                device.finished = value != 0;
+        }
+        devices.append(device);
+    }
+
+    return devices;
+}
+
+QVector<BtrfsQgroup> readQgroups(const QString &uuid) {
+    QVector<BtrfsQgroup> qgroups;
+
+    // Each qgroup is a directory named <level>_<id>
+    const QString qgroupsDir = "/sys/fs/btrfs/" + uuid + "/qgroups";
+    const QStringList entries = QDir(qgroupsDir).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &entry : entries) {
+        bool levelOk = false;
+        bool idOk = false;
+        BtrfsQgroup qgroup;
+        qgroup.level = entry.section('_', 0, 0).toUShort(&levelOk);
+        qgroup.id = entry.section('_', 1, 1).toULongLong(&idOk);
+        if (!levelOk || !idOk)
+            continue;
+
+        const auto readValue = [&qgroupsDir, &entry](const char *name) {
+            QFile file(qgroupsDir + "/" + entry + "/" + name);
+            return file.open(QIODevice::ReadOnly) ? file.readAll().trimmed().toULongLong() : 0;
+        };
+        qgroup.referenced = readValue("referenced");
+        qgroup.exclusive = readValue("exclusive");
+        qgroup.maxReferenced = readValue("max_referenced");
+        qgroup.maxExclusive = readValue("max_exclusive");
+        qgroups.append(qgroup);
+    }
+
+    return qgroups;
+}
+
+// Returns the raw bytes of @p uuid or an empty array if it is all zeros
+static QByteArray uuidBytes(const quint8 *uuid) {
+    for (int i = 0; i < BTRFS_UUID_SIZE; i++) {
+        if (uuid[i] != 0)
+            return QByteArray(reinterpret_cast<const char *>(uuid), BTRFS_UUID_SIZE);
+    }
+
+    return QByteArray();
+}
+
+bool readSubvolInfo(const QString &path, BtrfsSubvolInfo &info) {
+    const int fd = openBtrfsDir(path);
+    if (fd < 0)
+        return false;
+
+    // The ioctl describes the subvolume containing the path, the root directory of a subvolume always has the same inode
+    struct stat st;
+    btrfs_ioctl_get_subvol_info_args args = {};
+    const bool ok = fstat(fd, &st) == 0 && st.st_ino == BTRFS_FIRST_FREE_OBJECTID && ioctl(fd, BTRFS_IOC_GET_SUBVOL_INFO, &args) == 0;
+    close(fd);
+    if (!ok)
+        return false;
+
+    info.treeId = args.treeid;
+    info.generation = args.generation;
+    info.uuid = uuidBytes(args.uuid);
+    info.parentUuid = uuidBytes(args.parent_uuid);
+    info.receivedUuid = uuidBytes(args.received_uuid);
+    info.readOnly = args.flags & BTRFS_SUBVOL_RDONLY;
+    return true;
+}
+
+QVector<BtrfsSubvolume> listSubvolumes(const QString &mountpoint) {
+    QVector<BtrfsSubvolume> subvolumes;
+    const int fd = openBtrfsDir(mountpoint);
+    if (fd < 0)
+        return subvolumes;
+
+    // Each ROOT_REF item in the root tree is keyed by the parent and child subvolume ids and holds the name of the child
+    // and the directory of the parent it is in
+    struct Ref {
+        quint64 parent;
+        QString name;
+    };
+    QMap<quint64, Ref> refs;
+
+    btrfs_ioctl_search_args args = {};
+    btrfs_ioctl_search_key &key = args.key;
+    key.tree_id = BTRFS_ROOT_TREE_OBJECTID;
+    key.min_objectid = BTRFS_FS_TREE_OBJECTID;
+    key.max_objectid = BTRFS_LAST_FREE_OBJECTID;
+    key.min_type = key.max_type = BTRFS_ROOT_REF_KEY;
+    key.min_offset = 0;
+    key.max_offset = UINT64_MAX;
+    key.max_transid = UINT64_MAX;
+
+    while (true) {
+        key.nr_items = 4096;
+        if (ioctl(fd, BTRFS_IOC_TREE_SEARCH, &args) < 0) {
+            close(fd);
+            return subvolumes;
+        }
+        if (key.nr_items == 0)
+            break;
+
+        size_t pos = 0;
+        const btrfs_ioctl_search_header *header = nullptr;
+        for (quint32 i = 0; i < key.nr_items; i++) {
+            header = reinterpret_cast<const btrfs_ioctl_search_header *>(args.buf + pos);
+            const auto *item = reinterpret_cast<const btrfs_root_ref *>(args.buf + pos + sizeof(*header));
+            pos += sizeof(*header) + header->len;
+            if (header->type != BTRFS_ROOT_REF_KEY)
+                continue;
+
+            QByteArray name(reinterpret_cast<const char *>(item + 1), le16toh(item->name_len));
+
+            // A subvolume which isn't directly in the root directory of its parent needs the path of that directory
+            const quint64 dirid = le64toh(item->dirid);
+            if (dirid != BTRFS_FIRST_FREE_OBJECTID) {
+                btrfs_ioctl_ino_lookup_args lookup = {};
+                lookup.treeid = header->objectid;
+                lookup.objectid = dirid;
+                if (ioctl(fd, BTRFS_IOC_INO_LOOKUP, &lookup) == 0)
+                    name.prepend(lookup.name);
+            }
+
+            refs.insert(header->offset, {header->objectid, QFile::decodeName(name)});
+        }
+
+        // Continue after the last item returned
+        key.min_objectid = header->objectid;
+        key.min_type = header->type;
+        key.min_offset = header->offset + 1;
+        if (header->offset == UINT64_MAX)
+            break;
+    }
+    close(fd);
+
+    for (auto it = refs.constBegin(); it != refs.constEnd(); ++it) {
+        // Build the path by following the parents up to the top level, a parent which was deleted leaves it unreachable
+        QString path = it->name;
+        quint64 parent = it->parent;
+        while (parent != BTRFS_FS_TREE_OBJECTID && refs.contains(parent)) {
+            path.prepend(refs.value(parent).name + "/");
+            parent = refs.value(parent).parent;
+        }
+
+        if (parent == BTRFS_FS_TREE_OBJECTID)
+            subvolumes.append({it.key(), it->parent, path});
+    }
+
+    return subvolumes;
+}
+
+quint64 readGeneration(const QString &mountpoint) {
+    const int fd = openBtrfsDir(mountpoint);
+    if (fd < 0)
+        return 0;
+
+    btrfs_ioctl_fs_info_args fsInfo = {};
+    fsInfo.flags = BTRFS_FS_INFO_FLAG_GENERATION;
+    const bool ok = ioctl(fd, BTRFS_IOC_FS_INFO, &fsInfo) == 0;
+    close(fd);
+    if (!ok)
+        return 0;
+
+    if (fsInfo.flags & BTRFS_FS_INFO_FLAG_GENERATION)
+        return fsInfo.generation;
+
+    // Kernels before 5.15 don't fill in the generation but those from 5.11 on have it in sysfs
+    const QString fsid = QUuid::fromRfc4122(QByteArray(reinterpret_cast<const char *>(fsInfo.fsid), BTRFS_FSID_SIZE))
+                             .toString(QUuid::WithoutBraces);
+    QFile file("/sys/fs/btrfs/" + fsid + "/generation");
+    if (!file.open(QIODevice::ReadOnly))
+        return 0;
+
+    return file.readAll().trimmed().toULongLong();
+}
+
+// Where the primary superblock is on each device and where its fields are in it
+static const off_t superblockOffset = 64 * 1024;
+static const int superblockFsidOffset = 32;
+static const int superblockMagicOffset = 64;
+static const int superblockGenerationOffset = 72;
+static const char superblockMagic[] = "_BHRfS_M";
+
+quint64 readCommittedGeneration(const QString &mountpoint) {
+    const int fd = openBtrfsDir(mountpoint);
+    if (fd < 0)
+        return 0;
+
+    // The superblock is written to every device at the end of each commit, any of them will do
+    btrfs_ioctl_fs_info_args fsInfo = {};
+    btrfs_ioctl_dev_info_args devInfo = {};
+    bool hasDevice = false;
+    if (ioctl(fd, BTRFS_IOC_FS_INFO, &fsInfo) == 0) {
+        for (quint64 devid = 1; devid <= fsInfo.max_id && !hasDevice; devid++) {
+            devInfo = {};
+            devInfo.devid = devid;
+            hasDevice = ioctl(fd, BTRFS_IOC_DEV_INFO, &devInfo) == 0;
+        }
+    }
+    close(fd);
+    if (!hasDevice)
+        return 0;
+
+    const int deviceFd = open(reinterpret_cast<const char *>(devInfo.path), O_RDONLY | O_CLOEXEC);
+    if (deviceFd < 0)
+        return 0;
+
+    char superblock[superblockGenerationOffset + sizeof(quint64)];
+    const bool ok = pread(deviceFd, superblock, sizeof(superblock), superblockOffset) == sizeof(superblock);
+    close(deviceFd);
+    if (!ok || memcmp(superblock + superblockMagicOffset, superblockMagic, sizeof(superblockMagic) - 1) != 0 ||
+        memcmp(superblock + superblockFsidOffset, fsInfo.fsid, BTRFS_FSID_SIZE) != 0)
+        return 0;
+
+    quint64 generation = 0;
+    memcpy(&generation, superblock + superblockGenerationOffset, sizeof(generation));
+    return le64toh(generation);
+}
+
+QString readFilesystemUuid(const QString &path) {
+    const int fd = openBtrfsDir(path);
+    if (fd < 0)
+        return QString();
+
+    btrfs_ioctl_fs_info_args fsInfo = {};
+    const bool ok = ioctl(fd, BTRFS_IOC_FS_INFO, &fsInfo) == 0;
+    close(fd);
+    if (!ok)
+        return QString();
+
+    return QUuid::fromRfc4122(QByteArray(reinterpret_cast<const char *>(fsInfo.fsid), BTRFS_FSID_SIZE)).toString(QUuid::WithoutBraces);
+}
+
+// The default commit interval with some slack for the transaction thread waking up late.  A filesystem mounted with a
+// longer commit= interval can show changes made within the first transaction late
+static const qint64 commitSettleTime = 2 * 30 * 1000;
+
+bool isCurrent(const GenerationStamp &stamp, quint64 generation) {
+    return generation != 0 && stamp.settled && stamp.generation == generation;
+}
+
+void updateStamp(GenerationStamp &stamp, quint64 generation, quint64 committed) {
+    const qint64 now = QElapsedTimer::msecsSinceReference();
+    if (generation == 0 || generation != stamp.generation)
+        stamp = {generation, now, false};
+
+    // The data was read after the transaction was committed, the settle time is only a fallback for when that isn't known
+    stamp.settled = generation != 0 && (committed >= generation || now - stamp.firstSeen >= commitSettleTime);
+}
+
+bool isReadOnlySubvolume(const QString &path) {
+    const int fd = openBtrfsDir(path);
+    if (fd < 0)
+        return false;
+
+    quint64 flags = 0;
+    const bool readOnly = ioctl(fd, BTRFS_IOC_SUBVOL_GETFLAGS, &flags) == 0 && (flags & BTRFS_SUBVOL_RDONLY);
+    close(fd);
+    return readOnly;
+}
+
+bool isSubvolume(const QString &path) {
+    // The root directory of every subvolume has the same inode number
+    struct stat st = {};
+    return stat(QFile::encodeName(path).constData(), &st) == 0 && S_ISDIR(st.st_mode) && st.st_ino == BTRFS_FIRST_FREE_OBJECTID;
+}
+
+// Opens the parent directory of @p path and sets @p name to the last component of @p path.  Returns -1 on failure
+static int openParent(const QString &path, QByteArray &name) {
+    const QString cleanPath = QDir::cleanPath(path);
+    const int slash = cleanPath.lastIndexOf('/');
+    name = QFile::encodeName(cleanPath.mid(slash + 1));
+    return openBtrfsDir(slash <= 0 ? QStringLiteral("/") : cleanPath.left(slash));
+}
+
+bool createSnapshot(const QString &source, const QString &destination, bool readOnly) {
+    QByteArray name;
+    const int parentFd = openParent(destination, name);
+    if (parentFd < 0)
+        return false;
+
+    const int sourceFd = openBtrfsDir(source);
+    bool ok = false;
+    if (sourceFd >= 0 && name.size() <= BTRFS_SUBVOL_NAME_MAX) {
+        btrfs_ioctl_vol_args_v2 args = {};
+        args.fd = sourceFd;
+        args.flags = readOnly ? BTRFS_SUBVOL_RDONLY : 0;
+        qstrncpy(args.name, name.constData(), sizeof(args.name));
+        ok = ioctl(parentFd, BTRFS_IOC_SNAP_CREATE_V2, &args) == 0;
+    }
+
+    if (sourceFd >= 0)
+        close(sourceFd);
+    close(parentFd);
+    return ok;
+}
+
+bool deleteSubvolume(const QString &path) {
+    QByteArray name;
+    const int parentFd = openParent(path, name);
+    if (parentFd < 0)
+        return false;
+
+    btrfs_ioctl_vol_args args = {};
+    qstrncpy(args.name, name.constData(), sizeof(args.name));
+    const bool ok = ioctl(parentFd, BTRFS_IOC_SNAP_DESTROY, &args) == 0;
+    close(parentFd);
+    return ok;
+}
+
+quint64 readInodeTransid(int fd, quint64 ino) {
+    btrfs_ioctl_search_args args = {};
+    btrfs_ioctl_search_key &key = args.key;
+    key.tree_id = 0;
+    key.min_objectid = key.max_objectid = ino;
+    key.min_type = key.max_type = BTRFS_INODE_ITEM_KEY;
+    key.min_offset = 0;
+    key.max_offset = UINT64_MAX;
+    key.max_transid = UINT64_MAX;
+    key.nr_items = 1;
+
+    if (ioctl(fd, BTRFS_IOC_TREE_SEARCH, &args) < 0 || key.nr_items == 0)
+        return 0;
+
+    const auto *header = reinterpret_cast<const btrfs_ioctl_search_header *>(args.buf);
+    const auto *item = reinterpret_cast<const btrfs_inode_item *>(args.buf + sizeof(*header));
+    return le64toh(item->transid);
+}
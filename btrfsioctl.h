@@ -0,0 +1,182 @@
+#ifndef BTRFSIOCTL_H
+#define BTRFSIOCTL_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+/*
+ *
+ * Thin wrappers around the btrfs ioctls.  These talk to the kernel directly instead of spawning btrfs-progs so they
+ * are cheap enough to call on a timer.
+ *
+ */
+
+// The error counters the kernel keeps for a single device
+struct BtrfsDevStats {
+    quint64 devid = 0;
+    QString path;
+    quint64 writeErrors = 0;
+    quint64 readErrors = 0;
+    quint64 flushErrors = 0;
+    quint64 corruptionErrors = 0;
+    quint64 generationErrors = 0;
+};
+
+// The result of the last scrub of a single device as recorded by btrfs-progs
+struct BtrfsScrubStatus {
+    quint64 devid = 0;
+    quint64 readErrors = 0;
+    quint64 csumErrors = 0;
+    quint64 verifyErrors = 0;
+    quint64 superErrors = 0;
+    quint64 uncorrectableErrors = 0;
+    quint64 correctedErrors = 0;
+    qint64 startTime = 0;
+    qint64 duration = 0;
+    bool finished = false;
+};
+
+// The space of a filesystem as the kernel accounts it.  Unlike btrfs fi usage this doesn't need root
+struct BtrfsSpaceUsage {
+    QByteArray fsid;
+    quint64 dataTotal = 0;
+    quint64 dataUsed = 0;
+    quint64 metadataTotal = 0;
+    quint64 metadataUsed = 0;
+    quint64 globalReserve = 0;
+    QString dataProfile;
+    QString metadataProfile;
+    // The unallocated raw space of each device
+    QVector<quint64> unallocated;
+};
+
+// Fills @p usage for the filesystem mounted at @p mountpoint.  Returns false on failure
+bool readSpaceUsage(const QString &mountpoint, BtrfsSpaceUsage &usage);
+
+// A chunk with the location of its stripes and how much of its block group is used
+struct BtrfsChunk {
+    quint64 logical = 0;
+    quint64 length = 0;
+    quint64 used = 0;
+    // The BTRFS_BLOCK_GROUP_* type and profile flags
+    quint64 flags = 0;
+    // The raw space each stripe takes up on its device
+    quint64 stripeSize = 0;
+    // The device id and physical offset of each stripe
+    QVector<QPair<quint64, quint64>> stripes;
+};
+
+struct BtrfsChunkMap {
+    QVector<BtrfsChunk> chunks;
+    // The size of each device by device id
+    QMap<quint64, quint64> deviceSizes;
+};
+
+// Reads the chunk tree and the block group items of the filesystem mounted at @p mountpoint.  Returns false on failure.
+// Requires root
+bool readChunkMap(const QString &mountpoint, BtrfsChunkMap &map);
+
+// Returns the type and profile of a chunk with the block group @p flags, such as "Metadata, DUP"
+QString blockGroupDescription(quint64 flags);
+
+// Returns the error counters of each device in the filesystem mounted at @p mountpoint.  Returns an empty vector on failure
+QVector<BtrfsDevStats> readDevStats(const QString &mountpoint);
+
+// Returns the per device results of the last scrub of the filesystem @p uuid, read from the status file btrfs scrub
+// writes under /var/lib/btrfs.  Returns an empty vector if the filesystem has never been scrubbed
+QVector<BtrfsScrubStatus> readScrubStatus(const QString &uuid);
+
+// The space accounted to a qgroup and its limits, a limit of 0 means there is none.  The qgroup of a subvolume has level 0
+// and the subvolume id as its id
+struct BtrfsQgroup {
+    quint16 level = 0;
+    quint64 id = 0;
+    quint64 referenced = 0;
+    quint64 exclusive = 0;
+    quint64 maxReferenced = 0;
+    quint64 maxExclusive = 0;
+};
+
+// Returns the qgroups of the filesystem @p uuid as the kernel exports them in sysfs, which unlike the quota tree doesn't
+// need root.  Returns an empty vector when quotas are disabled or the kernel is older than 5.9
+QVector<BtrfsQgroup> readQgroups(const QString &uuid);
+
+// The identity of a subvolume, the uuids are the raw 16 bytes and are empty when unset
+struct BtrfsSubvolInfo {
+    quint64 treeId = 0;
+    quint64 generation = 0;
+    QByteArray uuid;
+    QByteArray parentUuid;
+    QByteArray receivedUuid;
+    bool readOnly = false;
+};
+
+// Fills @p info for the subvolume whose root is @p path.  Returns false if @p path isn't a subvolume or on failure
+bool readSubvolInfo(const QString &path, BtrfsSubvolInfo &info);
+
+// A subvolume with its path from the top level subvolume
+struct BtrfsSubvolume {
+    quint64 id = 0;
+    // The id of the subvolume it is directly inside of
+    quint64 parentId = 0;
+    QString path;
+};
+
+// Lists the subvolumes of the filesystem mounted at @p mountpoint the same way as btrfs subvolume list, from the root tree
+// without running btrfs-progs.  Returns an empty vector on failure.  Requires root
+QVector<BtrfsSubvolume> listSubvolumes(const QString &mountpoint);
+
+// Returns the id of the newest transaction of the filesystem mounted at @p mountpoint, which moves whenever a transaction
+// starts to change something on it.  Returns 0 on failure or when the kernel is too old to report it
+quint64 readGeneration(const QString &mountpoint);
+
+// Returns the generation of the last transaction committed to the filesystem mounted at @p mountpoint, from the superblock
+// of one of its devices.  Returns 0 on failure.  Requires root
+quint64 readCommittedGeneration(const QString &mountpoint);
+
+// Returns the uuid of the btrfs filesystem @p path is on, or an empty string on failure
+QString readFilesystemUuid(const QString &path);
+
+// Records the generation some data about a filesystem was read at, to tell whether it needs to be read again.
+//
+// The generation only moves when a new transaction starts, so changes made later in the transaction that was running when
+// the data was read don't move it.  The data is only known to be current once it was read after that transaction was
+// committed.  That is known right away when the committed generation could be read, otherwise it is assumed once the
+// commit interval has passed since the generation was first seen.
+struct GenerationStamp {
+    quint64 generation = 0;
+    // When the generation was first seen, in milliseconds of the monotonic clock
+    qint64 firstSeen = 0;
+    // Set once the data was read after the transaction of the generation was committed
+    bool settled = false;
+};
+
+// Returns true if data read with @p stamp is still current for a filesystem whose generation is now @p generation
+bool isCurrent(const GenerationStamp &stamp, quint64 generation);
+
+// Updates @p stamp for data that has just been read.  @p generation and @p committed, the committed generation or 0 if it
+// isn't known, must be read before the data
+void updateStamp(GenerationStamp &stamp, quint64 generation, quint64 committed);
+
+// Returns true if @p path is the root of a read-only subvolume such as a snapper snapshot
+bool isReadOnlySubvolume(const QString &path);
+
+// Returns true if @p path is the root of a subvolume
+bool isSubvolume(const QString &path);
+
+// Creates @p destination as a snapshot of the subvolume @p source, which is instant whatever the size of @p source.  The
+// parent directory of @p destination has to exist.  Returns false on failure
+bool createSnapshot(const QString &source, const QString &destination, bool readOnly);
+
+// Deletes the subvolume @p path.  A subvolume with other subvolumes nested in it can't be deleted.  Returns false on
+// failure.  Requires root
+bool deleteSubvolume(const QString &path);
+
+// Returns the id of the transaction which last modified inode @p ino in the subvolume containing the open file or
+// directory @p fd.  Returns 0 on failure.  Requires root
+quint64 readInodeTransid(int fd, quint64 ino);
+
+#endif // BTRFSIOCTL_H
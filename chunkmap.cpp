@@ -0,0 +1,262 @@
+#include "chunkmap.h"
+
+#include <QHelpEvent>
+#include <QLocale>
+#include <QMouseEvent>
+#include <QPainter>
+#include <QToolTip>
+#include <QWheelEvent>
+
+#include <algorithm>
+
+// The space between the bands of two devices
+static const int bandGap = 4;
+// The smallest number of bytes a pixel can cover when zoomed in
+static const quint64 minBytesPerPixel = 4096;
+
+static QString dataSize(quint64 bytes) { return QLocale().formattedDataSize(bytes); }
+
+static const QColor unallocatedColor(48, 48, 48);
+
+// Blends from the unallocated color to a heat color running from green for empty chunks to red for full ones
+static QRgb cellColor(double allocatedFraction, double fill) {
+    const QColor heat = QColor::fromHsvF((1 - qBound(0.0, fill, 1.0)) / 3, 0.85, 0.9);
+    const double a = qBound(0.0, allocatedFraction, 1.0);
+    return qRgb(unallocatedColor.red() + (heat.red() - unallocatedColor.red()) * a,
+                unallocatedColor.green() + (heat.green() - unallocatedColor.green()) * a,
+                unallocatedColor.blue() + (heat.blue() - unallocatedColor.blue()) * a);
+}
+
+ChunkMap::ChunkMap(QWidget *parent) : QWidget(parent) {
+    setMinimumHeight(48);
+    setSizePolicy(QSizePolicy::Expanding, QSizePolicy::Preferred);
+}
+
+void ChunkMap::setChunkMap(const BtrfsChunkMap &map) {
+    chunkMap = map;
+    devices.clear();
+    largestDevice = 0;
+
+    for (auto it = map.deviceSizes.constBegin(); it != map.deviceSizes.constEnd(); ++it) {
+        devices.append({it.key(), it.value(), {}, {}, {}});
+        largestDevice = qMax(largestDevice, it.value());
+    }
+
+    for (int i = 0; i < map.chunks.size(); i++) {
+        for (const auto &stripe : map.chunks.at(i).stripes) {
+            auto device = std::find_if(devices.begin(), devices.end(), [&stripe](const Device &d) { return d.devid == stripe.first; });
+            if (device != devices.end())
+                device->stripes.append({stripe.second, map.chunks.at(i).stripeSize, i});
+        }
+    }
+
+    for (Device &device : devices) {
+        std::sort(device.stripes.begin(), device.stripes.end(), [](const Stripe &a, const Stripe &b) { return a.offset < b.offset; });
+
+        // A stripe holds its share of the used bytes of the chunk
+        quint64 allocated = 0;
+        double used = 0;
+        for (const Stripe &stripe : qAsConst(device.stripes)) {
+            device.allocatedBefore.append(allocated);
+            device.usedBefore.append(used);
+            const BtrfsChunk &chunk = map.chunks.at(stripe.chunk);
+            allocated += stripe.size;
+            used += chunk.length == 0 ? 0 : static_cast<double>(chunk.used) * stripe.size / chunk.length;
+        }
+        device.allocatedBefore.append(allocated);
+        device.usedBefore.append(used);
+    }
+
+    viewStart = 0;
+    viewLength = largestDevice;
+    updateGeometry();
+    render();
+    update();
+}
+
+QSize ChunkMap::sizeHint() const { return QSize(400, qMax(48, devices.size() * (32 + bandGap))); }
+
+// Sets @p allocated and @p used to the bytes allocated and used on @p device before @p offset
+void ChunkMap::allocatedAndUsed(const Device &device, quint64 offset, quint64 &allocated, double &used) const {
+    auto it = std::upper_bound(device.stripes.constBegin(), device.stripes.constEnd(), offset,
+                               [](quint64 value, const Stripe &stripe) { return value < stripe.offset; });
+    if (it == device.stripes.constBegin()) {
+        allocated = 0;
+        used = 0;
+        return;
+    }
+
+    --it;
+    const int index = it - device.stripes.constBegin();
+    const quint64 inside = qMin(offset - it->offset, it->size);
+    const double stripeUsed = device.usedBefore.at(index + 1) - device.usedBefore.at(index);
+    allocated = device.allocatedBefore.at(index) + inside;
+    used = device.usedBefore.at(index) + (it->size == 0 ? 0 : stripeUsed * inside / it->size);
+}
+
+int ChunkMap::bandHeight() const {
+    if (devices.isEmpty())
+        return 0;
+
+    return qMax(4, (height() - bandGap * (devices.size() - 1)) / devices.size());
+}
+
+// Finds the device and byte under @p pos.  Returns false if @p pos is between bands
+bool ChunkMap::byteAt(const QPoint &pos, int &device, quint64 &offset) const {
+    const int band = bandHeight();
+    if (band == 0 || pos.x() < 0 || pos.x() >= width() || pos.y() < 0)
+        return false;
+
+    device = pos.y() / (band + bandGap);
+    const int row = pos.y() - device * (band + bandGap);
+    if (device >= devices.size() || row >= band)
+        return false;
+
+    const double bytesPerPixel = static_cast<double>(viewLength) / (static_cast<quint64>(width()) * band);
+    offset = viewStart + static_cast<quint64>((static_cast<double>(row) * width() + pos.x()) * bytesPerPixel);
+    return true;
+}
+
+void ChunkMap::clampView() {
+    const quint64 pixels = static_cast<quint64>(qMax(1, width())) * qMax(1, bandHeight());
+    viewLength = qBound(qMin(pixels * minBytesPerPixel, largestDevice), viewLength, largestDevice);
+    viewStart = qMin(viewStart, largestDevice - viewLength);
+}
+
+void ChunkMap::render() {
+    image = QImage(size(), QImage::Format_ARGB32_Premultiplied);
+    image.fill(Qt::transparent);
+
+    const int band = bandHeight();
+    if (band == 0 || viewLength == 0 || width() == 0)
+        return;
+
+    const int columns = width();
+    const double bytesPerPixel = static_cast<double>(viewLength) / (static_cast<quint64>(columns) * band);
+    for (int d = 0; d < devices.size(); d++) {
+        const Device &device = devices.at(d);
+        quint64 allocated = 0;
+        double used = 0;
+        allocatedAndUsed(device, viewStart, allocated, used);
+
+        for (int row = 0; row < band; row++) {
+            const int y = d * (band + bandGap) + row;
+            if (y >= image.height())
+                break;
+
+            auto *line = reinterpret_cast<QRgb *>(image.scanLine(y));
+            for (int x = 0; x < columns; x++) {
+                const double pixel = static_cast<double>(row) * columns + x;
+                const quint64 start = viewStart + static_cast<quint64>(pixel * bytesPerPixel);
+                const quint64 end = viewStart + static_cast<quint64>((pixel + 1) * bytesPerPixel);
+                if (start >= device.size)
+                    break;
+
+                // The end of one pixel is the start of the next so each pixel only needs one lookup
+                quint64 allocatedEnd = 0;
+                double usedEnd = 0;
+                allocatedAndUsed(device, qMin(end, device.size), allocatedEnd, usedEnd);
+                const quint64 pixelAllocated = allocatedEnd - allocated;
+                const double fill = pixelAllocated == 0 ? 0 : (usedEnd - used) / pixelAllocated;
+                line[x] = cellColor(end > start ? static_cast<double>(pixelAllocated) / (qMin(end, device.size) - start) : 0, fill);
+                allocated = allocatedEnd;
+                used = usedEnd;
+            }
+        }
+    }
+}
+
+bool ChunkMap::event(QEvent *event) {
+    if (event->type() != QEvent::ToolTip)
+        return QWidget::event(event);
+
+    auto *helpEvent = static_cast<QHelpEvent *>(event);
+    int index = 0;
+    quint64 offset = 0;
+    if (!byteAt(helpEvent->pos(), index, offset) || offset >= devices.at(index).size) {
+        QToolTip::hideText();
+        event->ignore();
+        return true;
+    }
+
+    const Device &device = devices.at(index);
+    QString text = tr("Device %1 at %2").arg(device.devid).arg(dataSize(offset));
+    auto stripe = std::upper_bound(device.stripes.constBegin(), device.stripes.constEnd(), offset,
+                                   [](quint64 value, const Stripe &s) { return value < s.offset; });
+    if (stripe != device.stripes.constBegin() && offset < std::prev(stripe)->offset + std::prev(stripe)->size) {
+        const BtrfsChunk &chunk = chunkMap.chunks.at(std::prev(stripe)->chunk);
+        text += "\n" + tr("%1 chunk at logical address %2").arg(blockGroupDescription(chunk.flags)).arg(chunk.logical);
+        text += "\n" + tr("%1 of %2 used").arg(dataSize(chunk.used)).arg(dataSize(chunk.length));
+    } else {
+        text += "\n" + tr("Unallocated");
+    }
+
+    QToolTip::showText(helpEvent->globalPos(), text, this);
+    return true;
+}
+
+void ChunkMap::mouseDoubleClickEvent(QMouseEvent *event) {
+    Q_UNUSED(event);
+    viewStart = 0;
+    viewLength = largestDevice;
+    render();
+    update();
+}
+
+void ChunkMap::mouseMoveEvent(QMouseEvent *event) {
+    if (!(event->buttons() & Qt::LeftButton) || bandHeight() == 0)
+        return;
+
+    // The bands are filled row by row, so moving up a row moves forward by a whole row of pixels
+    const double bytesPerPixel = static_cast<double>(viewLength) / (static_cast<quint64>(width()) * bandHeight());
+    const QPoint delta = event->pos() - dragStart;
+    const double moved = (static_cast<double>(delta.y()) * width() + delta.x()) * bytesPerPixel;
+    viewStart = static_cast<quint64>(qBound(0.0, dragViewStart - moved, static_cast<double>(largestDevice - viewLength)));
+    render();
+    update();
+}
+
+void ChunkMap::mousePressEvent(QMouseEvent *event) {
+    dragStart = event->pos();
+    dragViewStart = viewStart;
+}
+
+void ChunkMap::paintEvent(QPaintEvent *event) {
+    Q_UNUSED(event);
+    QPainter painter(this);
+    if (devices.isEmpty()) {
+        painter.drawText(rect(), Qt::AlignCenter, tr("No chunk information available"));
+        return;
+    }
+
+    painter.drawImage(0, 0, image);
+}
+
+void ChunkMap::resizeEvent(QResizeEvent *event) {
+    QWidget::resizeEvent(event);
+    clampView();
+    render();
+}
+
+void ChunkMap::wheelEvent(QWheelEvent *event) {
+    if (devices.isEmpty())
+        return;
+
+    int device = 0;
+    quint64 anchor = viewStart + viewLength / 2;
+    byteAt(event->position().toPoint(), device, anchor);
+
+    // Zoom around the byte under the cursor so it stays where it is
+    const double factor = event->angleDelta().y() > 0 ? 0.8 : 1.25;
+    const quint64 oldLength = viewLength;
+    viewLength = static_cast<quint64>(viewLength * factor);
+    clampView();
+    const double scale = static_cast<double>(viewLength) / oldLength;
+    const quint64 before = static_cast<quint64>((anchor - viewStart) * scale);
+    viewStart = anchor > before ? anchor - before : 0;
+    clampView();
+
+    render();
+    update();
+    event->accept();
+}
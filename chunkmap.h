@@ -0,0 +1,67 @@
+#ifndef CHUNKMAP_H
+#define CHUNKMAP_H
+
+#include "btrfsioctl.h"
+
+#include <QImage>
+#include <QWidget>
+
+// Draws where the chunks are on each device of a filesystem as a heat map of how full they are.  Each device gets a band
+// of its own which is filled row by row from the start of the device, unallocated space is left dark.
+//
+// Every pixel covers a range of bytes and shows the share of it that is allocated and how much of that is used.  The values
+// come from prefix sums over the stripes sorted by offset, so a pixel covering thousands of chunks costs the same two
+// binary searches as one inside a single chunk and large arrays redraw just as fast when zoomed out.  The wheel zooms,
+// dragging pans and a double click shows the whole device again.
+class ChunkMap : public QWidget {
+    Q_OBJECT
+
+  public:
+    explicit ChunkMap(QWidget *parent = nullptr);
+
+    void setChunkMap(const BtrfsChunkMap &map);
+    QSize sizeHint() const override;
+
+  protected:
+    bool event(QEvent *event) override;
+    void mouseDoubleClickEvent(QMouseEvent *event) override;
+    void mouseMoveEvent(QMouseEvent *event) override;
+    void mousePressEvent(QMouseEvent *event) override;
+    void paintEvent(QPaintEvent *event) override;
+    void resizeEvent(QResizeEvent *event) override;
+    void wheelEvent(QWheelEvent *event) override;
+
+  private:
+    struct Stripe {
+        quint64 offset;
+        quint64 size;
+        int chunk;
+    };
+
+    struct Device {
+        quint64 devid;
+        quint64 size;
+        QVector<Stripe> stripes;
+        // The allocated and used bytes before each stripe and after the last one
+        QVector<quint64> allocatedBefore;
+        QVector<double> usedBefore;
+    };
+
+    void allocatedAndUsed(const Device &device, quint64 offset, quint64 &allocated, double &used) const;
+    bool byteAt(const QPoint &pos, int &device, quint64 &offset) const;
+    int bandHeight() const;
+    void clampView();
+    void render();
+
+    BtrfsChunkMap chunkMap;
+    QVector<Device> devices;
+    // The bytes shown in each band, devices smaller than the largest one end early
+    quint64 viewStart = 0;
+    quint64 viewLength = 0;
+    quint64 largestDevice = 0;
+    QPoint dragStart;
+    quint64 dragViewStart = 0;
+    QImage image;
+};
+
+#endif // CHUNKMAP_H
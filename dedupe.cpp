@@ -0,0 +1,449 @@
+#include "dedupe.h"
+#include "btrfsioctl.h"
+
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <QMutexLocker>
+#include <QSaveFile>
+#include <QtConcurrent>
+
+#include <algorithm>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fiemap.h>
+#include <linux/fs.h>
+#include <queue>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// The unit of deduplication, large enough to keep the index small and matches the maximum compressed extent size
+static const quint64 blockSize = 128 * 1024;
+
+// Files smaller than this are usually stored inline in the metadata and can't be deduplicated
+static const quint64 minimumFileSize = 4096;
+
+// The most destinations passed to a single FIDEDUPERANGE call
+static const int maxDestinations = 64;
+
+// Bumped whenever the layout of the state file changes
+static const quint32 stateVersion = 1;
+
+// The size of a record in the state file, the file index is implied by the entry the record belongs to
+static const int stateRecordSize = sizeof(quint64) * 2 + sizeof(quint32);
+
+/*
+ *
+ * XXH64, a fast non-cryptographic hash.  Only used to find candidate blocks, the kernel verifies the data
+ *
+ */
+
+static const quint64 xxPrime1 = 0x9E3779B185EBCA87ULL;
+static const quint64 xxPrime2 = 0xC2B2AE3D27D4EB4FULL;
+static const quint64 xxPrime3 = 0x165667B19E3779F9ULL;
+static const quint64 xxPrime4 = 0x85EBCA77C2B2AE63ULL;
+static const quint64 xxPrime5 = 0x27D4EB2F165667C5ULL;
+
+static inline quint64 rotl64(quint64 value, int bits) { return (value << bits) | (value >> (64 - bits)); }
+
+static inline quint64 read64(const uchar *data) {
+    quint64 value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline quint32 read32(const uchar *data) {
+    quint32 value;
+    memcpy(&value, data, sizeof(value));
+    return value;
+}
+
+static inline quint64 xxRound(quint64 acc, quint64 input) { return rotl64(acc + input * xxPrime2, 31) * xxPrime1; }
+
+static inline quint64 xxMerge(quint64 acc, quint64 value) { return (acc ^ xxRound(0, value)) * xxPrime1 + xxPrime4; }
+
+static quint64 xxHash64(const uchar *data, size_t length, quint64 seed) {
+    const uchar *end = data + length;
+    quint64 hash;
+
+    if (length >= 32) {
+        quint64 v1 = seed + xxPrime1 + xxPrime2;
+        quint64 v2 = seed + xxPrime2;
+        quint64 v3 = seed;
+        quint64 v4 = seed - xxPrime1;
+        for (; data + 32 <= end; data += 32) {
+            v1 = xxRound(v1, read64(data));
+            v2 = xxRound(v2, read64(data + 8));
+            v3 = xxRound(v3, read64(data + 16));
+            v4 = xxRound(v4, read64(data + 24));
+        }
+        hash = rotl64(v1, 1) + rotl64(v2, 7) + rotl64(v3, 12) + rotl64(v4, 18);
+        hash = xxMerge(hash, v1);
+        hash = xxMerge(hash, v2);
+        hash = xxMerge(hash, v3);
+        hash = xxMerge(hash, v4);
+    } else {
+        hash = seed + xxPrime5;
+    }
+
+    hash += length;
+    for (; data + 8 <= end; data += 8)
+        hash = rotl64(hash ^ xxRound(0, read64(data)), 27) * xxPrime1 + xxPrime4;
+    if (data + 4 <= end) {
+        hash = rotl64(hash ^ (read32(data) * xxPrime1), 23) * xxPrime2 + xxPrime3;
+        data += 4;
+    }
+    for (; data < end; data++)
+        hash = rotl64(hash ^ (*data * xxPrime5), 11) * xxPrime1;
+
+    hash ^= hash >> 33;
+    hash *= xxPrime2;
+    hash ^= hash >> 29;
+    hash *= xxPrime3;
+    hash ^= hash >> 32;
+    return hash;
+}
+
+/*
+ *
+ * DedupeIndex
+ *
+ */
+
+static bool hashLessThan(const BlockRecord &a, const BlockRecord &b) { return a.hash < b.hash; }
+
+void DedupeIndex::add(const QVector<BlockRecord> &records) {
+    buffer += records;
+    if (static_cast<quint64>(buffer.size()) >= maxRecords)
+        spill();
+}
+
+// Sorts the buffered records and writes them out as a run
+void DedupeIndex::spill() {
+    std::sort(buffer.begin(), buffer.end(), hashLessThan);
+
+    auto run = QSharedPointer<QTemporaryFile>::create();
+    if (run->open()) {
+        run->write(reinterpret_cast<const char *>(buffer.constData()), buffer.size() * sizeof(BlockRecord));
+        run->flush();
+        runs.append(run);
+    }
+    buffer.clear();
+}
+
+void DedupeIndex::forEachGroup(const std::function<void(const QVector<BlockRecord> &)> &callback) {
+    QVector<BlockRecord> group;
+    const auto addToGroup = [&group, &callback](const BlockRecord &record) {
+        if (!group.isEmpty() && group.first().hash != record.hash) {
+            if (group.size() > 1)
+                callback(group);
+            group.clear();
+        }
+        group.append(record);
+    };
+
+    if (runs.isEmpty()) {
+        std::sort(buffer.begin(), buffer.end(), hashLessThan);
+        for (const BlockRecord &record : qAsConst(buffer))
+            addToGroup(record);
+    } else {
+        if (!buffer.isEmpty())
+            spill();
+
+        // Merge the sorted runs, the queue holds the next record of each run
+        using Head = QPair<BlockRecord, int>;
+        const auto headGreater = [](const Head &a, const Head &b) { return a.first.hash > b.first.hash; };
+        std::priority_queue<Head, std::vector<Head>, decltype(headGreater)> heads(headGreater);
+        const auto readNext = [this, &heads](int run) {
+            BlockRecord record;
+            if (runs.at(run)->read(reinterpret_cast<char *>(&record), sizeof(record)) == sizeof(record))
+                heads.push({record, run});
+        };
+
+        for (int i = 0; i < runs.size(); i++) {
+            runs.at(i)->seek(0);
+            readNext(i);
+        }
+
+        while (!heads.empty()) {
+            const Head head = heads.top();
+            heads.pop();
+            addToGroup(head.first);
+            readNext(head.second);
+        }
+    }
+
+    if (group.size() > 1)
+        callback(group);
+
+    buffer.clear();
+    runs.clear();
+}
+
+/*
+ *
+ * Deduplicator
+ *
+ */
+
+static void writeStateEntry(QDataStream &stream, const QByteArray &path, quint64 transid, const QVector<BlockRecord> &records) {
+    stream << path << transid << static_cast<quint32>(records.size());
+    for (const BlockRecord &record : records)
+        stream << record.hash << record.physical << record.block;
+}
+
+DedupeResult Deduplicator::run(const QString &root, const QStringList &subvolumes) {
+    DedupeResult result;
+    files.clear();
+    processedFiles = 0;
+    rootPath = QFile::encodeName(QDir::cleanPath(root));
+
+    for (const QString &subvolume : subvolumes)
+        collectFiles(QFile::encodeName(QDir::cleanPath(subvolume)), !isReadOnlySubvolume(root + "/" + subvolume));
+
+    // Index the previous state so the records of unchanged files can be read back instead of hashing the files again.  A
+    // count that runs past the end of the file means the state is corrupt, then nothing in it is trusted
+    QHash<QByteArray, QPair<quint64, qint64>> previous;
+    QFile oldState(statePath);
+    QDataStream oldStream(&oldState);
+    if (oldState.open(QIODevice::ReadOnly)) {
+        quint32 version = 0;
+        oldStream >> version;
+        while (version == stateVersion && !oldStream.atEnd()) {
+            QByteArray path;
+            quint64 transid;
+            oldStream >> path >> transid;
+            const qint64 countPos = oldState.pos();
+            quint32 count;
+            oldStream >> count;
+            if (oldStream.status() != QDataStream::Ok)
+                break;
+
+            const qint64 recordsSize = static_cast<qint64>(count) * stateRecordSize;
+            if (recordsSize > oldState.size() - oldState.pos()) {
+                previous.clear();
+                break;
+            }
+
+            previous.insert(path, {transid, countPos});
+            oldState.seek(oldState.pos() + recordsSize);
+        }
+        oldStream.resetStatus();
+    }
+
+    // Reads the records of a previous state entry back, the count was checked against the file size above
+    const auto readPrevious = [&oldState, &oldStream](qint64 countPos, quint32 file) {
+        oldState.seek(countPos);
+        quint32 count = 0;
+        oldStream >> count;
+        QVector<BlockRecord> records(count);
+        for (BlockRecord &record : records) {
+            oldStream >> record.hash >> record.physical >> record.block;
+            record.file = file;
+        }
+        return records;
+    };
+
+    QDir().mkpath(QFileInfo(statePath).absolutePath());
+    QSaveFile newState(statePath);
+    newState.open(QIODevice::WriteOnly);
+    QDataStream newStream(&newState);
+    newStream << stateVersion;
+
+    // Keep the records of the subvolumes that aren't part of this run so the next run over them is still incremental
+    QVector<QByteArray> selected;
+    for (const QString &subvolume : subvolumes)
+        selected.append(QFile::encodeName(QDir::cleanPath(subvolume)) + '/');
+    for (auto it = previous.constBegin(); it != previous.constEnd(); ++it) {
+        const bool inSelection =
+            std::any_of(selected.cbegin(), selected.cend(), [&it](const QByteArray &prefix) { return it.key().startsWith(prefix); });
+        if (!inSelection)
+            writeStateEntry(newStream, it.key(), it->first, readPrevious(it->second, 0));
+    }
+
+    DedupeIndex index(qMax<quint64>(1, memoryLimit / sizeof(BlockRecord)));
+    QVector<quint32> toHash;
+    for (int i = 0; i < files.size(); i++) {
+        const FileEntry &file = files.at(i);
+        const auto it = previous.constFind(file.path);
+        if (file.transid == 0 || it == previous.constEnd() || it->first != file.transid) {
+            toHash.append(i);
+            continue;
+        }
+
+        const QVector<BlockRecord> records = readPrevious(it->second, i);
+        writeStateEntry(newStream, file.path, file.transid, records);
+        index.add(records);
+        result.filesSkipped++;
+        processedFiles++;
+    }
+
+    // Hash the new and changed files in parallel, only adding to the index and state file is serialised
+    QtConcurrent::blockingMap(toHash, [this, &newStream, &index](quint32 i) {
+        const QVector<BlockRecord> records = hashFile(i);
+
+        QMutexLocker locker(&mutex);
+        writeStateEntry(newStream, files.at(i).path, files.at(i).transid, records);
+        index.add(records);
+        processedFiles++;
+    });
+    result.filesHashed = toHash.size();
+
+    if (!newState.commit())
+        result.errors.append(QObject::tr("Failed to save the deduplication state to %1").arg(statePath));
+
+    index.forEachGroup([this, &result](const QVector<BlockRecord> &group) { dedupeGroup(group, result); });
+
+    return result;
+}
+
+// Adds every regular file in @p subvolume to the file list, nested subvolumes are skipped
+void Deduplicator::collectFiles(const QByteArray &subvolume, bool writable) {
+    struct stat rootStat;
+    if (stat((rootPath + '/' + subvolume).constData(), &rootStat) != 0)
+        return;
+
+    QVector<QByteArray> directories = {subvolume};
+    while (!directories.isEmpty()) {
+        const QByteArray directory = directories.takeLast();
+        DIR *dir = opendir((rootPath + '/' + directory).constData());
+        if (dir == nullptr)
+            continue;
+
+        const int dirFd = dirfd(dir);
+        while (const dirent *entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") == 0 || strcmp(entry->d_name, "..") == 0)
+                continue;
+
+            struct stat st;
+            if (fstatat(dirFd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0 || st.st_dev != rootStat.st_dev)
+                continue;
+
+            const QByteArray path = directory + '/' + entry->d_name;
+            if (S_ISDIR(st.st_mode))
+                directories.append(path);
+            else if (S_ISREG(st.st_mode) && static_cast<quint64>(st.st_size) >= minimumFileSize)
+                files.append({path, static_cast<quint64>(st.st_size), readInodeTransid(dirFd, st.st_ino), writable});
+        }
+        closedir(dir);
+    }
+}
+
+// Hashes each block of a file and records where it is stored on disk
+QVector<BlockRecord> Deduplicator::hashFile(quint32 index) {
+    QVector<BlockRecord> records;
+    const FileEntry &file = files.at(index);
+
+    const int fd = open((rootPath + '/' + file.path).constData(), O_RDONLY | O_NOATIME | O_CLOEXEC);
+    if (fd < 0)
+        return records;
+    posix_fadvise(fd, 0, 0, POSIX_FADV_SEQUENTIAL);
+
+    // Map the file's extents so blocks which already share an extent can be recognised
+    QVector<fiemap_extent> extents;
+    const int extentBatch = 256;
+    QByteArray fiemapBuffer(sizeof(fiemap) + extentBatch * sizeof(fiemap_extent), 0);
+    auto *map = reinterpret_cast<fiemap *>(fiemapBuffer.data());
+    quint64 start = 0;
+    while (start < file.size) {
+        memset(map, 0, fiemapBuffer.size());
+        map->fm_start = start;
+        map->fm_length = file.size - start;
+        map->fm_extent_count = extentBatch;
+        if (ioctl(fd, FS_IOC_FIEMAP, map) < 0 || map->fm_mapped_extents == 0)
+            break;
+
+        for (quint32 i = 0; i < map->fm_mapped_extents; i++)
+            extents.append(map->fm_extents[i]);
+
+        const fiemap_extent &last = map->fm_extents[map->fm_mapped_extents - 1];
+        if (last.fe_flags & FIEMAP_EXTENT_LAST)
+            break;
+        start = last.fe_logical + last.fe_length;
+    }
+
+    QByteArray data(blockSize, Qt::Uninitialized);
+    int extent = 0;
+    for (quint32 block = 0; static_cast<quint64>(block) * blockSize < file.size; block++) {
+        const quint64 offset = static_cast<quint64>(block) * blockSize;
+        const ssize_t length = pread(fd, data.data(), blockSize, offset);
+        if (length <= 0)
+            break;
+
+        while (extent < extents.size() && extents.at(extent).fe_logical + extents.at(extent).fe_length <= offset)
+            extent++;
+
+        // Compressed and inline extents don't have a meaningful physical offset for a block inside them
+        quint64 physical = 0;
+        if (extent < extents.size() && extents.at(extent).fe_logical <= offset &&
+            !(extents.at(extent).fe_flags & (FIEMAP_EXTENT_ENCODED | FIEMAP_EXTENT_DATA_INLINE)))
+            physical = extents.at(extent).fe_physical + (offset - extents.at(extent).fe_logical);
+
+        // The length is the seed so only blocks of the same size can match
+        records.append({xxHash64(reinterpret_cast<const uchar *>(data.constData()), length, length), physical, index, block});
+    }
+
+    close(fd);
+    return records;
+}
+
+// Shares the blocks in @p group, which all have the same hash, with a single source block
+void Deduplicator::dedupeGroup(const QVector<BlockRecord> &group, DedupeResult &result) {
+    // Blocks in read-only snapshots can't be changed so one of those is preferred as the source
+    int source = 0;
+    for (int i = 0; i < group.size(); i++) {
+        if (!files.at(group.at(i).file).writable) {
+            source = i;
+            break;
+        }
+    }
+    const BlockRecord &sourceRecord = group.at(source);
+    const FileEntry &sourceFile = files.at(sourceRecord.file);
+    const quint64 sourceOffset = static_cast<quint64>(sourceRecord.block) * blockSize;
+
+    QVector<BlockRecord> destinations;
+    for (int i = 0; i < group.size(); i++) {
+        const BlockRecord &record = group.at(i);
+        const bool alreadyShared = record.physical != 0 && record.physical == sourceRecord.physical;
+        if (i != source && !alreadyShared && files.at(record.file).writable)
+            destinations.append(record);
+    }
+
+    if (destinations.isEmpty())
+        return;
+    result.duplicateBlocks += destinations.size();
+
+    const int sourceFd = open((rootPath + '/' + sourceFile.path).constData(), O_RDONLY | O_CLOEXEC);
+    if (sourceFd < 0)
+        return;
+
+    for (int first = 0; first < destinations.size(); first += maxDestinations) {
+        const int count = qMin(maxDestinations, destinations.size() - first);
+        QByteArray rangeBuffer(sizeof(file_dedupe_range) + count * sizeof(file_dedupe_range_info), 0);
+        auto *range = reinterpret_cast<file_dedupe_range *>(rangeBuffer.data());
+        range->src_offset = sourceOffset;
+        range->src_length = qMin(blockSize, sourceFile.size - sourceOffset);
+        range->dest_count = count;
+
+        for (int i = 0; i < count; i++) {
+            const BlockRecord &record = destinations.at(first + i);
+            range->info[i].dest_fd = open((rootPath + '/' + files.at(record.file).path).constData(), O_RDONLY | O_CLOEXEC);
+            range->info[i].dest_offset = static_cast<quint64>(record.block) * blockSize;
+        }
+
+        result.dedupeCalls++;
+        if (ioctl(sourceFd, FIDEDUPERANGE, range) < 0 && result.errors.size() < 10)
+            result.errors.append(QString::fromLocal8Bit(strerror(errno)));
+
+        for (int i = 0; i < count; i++) {
+            if (range->info[i].status == FILE_DEDUPE_RANGE_SAME)
+                result.bytesDeduped += range->info[i].bytes_deduped;
+            if (range->info[i].dest_fd >= 0)
+                close(range->info[i].dest_fd);
+        }
+    }
+
+    close(sourceFd);
+}
@@ -0,0 +1,89 @@
+#ifndef DEDUPE_H
+#define DEDUPE_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QHash>
+#include <QMutex>
+#include <QSharedPointer>
+#include <QStringList>
+#include <QTemporaryFile>
+#include <QVector>
+
+#include <atomic>
+#include <functional>
+
+// A hashed block of a file.  The physical address is used to recognise blocks which are already shared
+struct BlockRecord {
+    quint64 hash;
+    quint64 physical;
+    quint32 file;
+    quint32 block;
+};
+
+// Collects block records and groups them by hash while keeping at most a fixed number of records in memory.
+// When the limit is reached the records are sorted and spilled to a temporary file, forEachGroup() then merges the
+// sorted runs so memory use stays bounded no matter how much data is hashed.
+class DedupeIndex {
+  public:
+    explicit DedupeIndex(quint64 maxRecords) : maxRecords(maxRecords) {}
+
+    void add(const QVector<BlockRecord> &records);
+
+    // Calls @p callback once for every hash which occurs more than once, with all the records that share it
+    void forEachGroup(const std::function<void(const QVector<BlockRecord> &)> &callback);
+
+  private:
+    void spill();
+
+    quint64 maxRecords;
+    QVector<BlockRecord> buffer;
+    QVector<QSharedPointer<QTemporaryFile>> runs;
+};
+
+struct DedupeResult {
+    quint64 filesHashed = 0;
+    quint64 filesSkipped = 0;
+    quint64 duplicateBlocks = 0;
+    quint64 bytesDeduped = 0;
+    quint64 dedupeCalls = 0;
+    QStringList errors;
+};
+
+// Finds identical blocks in a set of subvolumes and asks the kernel to share them with FIDEDUPERANGE.  The kernel
+// compares the data itself before sharing anything so a hash collision can never corrupt a file.
+//
+// Read-only snapshots can't be changed, so blocks in writable subvolumes are pointed at the snapshot copies.  The block
+// hashes are kept in a state file between runs and files whose inode transid hasn't changed are not read again.
+class Deduplicator {
+  public:
+    Deduplicator(const QString &statePath, quint64 memoryLimit) : statePath(statePath), memoryLimit(memoryLimit) {}
+
+    // Deduplicates the files in @p subvolumes, which are paths relative to @p root.  Blocks until done.  Requires root
+    DedupeResult run(const QString &root, const QStringList &subvolumes);
+
+    // The number of files processed so far, safe to call from another thread while run() is running
+    quint64 filesProcessed() const { return processedFiles; }
+
+  private:
+    struct FileEntry {
+        // Relative to the root passed to run() so the state file stays valid wherever the filesystem is mounted
+        QByteArray path;
+        quint64 size;
+        quint64 transid;
+        bool writable;
+    };
+
+    void collectFiles(const QByteArray &subvolume, bool writable);
+    QVector<BlockRecord> hashFile(quint32 index);
+    void dedupeGroup(const QVector<BlockRecord> &group, DedupeResult &result);
+
+    QString statePath;
+    QByteArray rootPath;
+    quint64 memoryLimit;
+    QVector<FileEntry> files;
+    QMutex mutex;
+    std::atomic<quint64> processedFiles = 0;
+};
+
+#endif // DEDUPE_H
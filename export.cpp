@@ -0,0 +1,56 @@
+#include "backend.h"
+#include "inventory.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QFile>
+#include <QSaveFile>
+#include <QScopedPointer>
+#include <QSettings>
+
+#include <cstdio>
+
+// btrfs-assistant-export writes the storage inventory of the machine as JSON for monitoring systems to collect, to stdout
+// or atomically to a file
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("btrfs-assistant");
+
+    QCommandLineParser cmdline;
+    cmdline.setApplicationDescription("Writes the btrfs filesystems, subvolumes, snapper snapshots and maintenance settings as JSON");
+    cmdline.addHelpOption();
+    QCommandLineOption outputOption({"o", "output"}, "Write the inventory to this file instead of stdout", "path");
+    cmdline.addOption(outputOption);
+    cmdline.process(app);
+
+    const QSettings settings("/etc/btrfs-assistant.conf", QSettings::NativeFormat);
+    const QString btrfsmaintenanceConfig = settings.value("btrfsmaintenance", "/etc/default/btrfsmaintenance").toString();
+    QScopedPointer<Backend> backend(createBackend());
+
+    // Written to a temporary file first so a collector never reads half an inventory
+    if (cmdline.isSet(outputOption)) {
+        QSaveFile file(cmdline.value(outputOption));
+        if (!file.open(QIODevice::WriteOnly)) {
+            qWarning().noquote() << "Failed to write" << file.fileName() << ":" << file.errorString();
+            return 1;
+        }
+        writeInventory(*backend, &file, btrfsmaintenanceConfig);
+        if (!file.commit()) {
+            qWarning().noquote() << "Failed to write" << file.fileName() << ":" << file.errorString();
+            return 1;
+        }
+
+        return 0;
+    }
+
+    QFile out;
+    if (!out.open(stdout, QIODevice::WriteOnly)) {
+        qWarning() << "Failed to open stdout";
+        return 1;
+    }
+    writeInventory(*backend, &out, btrfsmaintenanceConfig);
+    out.flush();
+
+    return 0;
+}
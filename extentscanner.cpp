@@ -0,0 +1,212 @@
+#include "extentscanner.h"
+
+#include <QMutexLocker>
+#include <QSet>
+
+#include <algorithm>
+#include <dirent.h>
+#include <endian.h>
+#include <fcntl.h>
+#include <linux/btrfs.h>
+#include <linux/btrfs_tree.h>
+#include <string_view>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// How many entries are kept in each of the most fragmented lists
+static const int maxFragmentationEntries = 50;
+
+static const QString compressionName(quint8 type) {
+    switch (type) {
+    case 0:
+        return "none";
+    case 1:
+        return "zlib";
+    case 2:
+        return "lzo";
+    case 3:
+        return "zstd";
+    default:
+        return "unknown";
+    }
+}
+
+// Sorts @p entries by their number of fragments and drops all but the worst
+static void keepMostFragmented(QVector<FragmentationEntry> &entries) {
+    std::sort(entries.begin(), entries.end(),
+              [](const FragmentationEntry &a, const FragmentationEntry &b) { return a.fragments > b.fragments; });
+    if (entries.size() > maxFragmentationEntries)
+        entries.resize(maxFragmentationEntries);
+}
+
+// Reads the EXTENT_DATA items of inode @p ino in the subvolume containing @p dirFd and adds them to @p result and @p file.
+//
+// An extent that was partially overwritten, or a compressed one that was split, is referenced by several items, so its
+// disk space and the extent itself are only counted the first time.  The logical bytes are counted for every item since
+// each one maps a different range of the file
+static void scanFileExtents(int dirFd, quint64 ino, ExtentScanResult &result, FragmentationEntry &file) {
+    btrfs_ioctl_search_args args = {};
+    btrfs_ioctl_search_key &key = args.key;
+    // A tree id of 0 searches the tree of the subvolume dirFd belongs to
+    key.tree_id = 0;
+    key.min_objectid = key.max_objectid = ino;
+    key.min_type = key.max_type = BTRFS_EXTENT_DATA_KEY;
+    key.min_offset = 0;
+    key.max_offset = UINT64_MAX;
+    key.min_transid = 0;
+    key.max_transid = UINT64_MAX;
+
+    QSet<quint64> seenExtents;
+    quint64 previousBytenr = 0;
+    quint64 previousEnd = 0;
+    while (true) {
+        key.nr_items = 4096;
+        if (ioctl(dirFd, BTRFS_IOC_TREE_SEARCH, &args) < 0 || key.nr_items == 0)
+            return;
+
+        size_t pos = 0;
+        quint64 lastOffset = 0;
+        for (quint32 i = 0; i < key.nr_items; i++) {
+            const auto *header = reinterpret_cast<const btrfs_ioctl_search_header *>(args.buf + pos);
+            const auto *item = reinterpret_cast<const btrfs_file_extent_item *>(args.buf + pos + sizeof(*header));
+            pos += sizeof(*header) + header->len;
+            lastOffset = header->offset;
+
+            if (header->type != BTRFS_EXTENT_DATA_KEY)
+                continue;
+
+            CompressionStats &stats = result.compression[compressionName(item->compression)];
+            if (item->type == BTRFS_FILE_EXTENT_INLINE) {
+                // Inline data is stored in the leaf right after the fixed part of the item
+                stats.diskBytes += header->len - offsetof(btrfs_file_extent_item, disk_bytenr);
+                stats.logicalBytes += le64toh(item->ram_bytes);
+            } else {
+                const quint64 bytenr = le64toh(item->disk_bytenr);
+                // A zero bytenr is a hole and takes no space
+                if (bytenr == 0)
+                    continue;
+
+                stats.logicalBytes += le64toh(item->num_bytes);
+
+                // The offset of an uncompressed item is into the extent on disk, the offset of a compressed one is into
+                // the decompressed data so only the whole extent has a position on disk
+                const bool compressed = item->compression != 0;
+                const quint64 start = compressed ? bytenr : bytenr + le64toh(item->offset);
+                const quint64 end = compressed ? bytenr + le64toh(item->disk_num_bytes) : start + le64toh(item->num_bytes);
+
+                // Consecutive items pointing into the same extent are never a fragment
+                if (previousBytenr != 0 && bytenr != previousBytenr) {
+                    result.boundaries++;
+                    if (start != previousEnd) {
+                        result.fragments++;
+                        file.fragments++;
+                    }
+                }
+                previousBytenr = bytenr;
+                previousEnd = end;
+
+                if (seenExtents.contains(bytenr))
+                    continue;
+                seenExtents.insert(bytenr);
+                stats.diskBytes += le64toh(item->disk_num_bytes);
+            }
+
+            stats.extents++;
+            result.extents++;
+            file.extents++;
+        }
+
+        if (lastOffset == UINT64_MAX)
+            return;
+        key.min_offset = lastOffset + 1;
+    }
+}
+
+ExtentScanResult ExtentScanner::scan(const QString &path) {
+    result = ExtentScanResult();
+    scannedFiles = 0;
+
+    struct stat st;
+    const QByteArray localPath = path.toLocal8Bit();
+    if (stat(localPath.constData(), &st) != 0 || !S_ISDIR(st.st_mode))
+        return result;
+
+    scanDirectory(localPath, st.st_dev);
+    pool.waitForDone();
+
+    keepMostFragmented(result.fragmentedFiles);
+    keepMostFragmented(result.fragmentedDirs);
+    return result;
+}
+
+void ExtentScanner::scanDirectory(const QByteArray &path, dev_t device) {
+    DIR *dir = opendir(path.constData());
+    if (dir == nullptr)
+        return;
+
+    const int dirFd = dirfd(dir);
+    ExtentScanResult partial;
+    FragmentationEntry dirEntry;
+    dirEntry.path = QString::fromLocal8Bit(path);
+
+    while (const dirent *entry = readdir(dir)) {
+        const std::string_view name = entry->d_name;
+        if (name == "." || name == "..")
+            continue;
+
+        struct stat st;
+        if (fstatat(dirFd, entry->d_name, &st, AT_SYMLINK_NOFOLLOW) != 0)
+            continue;
+
+        const QByteArray childPath = path + '/' + entry->d_name;
+        if (S_ISDIR(st.st_mode)) {
+            // Each subvolume has its own device number, so this also stops at nested subvolumes
+            if (st.st_dev == device)
+                pool.start([this, childPath, device] { scanDirectory(childPath, device); });
+        } else if (S_ISREG(st.st_mode)) {
+            FragmentationEntry file;
+            file.path = QString::fromLocal8Bit(childPath);
+            file.bytes = st.st_size;
+            scanFileExtents(dirFd, st.st_ino, partial, file);
+
+            partial.files++;
+            dirEntry.bytes += file.bytes;
+            dirEntry.extents += file.extents;
+            dirEntry.fragments += file.fragments;
+            if (file.fragments > 0)
+                partial.fragmentedFiles.append(file);
+            scannedFiles++;
+        }
+    }
+    closedir(dir);
+
+    keepMostFragmented(partial.fragmentedFiles);
+    if (dirEntry.fragments > 0)
+        partial.fragmentedDirs.append(dirEntry);
+    merge(partial);
+}
+
+// Adds the results of a single directory to the overall result
+void ExtentScanner::merge(const ExtentScanResult &partial) {
+    QMutexLocker locker(&mutex);
+
+    for (auto it = partial.compression.constBegin(); it != partial.compression.constEnd(); ++it) {
+        CompressionStats &stats = result.compression[it.key()];
+        stats.diskBytes += it.value().diskBytes;
+        stats.logicalBytes += it.value().logicalBytes;
+        stats.extents += it.value().extents;
+    }
+    result.files += partial.files;
+    result.extents += partial.extents;
+    result.fragments += partial.fragments;
+    result.boundaries += partial.boundaries;
+
+    result.fragmentedFiles += partial.fragmentedFiles;
+    result.fragmentedDirs += partial.fragmentedDirs;
+    // Trim occasionally so the lists stay small on huge trees
+    if (result.fragmentedFiles.size() > maxFragmentationEntries * 4)
+        keepMostFragmented(result.fragmentedFiles);
+    if (result.fragmentedDirs.size() > maxFragmentationEntries * 4)
+        keepMostFragmented(result.fragmentedDirs);
+}
@@ -0,0 +1,66 @@
+#ifndef EXTENTSCANNER_H
+#define EXTENTSCANNER_H
+
+#include <QByteArray>
+#include <QMap>
+#include <QMutex>
+#include <QString>
+#include <QThreadPool>
+#include <QVector>
+
+#include <atomic>
+#include <sys/types.h>
+
+// Space used by the extents stored with a single compression type
+struct CompressionStats {
+    quint64 diskBytes = 0;
+    quint64 logicalBytes = 0;
+    quint64 extents = 0;
+};
+
+// A file or directory along with how fragmented its extents are
+struct FragmentationEntry {
+    QString path;
+    quint64 bytes = 0;
+    quint64 extents = 0;
+    quint64 fragments = 0;
+};
+
+struct ExtentScanResult {
+    // Keyed by compression type, "none", "zlib", "lzo" or "zstd"
+    QMap<QString, CompressionStats> compression;
+    quint64 files = 0;
+    quint64 extents = 0;
+    // The number of places where a file's next extent doesn't start where the previous one ended on disk
+    quint64 fragments = 0;
+    quint64 boundaries = 0;
+    // The most fragmented files and the directories with the most fragmented files directly inside them
+    QVector<FragmentationEntry> fragmentedFiles;
+    QVector<FragmentationEntry> fragmentedDirs;
+
+    // Returns the fraction of extent boundaries which are not physically contiguous, 0 means no fragmentation
+    double fragmentationScore() const { return boundaries == 0 ? 0 : static_cast<double>(fragments) / boundaries; }
+};
+
+// Walks a subvolume and reads the EXTENT_DATA items of every file through the btrfs tree search ioctl.
+// Directories are scanned in parallel on a thread pool, each directory queues its subdirectories as new tasks so idle
+// threads always pick up the next available directory.  Requires root for the tree search ioctl.
+class ExtentScanner {
+  public:
+    // Scans every file below @p path, nested subvolumes and other filesystems are skipped.  Blocks until the scan is done
+    ExtentScanResult scan(const QString &path);
+
+    // The number of files scanned so far, safe to call from another thread while scan() is running
+    quint64 filesScanned() const { return scannedFiles; }
+
+  private:
+    void scanDirectory(const QByteArray &path, dev_t device);
+    void merge(const ExtentScanResult &partial);
+
+    QThreadPool pool;
+    QMutex mutex;
+    ExtentScanResult result;
+    std::atomic<quint64> scannedFiles = 0;
+};
+
+#endif // EXTENTSCANNER_H
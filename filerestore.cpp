@@ -0,0 +1,181 @@
+#include "filerestore.h"
+
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QObject>
+
+#include <cerrno>
+#include <cstring>
+#include <dirent.h>
+#include <fcntl.h>
+#include <linux/fs.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+// Appended to the name of a file while it is being restored so a failure never leaves a partial file in its place
+static const char *partialSuffix = ".btrfs-assistant-restore";
+
+static void addError(FileRestoreResult &result, const QByteArray &path, int error) {
+    result.errors.append(QFile::decodeName(path) + ": " + QString::fromLocal8Bit(strerror(error)));
+}
+
+// Copies the data of @p in to @p out with copy_file_range, falling back to read and write on kernels which can't copy
+// between filesystems.  Returns 0 or an errno value
+static int copyData(int in, int out) {
+    while (true) {
+        const ssize_t copied = copy_file_range(in, nullptr, out, nullptr, 1 << 30, 0);
+        if (copied == 0)
+            return 0;
+        if (copied > 0)
+            continue;
+        if (errno == EINTR)
+            continue;
+        if (errno != EXDEV && errno != EINVAL && errno != EOPNOTSUPP && errno != ENOSYS)
+            return errno;
+        break;
+    }
+
+    // copy_file_range may have copied part of the file already so continue from the current offsets
+    char buffer[128 * 1024];
+    while (true) {
+        const ssize_t length = read(in, buffer, sizeof(buffer));
+        if (length == 0)
+            return 0;
+        if (length < 0) {
+            if (errno == EINTR)
+                continue;
+            return errno;
+        }
+
+        for (ssize_t written = 0; written < length;) {
+            const ssize_t count = write(out, buffer + written, length - written);
+            if (count < 0) {
+                if (errno == EINTR)
+                    continue;
+                return errno;
+            }
+            written += count;
+        }
+    }
+}
+
+static void restoreFile(const QByteArray &source, const QByteArray &destination, const struct stat &st, FileRestoreResult &result) {
+    const int in = open(source.constData(), O_RDONLY | O_CLOEXEC);
+    if (in < 0) {
+        addError(result, source, errno);
+        return;
+    }
+
+    const QByteArray partial = destination + partialSuffix;
+    const int out = open(partial.constData(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, st.st_mode & 07777);
+    if (out < 0) {
+        addError(result, destination, errno);
+        close(in);
+        return;
+    }
+
+    // A reflink shares every extent with the snapshot, no data is read or written
+    int error = 0;
+    if (ioctl(out, FICLONE, in) == 0)
+        result.clonedBytes += st.st_size;
+    else
+        error = copyData(in, out);
+
+    if (error == 0) {
+        const struct timespec times[2] = {st.st_atim, st.st_mtim};
+        if (fchown(out, st.st_uid, st.st_gid) != 0 || fchmod(out, st.st_mode & 07777) != 0 || futimens(out, times) != 0)
+            error = errno;
+    }
+
+    close(in);
+    if (close(out) != 0 && error == 0)
+        error = errno;
+
+    if (error == 0 && rename(partial.constData(), destination.constData()) != 0)
+        error = errno;
+
+    if (error != 0) {
+        unlink(partial.constData());
+        addError(result, destination, error);
+        return;
+    }
+
+    result.files++;
+    result.bytes += st.st_size;
+}
+
+static void restoreSymlink(const QByteArray &source, const QByteArray &destination, const struct stat &st, FileRestoreResult &result) {
+    QByteArray target(st.st_size + 1, Qt::Uninitialized);
+    const ssize_t length = readlink(source.constData(), target.data(), target.size());
+    if (length < 0) {
+        addError(result, source, errno);
+        return;
+    }
+    target.truncate(length);
+
+    const QByteArray partial = destination + partialSuffix;
+    unlink(partial.constData());
+    if (symlink(target.constData(), partial.constData()) != 0 || rename(partial.constData(), destination.constData()) != 0) {
+        addError(result, destination, errno);
+        unlink(partial.constData());
+        return;
+    }
+
+    const struct timespec times[2] = {st.st_atim, st.st_mtim};
+    lchown(destination.constData(), st.st_uid, st.st_gid);
+    utimensat(AT_FDCWD, destination.constData(), times, AT_SYMLINK_NOFOLLOW);
+    result.files++;
+}
+
+static void restorePath(const QByteArray &source, const QByteArray &destination, FileRestoreResult &result) {
+    struct stat st;
+    if (lstat(source.constData(), &st) != 0) {
+        addError(result, source, errno);
+        return;
+    }
+
+    if (S_ISREG(st.st_mode)) {
+        restoreFile(source, destination, st, result);
+    } else if (S_ISLNK(st.st_mode)) {
+        restoreSymlink(source, destination, st, result);
+    } else if (S_ISDIR(st.st_mode)) {
+        if (mkdir(destination.constData(), 0700) != 0 && errno != EEXIST) {
+            addError(result, destination, errno);
+            return;
+        }
+
+        DIR *dir = opendir(source.constData());
+        if (dir == nullptr) {
+            addError(result, source, errno);
+            return;
+        }
+
+        while (const dirent *entry = readdir(dir)) {
+            if (strcmp(entry->d_name, ".") != 0 && strcmp(entry->d_name, "..") != 0)
+                restorePath(source + '/' + entry->d_name, destination + '/' + entry->d_name, result);
+        }
+        closedir(dir);
+
+        // The metadata is set last since restoring the contents changes the timestamps
+        const struct timespec times[2] = {st.st_atim, st.st_mtim};
+        chown(destination.constData(), st.st_uid, st.st_gid);
+        chmod(destination.constData(), st.st_mode & 07777);
+        utimensat(AT_FDCWD, destination.constData(), times, 0);
+    } else {
+        result.errors.append(QObject::tr("%1: skipped, only files, directories and symlinks are restored").arg(QFile::decodeName(source)));
+    }
+}
+
+FileRestoreResult restoreFiles(const QList<QPair<QString, QString>> &paths) {
+    FileRestoreResult result;
+
+    for (const auto &path : paths) {
+        const QString destination = QDir::cleanPath(path.second);
+        QDir().mkpath(QFileInfo(destination).absolutePath());
+        restorePath(QFile::encodeName(QDir::cleanPath(path.first)), QFile::encodeName(destination), result);
+    }
+
+    return result;
+}
@@ -0,0 +1,24 @@
+#ifndef FILERESTORE_H
+#define FILERESTORE_H
+
+#include <QList>
+#include <QPair>
+#include <QString>
+#include <QStringList>
+
+struct FileRestoreResult {
+    quint64 files = 0;
+    quint64 bytes = 0;
+    quint64 clonedBytes = 0;
+    QStringList errors;
+};
+
+// Copies each source path to its destination, recursing into directories.  Files are reflinked with FICLONE so the
+// restored copy shares its extents with the snapshot and even large files are restored instantly.  When the destination
+// is on another filesystem copy_file_range is used instead.
+//
+// Ownership, permissions and timestamps are restored as well.  An existing file is replaced atomically, files which only
+// exist in the destination directory are left alone.  Requires root to restore the ownership
+FileRestoreResult restoreFiles(const QList<QPair<QString, QString>> &paths);
+
+#endif // FILERESTORE_H
@@ -0,0 +1,62 @@
+#include "helperapi.h"
+#include "helperservice.h"
+#include "mountmanager.h"
+#include "undojournal.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDebug>
+#include <QSettings>
+
+// Deletes the safety snapshots of the undo history whose retention has passed and removes their entries.  A retention of 0
+// turned the history off, everything still in it is deleted then
+static int pruneUndoJournal() {
+    const QSettings settings("/etc/btrfs-assistant.conf", QSettings::NativeFormat);
+    const qint64 retention = qMax<qint64>(0, settings.value("undo_retention_hours", 24).toLongLong() * 60 * 60);
+
+    UndoJournal journal(undoJournalPath);
+    if (!journal.load()) {
+        qWarning() << "Failed to read the undo history" << undoJournalPath;
+        return 1;
+    }
+
+    // An entry is only removed once its snapshots are deleted, those of a filesystem which isn't there now are kept for the
+    // next run
+    MountManager mounts;
+    QList<qint64> pruned;
+    const QVector<UndoEntry> expired = journal.expired(retention);
+    for (const UndoEntry &entry : expired) {
+        const TopLevelMount topLevel(mounts, entry.uuid);
+        if (!topLevel.isValid())
+            continue;
+
+        pruneSafetySnapshots(topLevel.path(), entry);
+        pruned.append(entry.id);
+    }
+
+    journal.remove(pruned);
+    return 0;
+}
+
+// btrfs-assistant-helper is started by D-Bus as root on the first call to it and exits again once it's idle.  A systemd
+// timer also runs it with --prune-undo, so expired safety snapshots are deleted without the application being opened
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+
+    QCommandLineParser cmdline;
+    QCommandLineOption pruneUndo("prune-undo", "Delete the expired safety snapshots of the undo history and exit");
+    cmdline.addOption(pruneUndo);
+    cmdline.process(app);
+    if (cmdline.isSet(pruneUndo))
+        return pruneUndoJournal();
+
+    HelperService service;
+    QDBusConnection bus = QDBusConnection::systemBus();
+    if (!bus.registerObject(helperPath, &service, QDBusConnection::ExportAllSlots) || !bus.registerService(helperService)) {
+        qWarning() << "Failed to register" << helperService << "on the system bus:" << bus.lastError().message();
+        return 1;
+    }
+
+    return app.exec();
+}
@@ -0,0 +1,93 @@
+#include "helperapi.h"
+
+#include <QDBusArgument>
+
+// Maps and lists nested in a reply arrive as QDBusArgument, qdbus_cast takes both that and a plain QVariant
+static QVariantMap toMap(const QVariant &value) { return qdbus_cast<QVariantMap>(value); }
+
+QVariantMap usageToVariant(const Btrfs &btrfs) {
+    QVariantList profiles;
+    for (const BtrfsProfileUsage &profile : btrfs.profiles) {
+        QVariantMap devices;
+        for (auto it = profile.devices.constBegin(); it != profile.devices.constEnd(); ++it)
+            devices[it.key()] = qlonglong(it.value());
+
+        profiles.append(QVariantMap{{"type", profile.type},
+                                    {"profile", profile.profile},
+                                    {"size", qlonglong(profile.size)},
+                                    {"used", qlonglong(profile.used)},
+                                    {"devices", devices}});
+    }
+
+    QVariantMap devices;
+    for (auto it = btrfs.devices.constBegin(); it != btrfs.devices.constEnd(); ++it)
+        devices[it.key()] = QVariantMap{{"allocated", qlonglong(it.value().allocated)}, {"unallocated", qlonglong(it.value().unallocated)}};
+
+    return {{"totalSize", qlonglong(btrfs.totalSize)}, {"allocatedSize", qlonglong(btrfs.allocatedSize)},
+            {"usedSize", qlonglong(btrfs.usedSize)},   {"freeSize", qlonglong(btrfs.freeSize)},
+            {"dataSize", qlonglong(btrfs.dataSize)},   {"dataUsed", qlonglong(btrfs.dataUsed)},
+            {"metaSize", qlonglong(btrfs.metaSize)},   {"metaUsed", qlonglong(btrfs.metaUsed)},
+            {"sysSize", qlonglong(btrfs.sysSize)},     {"sysUsed", qlonglong(btrfs.sysUsed)},
+            {"profiles", profiles},                    {"devices", devices}};
+}
+
+void usageFromVariant(const QVariantMap &usage, Btrfs &btrfs) {
+    btrfs.totalSize = usage.value("totalSize").toLongLong();
+    btrfs.allocatedSize = usage.value("allocatedSize").toLongLong();
+    btrfs.usedSize = usage.value("usedSize").toLongLong();
+    btrfs.freeSize = usage.value("freeSize").toLongLong();
+    btrfs.dataSize = usage.value("dataSize").toLongLong();
+    btrfs.dataUsed = usage.value("dataUsed").toLongLong();
+    btrfs.metaSize = usage.value("metaSize").toLongLong();
+    btrfs.metaUsed = usage.value("metaUsed").toLongLong();
+    btrfs.sysSize = usage.value("sysSize").toLongLong();
+    btrfs.sysUsed = usage.value("sysUsed").toLongLong();
+
+    btrfs.profiles.clear();
+    const QVariantList profiles = qdbus_cast<QVariantList>(usage.value("profiles"));
+    for (const QVariant &value : profiles) {
+        const QVariantMap profile = toMap(value);
+        BtrfsProfileUsage profileUsage = {profile.value("type").toString(), profile.value("profile").toString(),
+                                          long(profile.value("size").toLongLong()), long(profile.value("used").toLongLong()),
+                                          QMap<QString, long>()};
+        const QVariantMap devices = toMap(profile.value("devices"));
+        for (auto it = devices.constBegin(); it != devices.constEnd(); ++it)
+            profileUsage.devices[it.key()] = it.value().toLongLong();
+        btrfs.profiles.append(profileUsage);
+    }
+
+    btrfs.devices.clear();
+    const QVariantMap devices = toMap(usage.value("devices"));
+    for (auto it = devices.constBegin(); it != devices.constEnd(); ++it) {
+        const QVariantMap device = toMap(it.value());
+        btrfs.devices[it.key()] = {long(device.value("allocated").toLongLong()), long(device.value("unallocated").toLongLong())};
+    }
+}
+
+QVariantList snapshotsToVariant(const QVector<SnapperSnapshots> &snapshots) {
+    QVariantList list;
+    for (const SnapperSnapshots &snapshot : snapshots) {
+        list.append(QVariantMap{{"number", snapshot.number},
+                                {"time", snapshot.time},
+                                {"desc", snapshot.desc},
+                                {"cleanup", snapshot.cleanup},
+                                {"type", snapshot.type},
+                                {"userdata", snapshot.userdata},
+                                {"preNumber", snapshot.preNumber}});
+    }
+
+    return list;
+}
+
+QVector<SnapperSnapshots> snapshotsFromVariant(const QVariantList &list) {
+    QVector<SnapperSnapshots> snapshots;
+    snapshots.reserve(list.size());
+    for (const QVariant &value : list) {
+        const QVariantMap snapshot = toMap(value);
+        snapshots.append({snapshot.value("number").toInt(), snapshot.value("time").toString(), snapshot.value("desc").toString(),
+                          snapshot.value("cleanup").toString(), snapshot.value("type").toString(),
+                          snapshot.value("userdata").toString(), snapshot.value("preNumber").toInt()});
+    }
+
+    return snapshots;
+}
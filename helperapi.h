@@ -0,0 +1,27 @@
+#ifndef HELPERAPI_H
+#define HELPERAPI_H
+
+#include "outputparsers.h"
+
+#include <QString>
+#include <QVariantList>
+#include <QVariantMap>
+
+// Where the privileged helper is found on the system bus
+static const QString helperService = "org.garuda.BtrfsAssistant.Helper";
+static const QString helperPath = "/org/garuda/BtrfsAssistant/Helper";
+static const QString helperInterface = "org.garuda.BtrfsAssistant.Helper";
+
+// The polkit actions guarding the calls which only read and the ones which change something
+static const QString helperReadAction = "org.garuda.btrfs-assistant.helper.read";
+static const QString helperModifyAction = "org.garuda.btrfs-assistant.helper.modify";
+
+// The filesystem usage as the Usage call of the helper returns it, the fields of Btrfs which come from btrfs filesystem usage
+QVariantMap usageToVariant(const Btrfs &btrfs);
+void usageFromVariant(const QVariantMap &usage, Btrfs &btrfs);
+
+// The snapshots of a snapper config as the ListSnapshots call of the helper returns them
+QVariantList snapshotsToVariant(const QVector<SnapperSnapshots> &snapshots);
+QVector<SnapperSnapshots> snapshotsFromVariant(const QVariantList &list);
+
+#endif // HELPERAPI_H
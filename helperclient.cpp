@@ -0,0 +1,49 @@
+#include "helperclient.h"
+#include "helperapi.h"
+
+#include <QDBusConnectionInterface>
+#include <QDBusMessage>
+#include <QDBusReply>
+
+#include <climits>
+
+HelperClient::HelperClient() : bus(QDBusConnection::systemBus()) {}
+
+bool HelperClient::isAvailable() const {
+    if (!bus.isConnected() || !bus.interface())
+        return false;
+
+    const QDBusReply<QStringList> activatable = bus.interface()->call("ListActivatableNames");
+    return activatable.isValid() && activatable.value().contains(helperService);
+}
+
+// A plain message is used instead of QDBusInterface to avoid the blocking introspection call QDBusInterface makes on
+// construction.  The calls don't time out because polkit may be waiting for the user to authenticate
+QDBusPendingCall HelperClient::callHelper(const QString &method, const QVariantList &args) const {
+    QDBusMessage message = QDBusMessage::createMethodCall(helperService, helperPath, helperInterface, method);
+    message.setArguments(args);
+    message.setInteractiveAuthorizationAllowed(true);
+    return bus.asyncCall(message, INT_MAX);
+}
+
+QDBusPendingReply<QVariantList> HelperClient::listSubvolumes(const QString &mountpoint) const {
+    return callHelper("ListSubvolumes", {mountpoint});
+}
+
+QDBusPendingReply<QVariantMap> HelperClient::usage(const QString &mountpoint) const { return callHelper("Usage", {mountpoint}); }
+
+QDBusPendingReply<QVariantList> HelperClient::listSnapshots(const QString &config) const {
+    return callHelper("ListSnapshots", {config});
+}
+
+QDBusPendingReply<int> HelperClient::createSnapshot(const QString &config, const QString &description) const {
+    return callHelper("CreateSnapshot", {config, description});
+}
+
+QDBusPendingReply<> HelperClient::deleteSnapshots(const QString &config, const QList<int> &numbers) const {
+    return callHelper("DeleteSnapshots", {config, QVariant::fromValue(numbers)});
+}
+
+QDBusPendingReply<QString> HelperClient::restoreSnapshot(const QString &uuid, const QString &snapshot, const QString &target) const {
+    return callHelper("RestoreSnapshot", {uuid, snapshot, target});
+}
@@ -0,0 +1,35 @@
+#ifndef HELPERCLIENT_H
+#define HELPERCLIENT_H
+
+#include <QDBusConnection>
+#include <QDBusPendingReply>
+#include <QList>
+#include <QVariantList>
+#include <QVariantMap>
+
+// Calls the privileged btrfs-assistant-helper from an unprivileged process.  Every call is asynchronous and returns as soon
+// as it is sent, so several can be in flight on the one system bus connection at the same time.  The replies can be waited
+// for or handed to a QDBusPendingCallWatcher, which is what the GUI does since polkit may be asking for a password first
+class HelperClient {
+  public:
+    HelperClient();
+
+    // Returns true if the helper is installed where D-Bus can start it
+    bool isAvailable() const;
+
+    QDBusPendingReply<QVariantList> listSubvolumes(const QString &mountpoint) const;
+    QDBusPendingReply<QVariantMap> usage(const QString &mountpoint) const;
+    QDBusPendingReply<QVariantList> listSnapshots(const QString &config) const;
+    QDBusPendingReply<int> createSnapshot(const QString &config, const QString &description) const;
+    QDBusPendingReply<> deleteSnapshots(const QString &config, const QList<int> &numbers) const;
+
+    // The reply is the path the original target was moved to
+    QDBusPendingReply<QString> restoreSnapshot(const QString &uuid, const QString &snapshot, const QString &target) const;
+
+  private:
+    QDBusPendingCall callHelper(const QString &method, const QVariantList &args) const;
+
+    QDBusConnection bus;
+};
+
+#endif // HELPERCLIENT_H
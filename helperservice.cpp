@@ -0,0 +1,240 @@
+#include "helperservice.h"
+#include "btrfsioctl.h"
+#include "helperapi.h"
+#include "outputparsers.h"
+#include "snapshotrestore.h"
+
+#include <QCoreApplication>
+#include <QDBusArgument>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusMetaType>
+#include <QDBusPendingCallWatcher>
+#include <QDir>
+#include <QProcess>
+
+#include <climits>
+
+// The helper exits after this long without a call
+static const int idleTimeout = 5 * 60 * 1000;
+
+// The subject polkit checks an action for, marshalled as (sa{sv})
+struct PolkitSubject {
+    QString kind;
+    QVariantMap details;
+};
+Q_DECLARE_METATYPE(PolkitSubject)
+
+QDBusArgument &operator<<(QDBusArgument &argument, const PolkitSubject &subject) {
+    argument.beginStructure();
+    argument << subject.kind << subject.details;
+    argument.endStructure();
+    return argument;
+}
+
+const QDBusArgument &operator>>(const QDBusArgument &argument, PolkitSubject &subject) {
+    argument.beginStructure();
+    argument >> subject.kind >> subject.details;
+    argument.endStructure();
+    return argument;
+}
+
+// Runs @p program with @p args in the C locale and returns its standard output.  Sets @p error to its standard error if
+// it fails
+static QByteArray runProgram(const QString &program, const QStringList &args, QString &error) {
+    QProcess process;
+    QProcessEnvironment environment = QProcessEnvironment::systemEnvironment();
+    environment.insert("LANG", "C");
+    process.setProcessEnvironment(environment);
+    process.start(program, args);
+    if (!process.waitForFinished(-1) || process.exitStatus() != QProcess::NormalExit || process.exitCode() != 0) {
+        error = QString::fromLocal8Bit(process.readAllStandardError()).trimmed();
+        if (error.isEmpty())
+            error = QObject::tr("%1 failed").arg(program);
+        return QByteArray();
+    }
+
+    return process.readAllStandardOutput();
+}
+
+HelperService::HelperService(QObject *parent) : QObject(parent) {
+    qDBusRegisterMetaType<PolkitSubject>();
+    qDBusRegisterMetaType<QMap<QString, QString>>();
+
+    idleTimer.setSingleShot(true);
+    idleTimer.setInterval(idleTimeout);
+    connect(&idleTimer, &QTimer::timeout, this, [this] {
+        if (pendingChecks == 0)
+            QCoreApplication::quit();
+    });
+    idleTimer.start();
+}
+
+// Runs @p operation and sends its reply once the caller is known to be allowed to perform @p action, or sends an error
+// reply if it isn't.  The reply is always delayed, the slot's own return value is never sent
+void HelperService::authorize(const QString &action, const Operation &operation) {
+    idleTimer.start();
+    if (!calledFromDBus()) {
+        operation(QDBusMessage());
+        return;
+    }
+
+    setDelayedReply(true);
+    const QDBusMessage request = message();
+    QDBusConnection bus = connection();
+    const QString caller = request.service();
+
+    QDBusMessage check = QDBusMessage::createMethodCall("org.freedesktop.PolicyKit1", "/org/freedesktop/PolicyKit1/Authority",
+                                                        "org.freedesktop.PolicyKit1.Authority", "CheckAuthorization");
+    const PolkitSubject subject = {"system-bus-name", {{"name", caller}}};
+    // Flag 1 lets polkit ask the user to authenticate
+    check.setArguments({QVariant::fromValue(subject), action, QVariant::fromValue(QMap<QString, QString>()), 1u, QString()});
+
+    // The user may take a while to type their password
+    pendingChecks++;
+    auto *watcher = new QDBusPendingCallWatcher(bus.asyncCall(check, INT_MAX), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, watcher, bus, request, action, operation] {
+        watcher->deleteLater();
+        pendingChecks--;
+        idleTimer.start();
+
+        const QDBusMessage reply = watcher->reply();
+        bool isAuthorized = false;
+        if (reply.type() == QDBusMessage::ReplyMessage && !reply.arguments().isEmpty()) {
+            bool isChallenge = false;
+            QMap<QString, QString> details;
+            const QDBusArgument result = reply.arguments().at(0).value<QDBusArgument>();
+            result.beginStructure();
+            result >> isAuthorized >> isChallenge >> details;
+            result.endStructure();
+        }
+
+        if (!isAuthorized) {
+            bus.send(request.createErrorReply(QDBusError::AccessDenied, tr("Not authorized to %1").arg(action)));
+            return;
+        }
+
+        bus.send(operation(request));
+    });
+}
+
+QVariantList HelperService::ListSubvolumes(const QString &mountpoint) {
+    authorize(helperReadAction, [mountpoint](const QDBusMessage &request) {
+        QVariantList list;
+        const QVector<BtrfsSubvolume> subvolumes = listSubvolumes(mountpoint);
+        for (const BtrfsSubvolume &subvolume : subvolumes)
+            list.append(QVariantMap{{"id", subvolume.id}, {"parent", subvolume.parentId}, {"path", subvolume.path}});
+
+        return request.createReply(QVariant(list));
+    });
+
+    return QVariantList();
+}
+
+QVariantMap HelperService::Usage(const QString &mountpoint) {
+    authorize(helperReadAction, [mountpoint](const QDBusMessage &request) {
+        if (!QDir::isAbsolutePath(mountpoint))
+            return request.createErrorReply(QDBusError::InvalidArgs, tr("%1 is not an absolute path").arg(mountpoint));
+
+        QString error;
+        const QByteArray output = runProgram("btrfs", {"filesystem", "usage", "-b", "--", mountpoint}, error);
+        if (!error.isEmpty())
+            return request.createErrorReply(QDBusError::Failed, tr("Failed to read the space usage of %1").arg(mountpoint));
+
+        Btrfs btrfs = {};
+        parseFilesystemUsage(output, btrfs);
+        return request.createReply(usageToVariant(btrfs));
+    });
+
+    return QVariantMap();
+}
+
+QVariantList HelperService::ListSnapshots(const QString &config) {
+    authorize(helperReadAction, [config](const QDBusMessage &request) {
+        QString error;
+        const QByteArray output = runProgram("snapper", snapperListArguments(config), error);
+        if (!error.isEmpty())
+            return request.createErrorReply(QDBusError::Failed, error);
+
+        return request.createReply(QVariant(snapshotsToVariant(parseSnapperList(output))));
+    });
+
+    return QVariantList();
+}
+
+int HelperService::CreateSnapshot(const QString &config, const QString &description) {
+    authorize(helperModifyAction, [config, description](const QDBusMessage &request) {
+        QString error;
+        const QByteArray output = runProgram("snapper", {"-c", config, "create", "-p", "-d", description}, error);
+        if (!error.isEmpty())
+            return request.createErrorReply(QDBusError::Failed, error);
+
+        return request.createReply(output.trimmed().toInt());
+    });
+
+    return 0;
+}
+
+void HelperService::DeleteSnapshots(const QString &config, const QList<int> &numbers) {
+    authorize(helperModifyAction, [config, numbers](const QDBusMessage &request) {
+        if (numbers.isEmpty())
+            return request.createReply();
+
+        QStringList args = {"-c", config, "delete"};
+        for (const int number : numbers)
+            args.append(QString::number(number));
+
+        QString error;
+        runProgram("snapper", args, error);
+        return error.isEmpty() ? request.createReply() : request.createErrorReply(QDBusError::Failed, error);
+    });
+}
+
+QString HelperService::RestoreSnapshot(const QString &uuid, const QString &snapshot, const QString &target) {
+    authorize(helperModifyAction, [this, uuid, snapshot, target](const QDBusMessage &request) {
+        if (!snapshot.contains(".snapshots") || snapshot.endsWith(".snapshots"))
+            return request.createErrorReply(QDBusError::InvalidArgs, tr("%1 is not a snapper snapshot").arg(snapshot));
+
+        const TopLevelMount topLevel(topLevelMounts, uuid);
+        if (!topLevel.isValid())
+            return request.createErrorReply(QDBusError::Failed, tr("Failed to mount the filesystem %1").arg(uuid));
+        const QString &mountpoint = topLevel.path();
+
+        // Both subvolumes have to exist and the ones nested in the target are moved along
+        quint64 targetId = 0;
+        bool hasSnapshot = false;
+        const QVector<BtrfsSubvolume> subvolumes = listSubvolumes(mountpoint);
+        for (const BtrfsSubvolume &subvolume : subvolumes) {
+            if (subvolume.path == target)
+                targetId = subvolume.id;
+            hasSnapshot |= subvolume.path == snapshot;
+        }
+
+        if (targetId == 0 || !hasSnapshot)
+            return request.createErrorReply(QDBusError::InvalidArgs, targetId == 0 ? tr("Target not found") : tr("Snapshot not found"));
+
+        QStringList children;
+        for (const BtrfsSubvolume &subvolume : subvolumes) {
+            if (subvolume.parentId == targetId)
+                children.append(subvolume.path);
+        }
+
+        QString backup;
+        switch (restoreSubvolume(mountpoint, target, snapshot, children, backup)) {
+        case RestoreStatus::BackupFailed:
+            return request.createErrorReply(QDBusError::Failed, tr("Failed to make a backup of target subvolume"));
+        case RestoreStatus::SnapshotFailed:
+            return request.createErrorReply(QDBusError::Failed,
+                                            tr("Snapshot restore failed.  Please verify the status of your system before rebooting"));
+        case RestoreStatus::ChildrenFailed:
+            return request.createErrorReply("org.garuda.BtrfsAssistant.Helper.ChildrenFailed",
+                                            tr("The restore was successful but the migration of the nested subvolumes failed"));
+        case RestoreStatus::Restored:
+            break;
+        }
+
+        return request.createReply(backup);
+    });
+
+    return QString();
+}
@@ -0,0 +1,60 @@
+#ifndef HELPERSERVICE_H
+#define HELPERSERVICE_H
+
+#include <QDBusContext>
+#include <QList>
+#include <QObject>
+#include <QTimer>
+#include <QVariantList>
+#include <QVariantMap>
+
+#include <functional>
+
+#include "mountmanager.h"
+
+// The operations of btrfs-assistant which need root, exported on the system bus by btrfs-assistant-helper.
+//
+// Every call is checked with polkit for the connection making it.  The check is asynchronous and the call is answered with
+// a delayed reply, so other callers are served while one of them is typing their password.  Nothing is remembered between
+// calls, polkit keeps an authentication for as long as the action allows.  Commands are run with argument lists, never
+// through a shell.  The helper exits once it has been idle for a while and D-Bus starts it again on the next call.
+class HelperService : public QObject, protected QDBusContext {
+    Q_OBJECT
+    Q_CLASSINFO("D-Bus Interface", "org.garuda.BtrfsAssistant.Helper")
+
+  public:
+    explicit HelperService(QObject *parent = nullptr);
+
+  public slots:
+    // Returns a map with the id, parent and path of each subvolume of the filesystem mounted at @p mountpoint
+    QVariantList ListSubvolumes(const QString &mountpoint);
+
+    // Returns the usage of the filesystem mounted at @p mountpoint as btrfs filesystem usage reports it, see
+    // usageToVariant()
+    QVariantMap Usage(const QString &mountpoint);
+
+    // Returns the snapshots of the snapper config @p config, see snapshotsToVariant()
+    QVariantList ListSnapshots(const QString &config);
+
+    // Creates a snapshot in the snapper config @p config and returns its number
+    int CreateSnapshot(const QString &config, const QString &description);
+
+    void DeleteSnapshots(const QString &config, const QList<int> &numbers);
+
+    // Restores @p snapshot over @p target on the filesystem @p uuid, both are paths from the top level subvolume.  Returns
+    // the path the original target was moved to
+    QString RestoreSnapshot(const QString &uuid, const QString &snapshot, const QString &target);
+
+  private:
+    // Builds the reply to the request it is passed
+    using Operation = std::function<QDBusMessage(const QDBusMessage &)>;
+
+    void authorize(const QString &action, const Operation &operation);
+
+    // The polkit checks which haven't been answered yet, the helper doesn't exit while the user is authenticating
+    int pendingChecks = 0;
+    MountManager topLevelMounts;
+    QTimer idleTimer;
+};
+
+#endif // HELPERSERVICE_H
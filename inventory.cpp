@@ -0,0 +1,167 @@
+#include "inventory.h"
+#include "backend.h"
+#include "jsonwriter.h"
+#include "outputparsers.h"
+#include "shellconfig.h"
+
+#include <QDateTime>
+#include <QSysInfo>
+
+// Writes every key of @p config as a member of an object
+static void writeSettings(JsonWriter &json, const ShellConfig &config) {
+    json.beginObject();
+    const QStringList keys = config.keys();
+    for (const QString &key : keys)
+        json.member(key, config.value(key));
+    json.endObject();
+}
+
+static void writeUsage(JsonWriter &json, const Btrfs &btrfs) {
+    json.beginObject();
+    json.member("size", qint64(btrfs.totalSize));
+    json.member("allocated", qint64(btrfs.allocatedSize));
+    json.member("used", qint64(btrfs.usedSize));
+    json.member("free", qint64(btrfs.freeSize));
+
+    json.key("profiles");
+    json.beginArray();
+    for (const BtrfsProfileUsage &profile : btrfs.profiles) {
+        json.beginObject();
+        json.member("type", profile.type);
+        json.member("profile", profile.profile);
+        json.member("size", qint64(profile.size));
+        json.member("used", qint64(profile.used));
+        json.key("devices");
+        json.beginObject();
+        for (auto it = profile.devices.constBegin(); it != profile.devices.constEnd(); ++it)
+            json.member(it.key(), qint64(it.value()));
+        json.endObject();
+        json.endObject();
+    }
+    json.endArray();
+
+    json.key("devices");
+    json.beginObject();
+    for (auto it = btrfs.devices.constBegin(); it != btrfs.devices.constEnd(); ++it) {
+        json.key(it.key());
+        json.beginObject();
+        json.member("allocated", qint64(it.value().allocated));
+        json.member("unallocated", qint64(it.value().unallocated));
+        json.endObject();
+    }
+    json.endObject();
+    json.endObject();
+}
+
+// Writes @p filesystem.  Only its uuid, label and devices are known when it isn't mounted, the mountpoint is null then and
+// the rest is left out
+static void writeFilesystem(JsonWriter &json, Backend &backend, const BtrfsFilesystem &filesystem) {
+    json.beginObject();
+    json.member("uuid", filesystem.uuid);
+    json.member("label", filesystem.label);
+    json.member("devices", filesystem.devices);
+    json.key("mountpoint");
+    if (filesystem.mountpoint.isEmpty()) {
+        json.nullValue();
+        json.endObject();
+        return;
+    }
+    json.value(filesystem.mountpoint);
+    json.member("features", filesystem.features);
+    json.member("generation", backend.generation(filesystem.mountpoint));
+
+    Btrfs btrfs = {};
+    parseFilesystemUsage(backend.run("LANG=C ; btrfs fi usage -b " + filesystem.mountpoint), btrfs);
+    json.key("usage");
+    writeUsage(json, btrfs);
+
+    // The subvolumes form a tree through the id of the subvolume each one is directly inside of, 5 is the top level
+    QMap<QString, QString> subvolumes;
+    QMap<QString, QString> parents;
+    parseSubvolumeList(backend.run("btrfs subvolume list " + filesystem.mountpoint), subvolumes, parents);
+    json.key("subvolumes");
+    json.beginArray();
+    for (auto it = subvolumes.constBegin(); it != subvolumes.constEnd(); ++it) {
+        json.beginObject();
+        json.member("id", it.key().toULongLong());
+        json.member("parent", parents.value(it.key()).toULongLong());
+        json.member("path", it.value());
+        json.endObject();
+    }
+    json.endArray();
+
+    json.endObject();
+}
+
+static void writeSnapperConfig(JsonWriter &json, Backend &backend, const QString &name, const QString &subvolume) {
+    json.beginObject();
+    json.member("name", name);
+    json.member("subvolume", subvolume);
+
+    ShellConfig config;
+    config.parse(backend.readFile(snapperConfigPath(name)));
+    json.key("settings");
+    writeSettings(json, config);
+
+    const QVector<SnapperSnapshots> snapshots = parseSnapperList(backend.run(snapperListCommand(name)));
+    json.key("snapshots");
+    json.beginArray();
+    for (const SnapperSnapshots &snapshot : snapshots) {
+        // Snapshot 0 is the live subvolume itself
+        if (snapshot.number == 0)
+            continue;
+
+        json.beginObject();
+        json.member("number", qint64(snapshot.number));
+        json.member("date", snapshot.time);
+        json.member("type", snapshot.type);
+        if (snapshot.preNumber > 0)
+            json.member("pre", qint64(snapshot.preNumber));
+        json.member("cleanup", snapshot.cleanup);
+        json.member("description", snapshot.desc);
+        json.member("userdata", snapshot.userdata);
+        json.endObject();
+    }
+    json.endArray();
+
+    json.endObject();
+}
+
+void writeInventory(Backend &backend, QIODevice *device, const QString &btrfsmaintenanceConfig) {
+    JsonWriter json(device);
+    json.beginObject();
+    json.member("format", "btrfs-assistant-inventory");
+    json.member("version", qint64(inventoryVersion));
+    json.member("hostname", QSysInfo::machineHostName());
+    json.member("generated", QDateTime::currentDateTimeUtc().toString(Qt::ISODate));
+
+    json.key("filesystems");
+    json.beginArray();
+    const QVector<BtrfsFilesystem> filesystems = backend.filesystems(true);
+    for (const BtrfsFilesystem &filesystem : filesystems)
+        writeFilesystem(json, backend, filesystem);
+    json.endArray();
+
+    json.key("snapper");
+    json.beginArray();
+    QMap<QString, QString> configs;
+    if (!readSnapperConfigs([&backend](const QString &path) { return backend.readFile(path); }, configs))
+        configs = parseSnapperConfigs(backend.run(snapperConfigsCommand()));
+    for (auto it = configs.constBegin(); it != configs.constEnd(); ++it)
+        writeSnapperConfig(json, backend, it.key(), it.value());
+    json.endArray();
+
+    // Null when btrfsmaintenance isn't installed
+    json.key("btrfsmaintenance");
+    const QByteArray maintenance = backend.readFile(btrfsmaintenanceConfig);
+    if (maintenance.isEmpty()) {
+        json.nullValue();
+    } else {
+        ShellConfig config;
+        config.parse(maintenance);
+        writeSettings(json, config);
+    }
+
+    json.endObject();
+    device->putChar('\n');
+}
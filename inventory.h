@@ -0,0 +1,21 @@
+#ifndef INVENTORY_H
+#define INVENTORY_H
+
+#include <QString>
+
+class Backend;
+class QIODevice;
+
+// Bumped whenever a member of the inventory is renamed, removed or changes its meaning.  Adding members doesn't bump it
+static const int inventoryVersion = 2;
+
+// Writes the storage inventory of the system read through @p backend to @p device as a single JSON object: the usage of
+// each mounted btrfs filesystem by profile and device, its subvolumes, the snapper configs with their settings and
+// snapshots, and the btrfsmaintenance settings read from @p btrfsmaintenanceConfig.  The filesystems which aren't mounted
+// are listed too, with only their uuid, label and devices, when built with libblkid.
+//
+// Each part is written as soon as it has been read, so only the subvolumes of one filesystem or the snapshots of one
+// config are ever held in memory at a time.  Reading the subvolumes needs root, the lists are empty otherwise
+void writeInventory(Backend &backend, QIODevice *device, const QString &btrfsmaintenanceConfig);
+
+#endif // INVENTORY_H
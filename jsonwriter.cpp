@@ -0,0 +1,114 @@
+#include "jsonwriter.h"
+
+void JsonWriter::separate() {
+    if (afterKey) {
+        afterKey = false;
+        return;
+    }
+
+    if (!hasValues.isEmpty()) {
+        if (hasValues.last())
+            device->putChar(',');
+        hasValues.last() = true;
+    }
+}
+
+void JsonWriter::beginObject() {
+    separate();
+    device->putChar('{');
+    hasValues.append(false);
+}
+
+void JsonWriter::endObject() {
+    hasValues.removeLast();
+    device->putChar('}');
+}
+
+void JsonWriter::beginArray() {
+    separate();
+    device->putChar('[');
+    hasValues.append(false);
+}
+
+void JsonWriter::endArray() {
+    hasValues.removeLast();
+    device->putChar(']');
+}
+
+void JsonWriter::key(const QString &name) {
+    separate();
+    writeString(name);
+    device->putChar(':');
+    afterKey = true;
+}
+
+void JsonWriter::value(const QString &string) {
+    separate();
+    writeString(string);
+}
+
+void JsonWriter::value(qint64 number) {
+    separate();
+    device->write(QByteArray::number(number));
+}
+
+void JsonWriter::value(quint64 number) {
+    separate();
+    device->write(QByteArray::number(number));
+}
+
+void JsonWriter::value(bool boolean) {
+    separate();
+    device->write(boolean ? "true" : "false");
+}
+
+void JsonWriter::value(const QStringList &strings) {
+    beginArray();
+    for (const QString &string : strings)
+        value(string);
+    endArray();
+}
+
+void JsonWriter::nullValue() {
+    separate();
+    device->write("null");
+}
+
+void JsonWriter::writeString(const QString &string) {
+    static const char hexDigits[] = "0123456789abcdef";
+
+    // Only the quote, the backslash and control characters need escaping, everything else is written as UTF-8
+    const QByteArray utf8 = string.toUtf8();
+    QByteArray escaped;
+    escaped.reserve(utf8.size() + 2);
+    escaped.append('"');
+    for (const char c : utf8) {
+        switch (c) {
+        case '"':
+            escaped.append("\\\"");
+            break;
+        case '\\':
+            escaped.append("\\\\");
+            break;
+        case '\n':
+            escaped.append("\\n");
+            break;
+        case '\r':
+            escaped.append("\\r");
+            break;
+        case '\t':
+            escaped.append("\\t");
+            break;
+        default:
+            if (static_cast<unsigned char>(c) < 0x20) {
+                escaped.append("\\u00");
+                escaped.append(hexDigits[c >> 4]);
+                escaped.append(hexDigits[c & 0xf]);
+            } else {
+                escaped.append(c);
+            }
+        }
+    }
+    escaped.append('"');
+    device->write(escaped);
+}
@@ -0,0 +1,53 @@
+#ifndef JSONWRITER_H
+#define JSONWRITER_H
+
+#include <QByteArray>
+#include <QIODevice>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Writes JSON to a device as it goes, nothing but the nesting of the open objects and arrays is kept in memory, so a
+// document of any size can be written with a constant amount of memory.
+//
+// The caller is responsible for the structure: every begin has to be matched by an end and each member of an object
+// starts with key().  Integers are written as they are, so a quint64 above 2^53 may lose precision in a reader which
+// parses numbers as doubles
+class JsonWriter {
+  public:
+    explicit JsonWriter(QIODevice *device) : device(device) {}
+
+    void beginObject();
+    void endObject();
+    void beginArray();
+    void endArray();
+
+    // Starts the member @p name of the current object, the value written next is its value
+    void key(const QString &name);
+
+    void value(const QString &string);
+    void value(const char *string) { value(QString::fromUtf8(string)); }
+    void value(qint64 number);
+    void value(quint64 number);
+    void value(bool boolean);
+    void value(const QStringList &strings);
+    void nullValue();
+
+    // Shorthands for key() followed by value()
+    template <typename T> void member(const QString &name, const T &memberValue) {
+        key(name);
+        value(memberValue);
+    }
+
+  private:
+    // Writes the comma separating the value about to be written from the one before it
+    void separate();
+    void writeString(const QString &string);
+
+    QIODevice *device;
+    // Whether the object or array at each level of nesting has had a value yet
+    QVector<bool> hasValues;
+    bool afterKey = false;
+};
+
+#endif // JSONWRITER_H
@@ -4,6 +4,8 @@
 #include <QDesktopWidget>
 #include <QDebug>
 
+#include <csignal>
+
 // We have to manually parse argv into QStringList because by the time QCoreApplication initializes it's already too late because Qt already picked the theme
 QStringList parseArgs(int argc, char *argv[])
 {
@@ -28,6 +30,10 @@ int main(int argc, char *argv[]) {
     if (cmdline.isSet(xdgDesktop))
         qputenv("XDG_CURRENT_DESKTOP", cmdline.value(xdgDesktop).toUtf8());
 
+    // A btrfs receive which exits early during replication has to show up as EPIPE instead of killing the application.  This
+    // is set once before any thread starts since the disposition is shared by the whole process
+    signal(SIGPIPE, SIG_IGN);
+
     QApplication a(argc, argv);
     QTranslator myappTranslator;
     myappTranslator.load("btrfsassistant_" + QLocale::system().name(), "/usr/share/btrfs-assistant/translations");
@@ -0,0 +1,43 @@
+#include "metricsserver.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDebug>
+#include <QSettings>
+
+// btrfs-assistant-metrics serves the btrfs metrics to Prometheus, it runs as a system service since most of them need root
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("btrfs-assistant");
+
+    // The defaults come from the config file and can be overridden on the command line
+    const QSettings settings("/etc/btrfs-assistant.conf", QSettings::NativeFormat);
+
+    QCommandLineParser cmdline;
+    cmdline.setApplicationDescription("Serves btrfs usage, device errors, scrubs, snapshot counts and maintenance runs to Prometheus");
+    cmdline.addHelpOption();
+    QCommandLineOption addressOption("address", "Listen on this address", "address",
+                                     settings.value("metrics_address", "127.0.0.1").toString());
+    QCommandLineOption portOption("port", "Listen on this port", "port", settings.value("metrics_port", 9879).toString());
+    QCommandLineOption refreshOption("refresh", "Collect the metrics this often, in seconds", "seconds",
+                                     settings.value("metrics_refresh", 60).toString());
+    cmdline.addOption(addressOption);
+    cmdline.addOption(portOption);
+    cmdline.addOption(refreshOption);
+    cmdline.process(app);
+
+    const QHostAddress address(cmdline.value(addressOption));
+    if (address.isNull()) {
+        qWarning().noquote() << "Invalid address" << cmdline.value(addressOption);
+        return 1;
+    }
+
+    MetricsServer server(qMax(1, cmdline.value(refreshOption).toInt()));
+    QString error;
+    if (!server.listen(address, cmdline.value(portOption).toUShort(), error)) {
+        qWarning().noquote() << "Failed to listen on" << cmdline.value(addressOption) + ":" + cmdline.value(portOption) << ":" << error;
+        return 1;
+    }
+
+    return app.exec();
+}
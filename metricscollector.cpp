@@ -0,0 +1,170 @@
+#include "metricscollector.h"
+#include "btrfsdiscovery.h"
+#include "btrfsioctl.h"
+#include "shellconfig.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusObjectPath>
+#include <QDBusVariant>
+#include <QDir>
+#include <QMap>
+#include <QStringList>
+
+// The btrfsmaintenance tasks and the timers running them
+static const QMap<QString, QString> maintenanceTimers = {
+    {"balance", "btrfs-balance.timer"},
+    {"defrag", "btrfs-defrag.timer"},
+    {"scrub", "btrfs-scrub.timer"},
+    {"trim", "btrfs-trim.timer"},
+};
+
+// How long to wait for systemd, a refresh shouldn't hang on a stuck bus
+static const int systemdTimeout = 5000;
+
+// Collects the samples of each metric so they can be written with their HELP and TYPE lines in one block
+class MetricsWriter {
+  public:
+    void add(const QByteArray &name, const QByteArray &type, const QByteArray &help) {
+        if (!samples.contains(name))
+            names.append(name);
+        headers[name] = "# HELP " + name + " " + help + "\n# TYPE " + name + " " + type + "\n";
+        samples[name];
+    }
+
+    void sample(const QByteArray &name, const QList<QPair<QByteArray, QString>> &labels, quint64 value) {
+        QByteArray &out = samples[name];
+        out += name;
+        if (!labels.isEmpty()) {
+            out += '{';
+            for (int i = 0; i < labels.size(); i++) {
+                if (i > 0)
+                    out += ',';
+                out += labels.at(i).first + "=\"" + escapeLabel(labels.at(i).second) + '"';
+            }
+            out += '}';
+        }
+        out += ' ' + QByteArray::number(value) + '\n';
+    }
+
+    QByteArray text() const {
+        QByteArray out;
+        for (const QByteArray &name : names) {
+            if (!samples.value(name).isEmpty())
+                out += headers.value(name) + samples.value(name);
+        }
+        return out;
+    }
+
+  private:
+    // Label values are quoted, so the backslash, the quote and line breaks have to be escaped
+    static QByteArray escapeLabel(const QString &value) {
+        QByteArray escaped = value.toUtf8();
+        escaped.replace('\\', "\\\\").replace('"', "\\\"").replace('\n', "\\n");
+        return escaped;
+    }
+
+    QList<QByteArray> names;
+    QMap<QByteArray, QByteArray> headers;
+    QMap<QByteArray, QByteArray> samples;
+};
+
+// Returns when the systemd timer @p timer last fired in seconds since the epoch, or 0 if it never has or isn't installed.
+// btrfsmaintenance installs its timers as persistent so this survives a reboot
+static quint64 lastTrigger(const QString &timer) {
+    QDBusMessage load = QDBusMessage::createMethodCall("org.freedesktop.systemd1", "/org/freedesktop/systemd1",
+                                                       "org.freedesktop.systemd1.Manager", "LoadUnit");
+    load.setArguments({timer});
+    const QDBusMessage unit = QDBusConnection::systemBus().call(load, QDBus::Block, systemdTimeout);
+    if (unit.type() != QDBusMessage::ReplyMessage || unit.arguments().isEmpty())
+        return 0;
+
+    const QString path = unit.arguments().first().value<QDBusObjectPath>().path();
+    QDBusMessage get = QDBusMessage::createMethodCall("org.freedesktop.systemd1", path, "org.freedesktop.DBus.Properties", "Get");
+    get.setArguments({"org.freedesktop.systemd1.Timer", "LastTriggerUSec"});
+    const QDBusMessage reply = QDBusConnection::systemBus().call(get, QDBus::Block, systemdTimeout);
+    if (reply.type() != QDBusMessage::ReplyMessage || reply.arguments().isEmpty())
+        return 0;
+
+    return reply.arguments().first().value<QDBusVariant>().variant().toULongLong() / 1000000;
+}
+
+// Returns the number of snapshots in the .snapshots directory of @p subvolume, each is a numbered directory
+static quint64 countSnapshots(const QString &subvolume) {
+    quint64 count = 0;
+    const QStringList entries = QDir(QDir::cleanPath(subvolume + "/.snapshots")).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &entry : entries) {
+        bool isNumber = false;
+        entry.toUInt(&isNumber);
+        if (isNumber)
+            count++;
+    }
+
+    return count;
+}
+
+QByteArray collectMetrics() {
+    MetricsWriter metrics;
+    metrics.add("btrfs_info", "gauge", "Mounted btrfs filesystems");
+    metrics.add("btrfs_allocated_bytes", "gauge", "Logical bytes allocated to each block group type");
+    metrics.add("btrfs_used_bytes", "gauge", "Logical bytes used in each block group type");
+    metrics.add("btrfs_device_errors_total", "counter", "Errors the kernel counted on each device");
+    metrics.add("btrfs_scrub_start_timestamp_seconds", "gauge", "When the last scrub of each device started");
+    metrics.add("btrfs_scrub_duration_seconds", "gauge", "How long the last scrub of each device took");
+    metrics.add("btrfs_scrub_errors", "gauge", "Errors found by the last scrub of each device");
+    metrics.add("snapper_snapshots", "gauge", "Snapshots of each snapper config");
+    metrics.add("btrfs_maintenance_last_run_timestamp_seconds", "gauge", "When each btrfsmaintenance task last ran");
+
+    const QVector<BtrfsFilesystem> filesystems = discoverFilesystems();
+    for (const BtrfsFilesystem &filesystem : filesystems) {
+        if (filesystem.mountpoint.isEmpty())
+            continue;
+
+        const QString &uuid = filesystem.uuid;
+        metrics.sample("btrfs_info", {{"uuid", uuid}, {"label", filesystem.label}, {"mountpoint", filesystem.mountpoint}}, 1);
+
+        const QList<QPair<QString, QPair<quint64, quint64>>> blockGroups = {
+            {"data", {filesystem.dataTotal, filesystem.dataUsed}},
+            {"metadata", {filesystem.metadataTotal, filesystem.metadataUsed}},
+            {"system", {filesystem.systemTotal, filesystem.systemUsed}},
+        };
+        for (const auto &blockGroup : blockGroups) {
+            metrics.sample("btrfs_allocated_bytes", {{"uuid", uuid}, {"type", blockGroup.first}}, blockGroup.second.first);
+            metrics.sample("btrfs_used_bytes", {{"uuid", uuid}, {"type", blockGroup.first}}, blockGroup.second.second);
+        }
+
+        const QVector<BtrfsDevStats> devices = readDevStats(filesystem.mountpoint);
+        for (const BtrfsDevStats &device : devices) {
+            const QList<QPair<QString, quint64>> counters = {{"write", device.writeErrors},
+                                                             {"read", device.readErrors},
+                                                             {"flush", device.flushErrors},
+                                                             {"corruption", device.corruptionErrors},
+                                                             {"generation", device.generationErrors}};
+            for (const auto &counter : counters)
+                metrics.sample("btrfs_device_errors_total", {{"uuid", uuid}, {"device", device.path}, {"type", counter.first}},
+                               counter.second);
+        }
+
+        const QVector<BtrfsScrubStatus> scrubs = readScrubStatus(uuid);
+        for (const BtrfsScrubStatus &scrub : scrubs) {
+            const QString devid = QString::number(scrub.devid);
+            metrics.sample("btrfs_scrub_start_timestamp_seconds", {{"uuid", uuid}, {"devid", devid}}, scrub.startTime);
+            metrics.sample("btrfs_scrub_duration_seconds", {{"uuid", uuid}, {"devid", devid}}, scrub.duration);
+            metrics.sample("btrfs_scrub_errors", {{"uuid", uuid}, {"devid", devid}, {"type", "uncorrectable"}}, scrub.uncorrectableErrors);
+            metrics.sample("btrfs_scrub_errors", {{"uuid", uuid}, {"devid", devid}, {"type", "corrected"}}, scrub.correctedErrors);
+        }
+    }
+
+    QMap<QString, QString> configs;
+    readSnapperConfigs(configs);
+    for (auto it = configs.constBegin(); it != configs.constEnd(); ++it)
+        metrics.sample("snapper_snapshots", {{"config", it.key()}, {"subvolume", it.value()}}, countSnapshots(it.value()));
+
+    for (auto it = maintenanceTimers.constBegin(); it != maintenanceTimers.constEnd(); ++it) {
+        const quint64 lastRun = lastTrigger(it.value());
+        if (lastRun > 0)
+            metrics.sample("btrfs_maintenance_last_run_timestamp_seconds", {{"task", it.key()}}, lastRun);
+    }
+
+    return metrics.text();
+}
@@ -0,0 +1,14 @@
+#ifndef METRICSCOLLECTOR_H
+#define METRICSCOLLECTOR_H
+
+#include <QByteArray>
+
+// Returns the metrics of the mounted btrfs filesystems in the Prometheus text exposition format: the allocated and used
+// space of each block group type, the error counters of each device, the last scrub, the number of snapshots of each
+// snapper config and when the btrfsmaintenance tasks last ran.
+//
+// Everything is read from sysfs, ioctls, the snapper and scrub status files and systemd, no command is run.  The device
+// error counters and the snapshot directories need root, they are left out otherwise
+QByteArray collectMetrics();
+
+#endif // METRICSCOLLECTOR_H
@@ -0,0 +1,80 @@
+#include "metricsserver.h"
+#include "metricscollector.h"
+
+#include <QDateTime>
+#include <QElapsedTimer>
+#include <QTcpSocket>
+
+// A request is never more than a request line and a few headers, anything longer is dropped
+static const int maxRequestSize = 8192;
+
+// A client that doesn't send its request within this time is disconnected
+static const int requestTimeout = 10 * 1000;
+
+MetricsServer::MetricsServer(int refreshSeconds, QObject *parent) : QObject(parent) {
+    connect(&refreshTimer, &QTimer::timeout, this, &MetricsServer::refresh);
+    refreshTimer.start(refreshSeconds * 1000);
+    refresh();
+
+    connect(&server, &QTcpServer::newConnection, this, [this] {
+        while (QTcpSocket *socket = server.nextPendingConnection()) {
+            connect(socket, &QTcpSocket::disconnected, socket, &QObject::deleteLater);
+            connect(socket, &QTcpSocket::readyRead, this, [this, socket] { handleRequest(socket); });
+            QTimer::singleShot(requestTimeout, socket, [socket] { socket->abort(); });
+        }
+    });
+}
+
+bool MetricsServer::listen(const QHostAddress &address, quint16 port, QString &error) {
+    if (server.listen(address, port))
+        return true;
+
+    error = server.errorString();
+    return false;
+}
+
+void MetricsServer::refresh() {
+    QElapsedTimer timer;
+    timer.start();
+    QByteArray collected = collectMetrics();
+
+    // How fresh the cached metrics are and what collecting them costs
+    collected += "# HELP btrfs_assistant_collect_timestamp_seconds When the metrics were collected\n";
+    collected += "# TYPE btrfs_assistant_collect_timestamp_seconds gauge\n";
+    collected += "btrfs_assistant_collect_timestamp_seconds " + QByteArray::number(QDateTime::currentSecsSinceEpoch()) + "\n";
+    collected += "# HELP btrfs_assistant_collect_duration_seconds How long collecting the metrics took\n";
+    collected += "# TYPE btrfs_assistant_collect_duration_seconds gauge\n";
+    collected += "btrfs_assistant_collect_duration_seconds " + QByteArray::number(timer.elapsed() / 1000.0) + "\n";
+    metrics = collected;
+}
+
+void MetricsServer::handleRequest(QTcpSocket *socket) {
+    // Wait for the end of the headers, the body of a GET is empty
+    const QByteArray request = socket->peek(maxRequestSize);
+    if (!request.contains("\r\n\r\n")) {
+        if (request.size() >= maxRequestSize)
+            socket->abort();
+        return;
+    }
+    socket->readAll();
+    disconnect(socket, &QTcpSocket::readyRead, this, nullptr);
+
+    const QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+    QByteArray status = "200 OK";
+    QByteArray contentType = "text/plain; version=0.0.4; charset=utf-8";
+    QByteArray body = metrics;
+    if (requestLine.size() < 2 || requestLine.at(0) != "GET") {
+        status = "405 Method Not Allowed";
+        contentType = "text/plain";
+        body = "Only GET is supported\n";
+    } else if (requestLine.at(1) != "/metrics") {
+        status = "404 Not Found";
+        contentType = "text/plain";
+        body = "The metrics are at /metrics\n";
+    }
+
+    socket->write("HTTP/1.1 " + status + "\r\nContent-Type: " + contentType + "\r\nContent-Length: " + QByteArray::number(body.size()) +
+                  "\r\nConnection: close\r\n\r\n");
+    socket->write(body);
+    socket->disconnectFromHost();
+}
@@ -0,0 +1,34 @@
+#ifndef METRICSSERVER_H
+#define METRICSSERVER_H
+
+#include <QByteArray>
+#include <QHostAddress>
+#include <QObject>
+#include <QTcpServer>
+#include <QTimer>
+
+class QTcpSocket;
+
+// Serves the metrics of collectMetrics() over HTTP for Prometheus to scrape.
+//
+// The metrics are collected on a timer and every scrape gets the last collected copy, so scraping as often as wanted
+// doesn't add any load on the filesystems.  Only GET /metrics is answered, every connection is closed after its response
+class MetricsServer : public QObject {
+    Q_OBJECT
+
+  public:
+    explicit MetricsServer(int refreshSeconds, QObject *parent = nullptr);
+
+    // Starts listening for scrapes.  Returns false and sets @p error on failure
+    bool listen(const QHostAddress &address, quint16 port, QString &error);
+
+  private:
+    void refresh();
+    void handleRequest(QTcpSocket *socket);
+
+    QTcpServer server;
+    QTimer refreshTimer;
+    QByteArray metrics;
+};
+
+#endif // METRICSSERVER_H
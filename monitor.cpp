@@ -0,0 +1,187 @@
+#include "btrfsioctl.h"
+#include "raidprofile.h"
+#include "tokenizer.h"
+#include "usagehistory.h"
+
+#include <QCommandLineParser>
+#include <QCoreApplication>
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDateTime>
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QSet>
+#include <QStandardPaths>
+#include <QUuid>
+
+#include <unistd.h>
+
+// The same warning is shown at most this often
+static const qint64 alertInterval = 24 * 3600;
+
+// Returns the mountpoints of every mounted btrfs filesystem.  A filesystem mounted more than once is listed for each mount
+static QStringList btrfsMountpoints() {
+    QStringList mountpoints;
+    QFile mountinfo("/proc/self/mountinfo");
+    if (!mountinfo.open(QIODevice::ReadOnly))
+        return mountpoints;
+
+    const QByteArray data = mountinfo.readAll();
+    LineTokenizer lines(data);
+    std::string_view line;
+    while (lines.next(line)) {
+        // The optional fields end with a lone -, the filesystem type follows it
+        const size_t separator = line.find(" - ");
+        if (separator != std::string_view::npos && word(line.substr(separator + 3), 0) == "btrfs")
+            mountpoints.append(unescapeMountPath(word(line, 4)));
+    }
+
+    return mountpoints;
+}
+
+// Returns the free space of @p usage that can really be written to.  That is the free space inside the allocated chunks
+// plus what the profile can still allocate from the unallocated space of the devices.
+//
+// Data and metadata allocate from the same unallocated space, so each one is estimated as if it could have all of it.
+// The two are either-or, they can't be added up, and whichever grows first takes the space the other one was counting on
+static UsageSample sampleUsage(const BtrfsSpaceUsage &usage) {
+    quint64 stranded = 0;
+    const quint64 dataAllocatable = allocatableSpace(raidProfile(usage.dataProfile), usage.unallocated, stranded);
+    const quint64 metadataAllocatable = allocatableSpace(raidProfile(usage.metadataProfile), usage.unallocated, stranded);
+
+    // The global reserve lives in the metadata chunks but can't be used by ordinary writes
+    const quint64 metadataSlack = usage.metadataTotal - usage.metadataUsed;
+    const quint64 metadataFree = (metadataSlack > usage.globalReserve ? metadataSlack - usage.globalReserve : 0) + metadataAllocatable;
+
+    return {QDateTime::currentSecsSinceEpoch(), usage.dataTotal - usage.dataUsed + dataAllocatable, metadataFree};
+}
+
+// Shows a desktop notification, or logs the message when there is no session bus such as when running as a system service
+static void notify(const QString &summary, const QString &body) {
+    QDBusConnection bus = QDBusConnection::sessionBus();
+    if (bus.isConnected()) {
+        QDBusMessage message = QDBusMessage::createMethodCall("org.freedesktop.Notifications", "/org/freedesktop/Notifications",
+                                                              "org.freedesktop.Notifications", "Notify");
+        message << QString("Btrfs Assistant") << 0u << QString("drive-harddisk") << summary << body << QStringList() << QVariantMap()
+                << -1;
+        if (bus.call(message).type() == QDBusMessage::ReplyMessage)
+            return;
+    }
+
+    qWarning().noquote() << summary + ": " + body;
+}
+
+// Warns when the trend of the data or metadata free space predicts it runs out within @p horizon seconds
+static void checkTrend(UsageHistory &history, bool metadata, const QString &mountpoint, qint64 horizon, qint64 window) {
+    const qint64 remaining = secondsUntilFull(history.samples(), metadata ? &UsageSample::metadataFree : &UsageSample::dataFree, window);
+    const qint64 now = history.samples().last().time;
+    if (remaining < 0 || remaining > horizon || now - history.lastAlert(metadata) < alertInterval)
+        return;
+
+    const QString when =
+        remaining >= 2 * 86400 ? QObject::tr("%1 days").arg(remaining / 86400) : QObject::tr("%1 hours").arg(remaining / 3600);
+    const quint64 free = metadata ? history.samples().last().metadataFree : history.samples().last().dataFree;
+    const QString summary = metadata ? QObject::tr("Btrfs metadata space is running out") : QObject::tr("Btrfs data space is running out");
+    const QString body = QObject::tr("%1 has %2 MiB left.  At the current rate it will be full in about %3")
+                             .arg(mountpoint)
+                             .arg(free / (1024 * 1024))
+                             .arg(when);
+    notify(summary, body);
+    history.setLastAlert(metadata, now);
+}
+
+// Returns the bytes @p qgroup can still grow by before it reaches the tighter of its limits, or -1 if it has no limit
+static qint64 quotaHeadroom(const BtrfsQgroup &qgroup) {
+    qint64 headroom = -1;
+    if (qgroup.maxReferenced > 0)
+        headroom = qgroup.maxReferenced > qgroup.referenced ? qgroup.maxReferenced - qgroup.referenced : 0;
+    if (qgroup.maxExclusive > 0) {
+        const qint64 exclusive = qgroup.maxExclusive > qgroup.exclusive ? qgroup.maxExclusive - qgroup.exclusive : 0;
+        headroom = headroom < 0 ? exclusive : qMin(headroom, exclusive);
+    }
+
+    return headroom;
+}
+
+// Keeps a history of the headroom of every qgroup with a limit on the filesystem @p uuid and warns when one is predicted
+// to hit its limit within @p horizon seconds.  Writes fail with EDQUOT at the limit even when the filesystem has space left
+static void checkQuotas(const QString &uuid, const QString &mountpoint, const QString &stateDir, qint64 horizon, qint64 window) {
+    const QVector<BtrfsQgroup> qgroups = readQgroups(uuid);
+    for (const BtrfsQgroup &qgroup : qgroups) {
+        const qint64 headroom = quotaHeadroom(qgroup);
+        if (headroom < 0)
+            continue;
+
+        const QString name = QString::number(qgroup.level) + "/" + QString::number(qgroup.id);
+        UsageHistory history(stateDir + "/quota-" + uuid + "-" + QString::number(qgroup.level) + "_" + QString::number(qgroup.id) +
+                             ".history");
+        if (!history.load() || !history.append({QDateTime::currentSecsSinceEpoch(), static_cast<quint64>(headroom), 0})) {
+            qWarning().noquote() << "Failed to update the quota history of qgroup" << name << "of" << uuid << "in" << stateDir;
+            continue;
+        }
+
+        const qint64 remaining = secondsUntilFull(history.samples(), &UsageSample::dataFree, window);
+        const qint64 now = history.samples().last().time;
+        if (remaining < 0 || remaining > horizon || now - history.lastAlert(false) < alertInterval)
+            continue;
+
+        const QString when =
+            remaining >= 2 * 86400 ? QObject::tr("%1 days").arg(remaining / 86400) : QObject::tr("%1 hours").arg(remaining / 3600);
+        const QString subvolume = qgroup.level == 0 ? QObject::tr("subvolume %1").arg(qgroup.id) : QObject::tr("qgroup %1").arg(name);
+        notify(QObject::tr("Btrfs quota limit is approaching"),
+               QObject::tr("The %1 of %2 has %3 MiB left before its quota limit.  At the current rate it will reach it in about %4")
+                   .arg(subvolume, mountpoint)
+                   .arg(headroom / (1024 * 1024))
+                   .arg(when));
+        history.setLastAlert(false, now);
+    }
+}
+
+int main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    app.setApplicationName("btrfs-assistant");
+
+    QCommandLineParser cmdline;
+    cmdline.setApplicationDescription(
+        "Samples the free space and quota headroom of the mounted btrfs filesystems and warns before either runs out");
+    cmdline.addHelpOption();
+    QCommandLineOption horizonOption("horizon", "Warn when a filesystem is predicted to be full within this many days", "days", "7");
+    QCommandLineOption windowOption("window", "Fit the trend to this many hours of history", "hours", "48");
+    QCommandLineOption stateOption("state-dir", "Where the usage history is kept", "path");
+    cmdline.addOption(horizonOption);
+    cmdline.addOption(windowOption);
+    cmdline.addOption(stateOption);
+    cmdline.process(app);
+
+    QString stateDir = cmdline.value(stateOption);
+    if (stateDir.isEmpty())
+        stateDir = geteuid() == 0 ? "/var/lib/btrfs-assistant" : QStandardPaths::writableLocation(QStandardPaths::AppLocalDataLocation);
+    QDir().mkpath(stateDir);
+
+    const qint64 horizon = cmdline.value(horizonOption).toLongLong() * 86400;
+    const qint64 window = cmdline.value(windowOption).toLongLong() * 3600;
+
+    // Each filesystem is sampled once even if it is mounted several times
+    QSet<QByteArray> sampled;
+    const QStringList mountpoints = btrfsMountpoints();
+    for (const QString &mountpoint : mountpoints) {
+        BtrfsSpaceUsage usage;
+        if (!readSpaceUsage(mountpoint, usage) || sampled.contains(usage.fsid))
+            continue;
+        sampled.insert(usage.fsid);
+
+        const QString uuid = QUuid::fromRfc4122(usage.fsid).toString(QUuid::WithoutBraces);
+        UsageHistory history(stateDir + "/usage-" + uuid + ".history");
+        if (!history.load() || !history.append(sampleUsage(usage))) {
+            qWarning().noquote() << "Failed to update the usage history of" << uuid << "in" << stateDir;
+            continue;
+        }
+
+        checkTrend(history, false, mountpoint, horizon, window);
+        checkTrend(history, true, mountpoint, horizon, window);
+        checkQuotas(uuid, mountpoint, stateDir, horizon, window);
+    }
+
+    return 0;
+}
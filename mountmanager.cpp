@@ -0,0 +1,124 @@
+#include "mountmanager.h"
+#include "btrfsdiscovery.h"
+
+#include <QDebug>
+#include <QDir>
+#include <QFile>
+#include <QTimer>
+
+#include <cerrno>
+#include <cstring>
+
+#include <sys/mount.h>
+
+// The private mounts are made in here, only root can look inside
+static const QString mountDir = "/run/btrfs-assistant/";
+
+// An unused mount is kept around this long in case it's needed again
+static const int idleTimeout = 60 * 1000;
+
+// Turns mountDir into a mount of its own with private propagation, so mounts made in it aren't propagated to the other
+// mount namespaces.  Making the mounts in it private afterwards wouldn't retract what was already propagated
+static bool makeMountDirPrivate() {
+    const QByteArray dir = QFile::encodeName(mountDir);
+
+    // It only fails if mountDir isn't a mount yet, one made by an earlier run is kept
+    if (mount(nullptr, dir.constData(), nullptr, MS_PRIVATE, nullptr) == 0)
+        return true;
+
+    return mount(dir.constData(), dir.constData(), nullptr, MS_BIND, nullptr) == 0 &&
+           mount(nullptr, dir.constData(), nullptr, MS_PRIVATE, nullptr) == 0;
+}
+
+MountManager::MountManager(QObject *parent) : QObject(parent) {}
+
+MountManager::~MountManager() {
+    const QStringList uuids = mounts.keys();
+    for (const QString &uuid : uuids)
+        unmount(uuid);
+}
+
+QString MountManager::acquire(const QString &uuid) {
+    auto it = mounts.find(uuid);
+    if (it != mounts.end() && it->owned) {
+        // Something else may have unmounted it since
+        if (isTopLevelMountpoint(uuid, it->path)) {
+            it->users++;
+            it->idleTimer->stop();
+            return it->path;
+        }
+
+        qWarning() << "The top level of" << uuid << "is no longer mounted at" << it->path;
+        it->idleTimer->deleteLater();
+        it->idleTimer = nullptr;
+        it->owned = false;
+    }
+
+    // A mount made by someone else is looked up every time since it may be gone by now
+    const QString path = mountDir + uuid;
+    const QString existing = findTopLevelMountpoint(uuid);
+    if (!existing.isEmpty() && existing != path) {
+        Mount &entry = mounts[uuid];
+        entry.path = existing;
+        entry.users++;
+        return existing;
+    }
+
+    if (existing.isEmpty()) {
+        const QStringList devices = findBtrfsDevices(uuid);
+        if (devices.isEmpty() || !QDir().mkpath(path)) {
+            qWarning() << "Failed to find the filesystem" << uuid;
+            return QString();
+        }
+        QFile::setPermissions(mountDir, QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+        if (!makeMountDirPrivate())
+            qWarning() << "Failed to make" << mountDir << "private:" << strerror(errno);
+
+        // Any device of the filesystem can be used to mount it, they're all scanned already since it's mounted
+        const QByteArray target = QFile::encodeName(path);
+        if (mount(QFile::encodeName(devices.first()).constData(), target.constData(), "btrfs", MS_NOSUID | MS_NODEV, "subvolid=5") != 0) {
+            qWarning() << "Failed to mount the top level of" << uuid << ":" << strerror(errno);
+            QDir().rmdir(path);
+            return QString();
+        }
+    }
+
+    Mount &entry = mounts[uuid];
+    entry.path = path;
+    entry.users++;
+    entry.owned = true;
+    entry.idleTimer = new QTimer(this);
+    entry.idleTimer->setSingleShot(true);
+    entry.idleTimer->setInterval(idleTimeout);
+    connect(entry.idleTimer, &QTimer::timeout, this, [this, uuid] {
+        if (mounts.value(uuid).users == 0)
+            unmount(uuid);
+    });
+
+    return path;
+}
+
+void MountManager::release(const QString &uuid) {
+    auto it = mounts.find(uuid);
+    if (it == mounts.end() || it->users == 0 || --it->users > 0)
+        return;
+
+    if (it->owned)
+        it->idleTimer->start();
+    else
+        mounts.erase(it);
+}
+
+void MountManager::unmount(const QString &uuid) {
+    const Mount entry = mounts.take(uuid);
+    if (entry.idleTimer != nullptr)
+        entry.idleTimer->deleteLater();
+    if (!entry.owned)
+        return;
+
+    // Something may still have a file open in it, it is detached then and goes away once that is closed
+    const QByteArray path = QFile::encodeName(entry.path);
+    if (umount2(path.constData(), 0) != 0)
+        umount2(path.constData(), MNT_DETACH);
+    QDir().rmdir(entry.path);
+}
@@ -0,0 +1,67 @@
+#ifndef MOUNTMANAGER_H
+#define MOUNTMANAGER_H
+
+#include <QHash>
+#include <QObject>
+#include <QString>
+
+class QTimer;
+
+// Hands out mounts of the top level subvolume of btrfs filesystems, which is where snapshots are found and subvolumes are
+// created, deleted and restored.
+//
+// A mount of the top level made by someone else is used as it is.  Otherwise the filesystem is mounted once in a directory
+// under /run only root can look inside and shared by everything using it.  /run is usually shared with the other mount
+// namespaces, so that directory is bind mounted onto itself and made private first to keep the mounts in it out of them.
+// The mount is counted by its users and unmounted once it has been unused for a minute, so a series of operations doesn't
+// mount it again each time, and everything still mounted is unmounted when the manager is destroyed.  A mount that was
+// unmounted behind the manager's back is made again, and one left behind by a run that was killed is taken over and
+// cleaned up too
+class MountManager : public QObject {
+    Q_OBJECT
+
+  public:
+    explicit MountManager(QObject *parent = nullptr);
+    ~MountManager();
+
+    // Returns where the top level of the mounted filesystem @p uuid is mounted, or an empty string on failure.  Every call
+    // that succeeds has to be matched by a call to release()
+    QString acquire(const QString &uuid);
+    void release(const QString &uuid);
+
+  private:
+    struct Mount {
+        QString path;
+        int users = 0;
+        // Set if the mount was made by the manager and has to be unmounted by it
+        bool owned = false;
+        QTimer *idleTimer = nullptr;
+    };
+
+    void unmount(const QString &uuid);
+
+    QHash<QString, Mount> mounts;
+};
+
+// Holds a mount from a MountManager for as long as it exists
+class TopLevelMount {
+  public:
+    TopLevelMount(MountManager &manager, const QString &uuid) : manager(manager), uuid(uuid), mountpoint(manager.acquire(uuid)) {}
+    ~TopLevelMount() {
+        if (!mountpoint.isEmpty())
+            manager.release(uuid);
+    }
+
+    TopLevelMount(const TopLevelMount &) = delete;
+    TopLevelMount &operator=(const TopLevelMount &) = delete;
+
+    bool isValid() const { return !mountpoint.isEmpty(); }
+    const QString &path() const { return mountpoint; }
+
+  private:
+    MountManager &manager;
+    const QString uuid;
+    const QString mountpoint;
+};
+
+#endif // MOUNTMANAGER_H
@@ -0,0 +1,189 @@
+#include "outputparsers.h"
+#include "tokenizer.h"
+
+#include <QStringList>
+
+#include <algorithm>
+
+void parseFilesystemUsage(const QByteArray &output, Btrfs &btrfs) {
+    LineTokenizer usageLines(output);
+    std::string_view line;
+
+    // The indented lines under a profile or the Unallocated header list the raw space on each device
+    int profileIndex = -1;
+    bool unallocatedSection = false;
+    while (usageLines.next(line)) {
+        if (trimmed(line).empty()) {
+            profileIndex = -1;
+            unallocatedSection = false;
+            continue;
+        }
+
+        const std::string_view type = trimmed(field(line, ':', 0));
+        if (line.front() == ' ' || line.front() == '\t') {
+            if (profileIndex >= 0 || unallocatedSection) {
+                const QString device = toQString(word(line, 0));
+                const long bytes = toLong(word(line, 1));
+                if (unallocatedSection) {
+                    btrfs.devices[device].unallocated = bytes;
+                } else {
+                    btrfs.profiles[profileIndex].devices[device] = bytes;
+                    btrfs.devices[device].allocated += bytes;
+                }
+            } else if (type == "Device size") {
+                btrfs.totalSize = toLong(field(line, ':', 1));
+            } else if (type == "Device allocated") {
+                btrfs.allocatedSize = toLong(field(line, ':', 1));
+            } else if (type == "Used") {
+                btrfs.usedSize = toLong(field(line, ':', 1));
+            } else if (type == "Free (estimated)") {
+                btrfs.freeSize = toLong(word(field(line, ':', 1), 0));
+            }
+        } else if (type == "Unallocated") {
+            unallocatedSection = true;
+        } else if (type.find(',') != std::string_view::npos) {
+            // There can be several profiles of the same type while the filesystem is being converted
+            const long size = toLong(field(field(line, ':', 2), ',', 0));
+            const long used = toLong(word(field(line, ':', 3), 0));
+            btrfs.profiles.append({toQString(field(type, ',', 0)), toQString(field(type, ',', 1)), size, used, {}});
+            profileIndex = btrfs.profiles.size() - 1;
+
+            if (type.starts_with("Data,")) {
+                btrfs.dataSize += size;
+                btrfs.dataUsed += used;
+            } else if (type.starts_with("Metadata,")) {
+                btrfs.metaSize += size;
+                btrfs.metaUsed += used;
+            } else if (type.starts_with("System,")) {
+                btrfs.sysSize += size;
+                btrfs.sysUsed += used;
+            }
+        }
+    }
+}
+
+void parseSubvolumeList(const QByteArray &output, QMap<QString, QString> &subvolumes, QMap<QString, QString> &parents) {
+    LineTokenizer lines(output);
+    std::string_view line;
+    while (lines.next(line)) {
+        if (line.empty())
+            continue;
+
+        const QString subvolid = toQString(word(line, 1));
+        subvolumes[subvolid] = toQString(wordsFrom(line, 8));
+        parents[subvolid] = toQString(word(line, 6));
+    }
+}
+
+QString snapperConfigsCommand() { return "snapper --csvout list-configs"; }
+
+// Returns the CSV field @p value without the quotes snapper puts around a value containing a comma or a quote
+static QString unquoteCsv(std::string_view value) {
+    if (value.size() < 2 || value.front() != '"' || value.back() != '"')
+        return toQString(value);
+
+    return toQString(value.substr(1, value.size() - 2)).replace("\"\"", "\"");
+}
+
+QMap<QString, QString> parseSnapperConfigs(const QByteArray &output) {
+    QMap<QString, QString> configs;
+    LineTokenizer lines(output);
+    lines.skip(1);
+    std::string_view line;
+    while (lines.next(line)) {
+        // A config name can't contain a comma, the subvolume is everything after the first one
+        const QString name = unquoteCsv(field(line, ',', 0));
+        if (!name.isEmpty())
+            configs[name] = unquoteCsv(fieldsFrom(line, ',', 1));
+    }
+
+    return configs;
+}
+
+QStringList snapperListArguments(const QString &config) {
+    // The description is last so a | inside it doesn't shift the other columns
+    return {"--iso", "-c", config, "list", "--columns", "number,date,cleanup,type,userdata,pre-number,description"};
+}
+
+QString snapperListCommand(const QString &config) { return "snapper " + snapperListArguments(config).join(' '); }
+
+QVector<SnapperSnapshots> parseSnapperList(const QByteArray &output) {
+    QVector<SnapperSnapshots> snapshots;
+    LineTokenizer snapperList(output);
+    snapperList.skip(3);
+    std::string_view snap;
+    while (snapperList.next(snap)) {
+        if (trimmed(snap).empty())
+            continue;
+
+        snapshots.append({static_cast<int>(toLong(field(snap, '|', 0))), toQString(trimmed(field(snap, '|', 1))),
+                          toQString(trimmed(fieldsFrom(snap, '|', 6))), toQString(trimmed(field(snap, '|', 2))),
+                          toQString(trimmed(field(snap, '|', 3))), toQString(trimmed(field(snap, '|', 4))),
+                          static_cast<int>(toLong(trimmed(field(snap, '|', 5))))});
+    }
+
+    return snapshots;
+}
+
+// Returns the text between <@p tag> and </@p tag> in @p line, which has to start with <@p tag>
+static std::string_view elementText(std::string_view line, std::string_view tag) {
+    line.remove_prefix(tag.size() + 2);
+    return trimmed(line.substr(0, line.find("</")));
+}
+
+SnapperSnapshots parseSnapperInfo(const QByteArray &data) {
+    SnapperSnapshots snap;
+    snap.number = 0;
+
+    QString userdataKey;
+    QStringList userdata;
+
+    // Snapper writes every element on a line of its own
+    LineTokenizer lines(data);
+    std::string_view rawLine;
+    while (lines.next(rawLine)) {
+        const std::string_view line = trimmed(rawLine);
+        if (line.starts_with("<num>"))
+            snap.number = static_cast<int>(toLong(elementText(line, "num")));
+        else if (line.starts_with("<date>"))
+            snap.time = toQString(elementText(line, "date"));
+        else if (line.starts_with("<description>"))
+            snap.desc = toQString(elementText(line, "description"));
+        else if (line.starts_with("<cleanup>"))
+            snap.cleanup = toQString(elementText(line, "cleanup"));
+        else if (line.starts_with("<type>"))
+            snap.type = toQString(elementText(line, "type"));
+        else if (line.starts_with("<pre_num>"))
+            snap.preNumber = static_cast<int>(toLong(elementText(line, "pre_num")));
+        else if (line.starts_with("<key>"))
+            userdataKey = toQString(elementText(line, "key"));
+        else if (line.starts_with("<value>"))
+            userdata.append(userdataKey + "=" + toQString(elementText(line, "value")));
+    }
+
+    // Use the same format as snapper list
+    snap.userdata = userdata.join(", ");
+
+    return snap;
+}
+
+QStringList parseFindNew(const QByteArray &output) {
+    QStringList paths;
+    LineTokenizer lines(output);
+    std::string_view line;
+    while (lines.next(line)) {
+        // inode 257 file offset 0 len 4096 disk start 1234 offset 0 gen 10 flags NONE path, the last line is the transid
+        // marker which only has the generation to pass next time
+        if (!line.starts_with("inode "))
+            continue;
+
+        const std::string_view path = wordsFrom(line, 16);
+        if (!path.empty())
+            paths.append(toQString(path));
+    }
+
+    // A file written in several places has a line for each extent
+    paths.sort();
+    paths.erase(std::unique(paths.begin(), paths.end()), paths.end());
+    return paths;
+}
@@ -0,0 +1,111 @@
+#ifndef OUTPUTPARSERS_H
+#define OUTPUTPARSERS_H
+
+#include "btrfsioctl.h"
+
+#include <QByteArray>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+/*
+ *
+ * Parsers for the output of btrfs-progs and snapper and the files snapper keeps.
+ *
+ * They only turn bytes into data and don't run anything or touch the UI, so they work the same on output read from the
+ * system, recorded by a RecordingBackend or replayed from a capture.
+ *
+ */
+
+// The allocation of one block group type and profile, such as Data,RAID1.  The size is logical, the per device sizes
+// are the raw space used on each device
+struct BtrfsProfileUsage {
+    QString type;
+    QString profile;
+    long size;
+    long used;
+    QMap<QString, long> devices;
+};
+
+// The raw space of a single device
+struct BtrfsDeviceUsage {
+    long allocated;
+    long unallocated;
+};
+
+struct Btrfs {
+    QString mountPoint;
+    long totalSize;
+    long allocatedSize;
+    long usedSize;
+    long freeSize;
+    long dataSize;
+    long dataUsed;
+    long metaSize;
+    long metaUsed;
+    long sysSize;
+    long sysUsed;
+    QVector<BtrfsProfileUsage> profiles;
+    QMap<QString, BtrfsDeviceUsage> devices;
+    QMap<QString, QString> subVolumes;
+    // The subvolid of the subvolume each subvolume is directly inside of, keyed by subvolid
+    QMap<QString, QString> subvolParents;
+    // The generation the usage and the subvolumes were read at
+    GenerationStamp usageStamp;
+    GenerationStamp subvolStamp;
+};
+
+// A snapshot with its snapper metadata.  The type is single, pre or post and the cleanup algorithm is empty for a
+// snapshot none of the cleanup algorithms may delete
+struct SnapperSnapshots {
+    int number;
+    QString time;
+    QString desc;
+    QString cleanup;
+    QString type;
+    // The key=value pairs separated by ", " as snapper list shows them
+    QString userdata;
+    // For a post snapshot, the number of the pre snapshot it pairs with
+    int preNumber = 0;
+};
+
+struct SnapperSubvolume {
+    QString subvol;
+    QString subvolid;
+    QString time;
+    QString desc;
+    QString uuid;
+    QString type;
+    QString userdata;
+};
+
+// Fills the sizes, profiles and devices of @p btrfs from the output of btrfs filesystem usage -b
+void parseFilesystemUsage(const QByteArray &output, Btrfs &btrfs);
+
+// Fills @p subvolumes with the path of each subvolume and @p parents with the subvolume each one is directly inside of,
+// both keyed by subvolid, from the output of btrfs subvolume list
+void parseSubvolumeList(const QByteArray &output, QMap<QString, QString> &subvolumes, QMap<QString, QString> &parents);
+
+// Returns the snapper command listing the configs in the form parseSnapperConfigs() reads
+QString snapperConfigsCommand();
+
+// Returns the subvolume of each config, keyed by the config name, listed by the command of snapperConfigsCommand()
+QMap<QString, QString> parseSnapperConfigs(const QByteArray &output);
+
+// Returns the snapper command listing the snapshots of @p config in the form parseSnapperList() reads, and the arguments
+// of snapper in it for running it without a shell
+QString snapperListCommand(const QString &config);
+QStringList snapperListArguments(const QString &config);
+
+// Returns the snapshots listed by the command of snapperListCommand()
+QVector<SnapperSnapshots> parseSnapperList(const QByteArray &output);
+
+// Returns the snapshot described by the snapper info.xml @p data.  The number is 0 if it isn't a valid info.xml
+SnapperSnapshots parseSnapperInfo(const QByteArray &data);
+
+// Returns the paths of the files with data written after a generation, sorted and without duplicates, from the output of
+// btrfs subvolume find-new
+QStringList parseFindNew(const QByteArray &output);
+
+#endif // OUTPUTPARSERS_H
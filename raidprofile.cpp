@@ -0,0 +1,69 @@
+#include "raidprofile.h"
+
+#include <algorithm>
+#include <functional>
+#include <numeric>
+
+// The largest data stripe the kernel allocates at once
+static const quint64 chunkSize = 1ULL << 30;
+
+// Devices with less unallocated space than this are treated as full
+static const quint64 minimumStripe = 1ULL << 20;
+
+RaidProfile raidProfile(const QString &name) {
+    RaidProfile profile;
+    const QString upper = name.toUpper();
+
+    if (upper == "DUP") {
+        profile.copies = 2;
+        profile.dup = true;
+    } else if (upper == "RAID0") {
+        profile.maxDevices = 0;
+    } else if (upper == "RAID1") {
+        profile.copies = profile.minDevices = profile.maxDevices = 2;
+    } else if (upper == "RAID1C3") {
+        profile.copies = profile.minDevices = profile.maxDevices = 3;
+    } else if (upper == "RAID1C4") {
+        profile.copies = profile.minDevices = profile.maxDevices = 4;
+    } else if (upper == "RAID10") {
+        profile.copies = profile.minDevices = profile.deviceIncrement = 2;
+        profile.maxDevices = 0;
+    } else if (upper == "RAID5") {
+        profile.parity = 1;
+        profile.minDevices = 2;
+        profile.maxDevices = 0;
+    } else if (upper == "RAID6") {
+        profile.parity = 2;
+        profile.minDevices = 3;
+        profile.maxDevices = 0;
+    }
+
+    return profile;
+}
+
+quint64 allocatableSpace(const RaidProfile &profile, QVector<quint64> unallocated, quint64 &stranded) {
+    const quint64 perDevice = profile.dup ? profile.copies : 1;
+    quint64 usable = 0;
+
+    // Like the kernel each chunk goes to the devices with the most unallocated space
+    while (true) {
+        std::sort(unallocated.begin(), unallocated.end(), std::greater<quint64>());
+
+        int devices = std::count_if(unallocated.cbegin(), unallocated.cend(),
+                                    [perDevice](quint64 space) { return space >= minimumStripe * perDevice; });
+        if (profile.maxDevices > 0)
+            devices = std::min(devices, profile.maxDevices);
+        devices -= devices % profile.deviceIncrement;
+        if (devices < profile.minDevices || devices == 0)
+            break;
+
+        const quint64 stripe = std::min(chunkSize, unallocated.at(devices - 1) / perDevice);
+        for (int i = 0; i < devices; i++)
+            unallocated[i] -= stripe * perDevice;
+
+        usable += profile.dup ? stripe : stripe * (devices - profile.parity) / profile.copies;
+    }
+
+    stranded = std::accumulate(unallocated.cbegin(), unallocated.cend(), quint64(0));
+    return usable;
+}
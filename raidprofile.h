@@ -0,0 +1,30 @@
+#ifndef RAIDPROFILE_H
+#define RAIDPROFILE_H
+
+#include <QString>
+#include <QVector>
+
+// How a block group profile lays out its stripes, mirrors the kernel's btrfs_raid_array
+struct RaidProfile {
+    // Copies of each stripe, 2 for DUP and RAID1, 3 for RAID1C3 and so on
+    int copies = 1;
+    // Stripes per chunk holding parity instead of data
+    int parity = 0;
+    int minDevices = 1;
+    // The most devices a chunk is striped over, 0 means all devices with free space
+    int maxDevices = 1;
+    // The number of devices used has to be a multiple of this
+    int deviceIncrement = 1;
+    // All the copies are on a single device
+    bool dup = false;
+};
+
+// Returns the layout of the profile named @p name as printed by btrfs fi usage, e.g. single, DUP, RAID1C3 or RAID10
+RaidProfile raidProfile(const QString &name);
+
+// Simulates the chunk allocator to find how much more data with @p profile fits into the @p unallocated space of each
+// device.  This is what btrfs fi usage estimates, but done per device so it stays correct for devices of mixed sizes.
+// @p stranded is set to the raw space left over which can't be used with this profile
+quint64 allocatableSpace(const RaidProfile &profile, QVector<quint64> unallocated, quint64 &stranded);
+
+#endif // RAIDPROFILE_H
@@ -0,0 +1,249 @@
+#include "replication.h"
+#include "btrfsioctl.h"
+
+#include <QDir>
+#include <QElapsedTimer>
+#include <QFile>
+#include <QFileInfo>
+#include <QMap>
+#include <QObject>
+#include <QSet>
+#include <QTemporaryFile>
+
+#include <algorithm>
+#include <cerrno>
+#include <csignal>
+#include <cstring>
+#include <fcntl.h>
+#include <linux/btrfs.h>
+#include <spawn.h>
+#include <sys/ioctl.h>
+#include <sys/wait.h>
+#include <thread>
+#include <unistd.h>
+
+extern char **environ;
+
+// The most data moved by a single splice call, also used as the size of both pipe buffers
+static const size_t spliceChunk = 1024 * 1024;
+
+static QString errnoString(int error) { return QString::fromLocal8Bit(strerror(error)); }
+
+ReplicationResult SnapshotReplicator::replicate(const QString &snapshotDir, QList<int> numbers, const QString &target) {
+    ReplicationResult result;
+    QElapsedTimer timer;
+    timer.start();
+    transferred = 0;
+
+    // Every read-only snapshot in the source directory can be a parent, not only the ones being sent
+    QMap<int, BtrfsSubvolInfo> sources;
+    const QStringList sourceEntries = QDir(snapshotDir).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &entry : sourceEntries) {
+        bool isNumber = false;
+        const int number = entry.toInt(&isNumber);
+        BtrfsSubvolInfo info;
+        if (isNumber && readSubvolInfo(snapshotDir + "/" + entry + "/snapshot", info) && info.readOnly)
+            sources.insert(number, info);
+    }
+
+    // The snapshots already on the target, identified by the uuid of the snapshot they were received from
+    QSet<QByteArray> received;
+    const QStringList targetEntries = QDir(target).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &entry : targetEntries) {
+        BtrfsSubvolInfo info;
+        if (readSubvolInfo(target + "/" + entry + "/snapshot", info) && !info.receivedUuid.isEmpty())
+            received.insert(info.receivedUuid);
+    }
+
+    std::sort(numbers.begin(), numbers.end());
+    for (const int number : qAsConst(numbers)) {
+        current = number;
+
+        const auto source = sources.constFind(number);
+        if (source == sources.constEnd()) {
+            result.errors.append(QObject::tr("Snapshot %1 is not a read-only snapshot").arg(number));
+            continue;
+        }
+
+        if (received.contains(source->uuid)) {
+            result.skipped++;
+            continue;
+        }
+
+        // Use the closest snapshot the target already has as the parent.  Older snapshots are preferred since the
+        // snapshot being sent was most likely taken after them
+        const BtrfsSubvolInfo *parent = nullptr;
+        for (auto it = source; it != sources.constBegin() && parent == nullptr;) {
+            --it;
+            if (received.contains(it->uuid))
+                parent = &it.value();
+        }
+        for (auto it = std::next(source); it != sources.constEnd() && parent == nullptr; ++it) {
+            if (received.contains(it->uuid))
+                parent = &it.value();
+        }
+
+        const QString sourcePath = snapshotDir + "/" + QString::number(number);
+        const QString destination = target + "/" + QString::number(number);
+        if (QFileInfo::exists(destination + "/snapshot")) {
+            result.errors.append(QObject::tr("Snapshot %1: a different snapshot with this number is already on the target").arg(number));
+            continue;
+        }
+
+        if (!QDir().mkpath(destination)) {
+            result.errors.append(QObject::tr("Snapshot %1: failed to create %2").arg(number).arg(destination));
+            continue;
+        }
+
+        QString error;
+        if (!transfer(sourcePath + "/snapshot", parent, destination, error)) {
+            result.errors.append(QObject::tr("Snapshot %1: %2").arg(number).arg(error));
+
+            // Don't leave a partially received snapshot behind where it could be mistaken for a complete one.  It is a
+            // subvolume, which rmdir can't remove, so it is deleted as one before the directory
+            if (isSubvolume(destination + "/snapshot") && !deleteSubvolume(destination + "/snapshot"))
+                result.errors.append(QObject::tr("Snapshot %1: failed to delete the partially received %2/snapshot")
+                                         .arg(number)
+                                         .arg(destination));
+            QDir(destination).removeRecursively();
+            continue;
+        }
+
+        QFile::copy(sourcePath + "/info.xml", destination + "/info.xml");
+        received.insert(source->uuid);
+        result.sent++;
+        if (parent != nullptr)
+            result.incremental++;
+    }
+
+    result.bytes = transferred;
+    result.elapsedMs = timer.elapsed();
+    return result;
+}
+
+// Runs a single send into a btrfs receive process writing to @p destination.  The stream is incremental against
+// @p parent unless it is null
+bool SnapshotReplicator::transfer(const QString &source, const BtrfsSubvolInfo *parent, const QString &destination, QString &error) {
+    const int sourceFd = open(QFile::encodeName(source).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (sourceFd < 0) {
+        error = errnoString(errno);
+        return false;
+    }
+
+    // The kernel writes the stream into sendPipe, from there it is spliced into receivePipe which is the receiver's stdin
+    int sendPipe[2];
+    int receivePipe[2];
+    if (pipe2(sendPipe, O_CLOEXEC) != 0) {
+        error = errnoString(errno);
+        close(sourceFd);
+        return false;
+    }
+    if (pipe2(receivePipe, O_CLOEXEC) != 0) {
+        error = errnoString(errno);
+        close(sendPipe[0]);
+        close(sendPipe[1]);
+        close(sourceFd);
+        return false;
+    }
+    fcntl(sendPipe[1], F_SETPIPE_SZ, spliceChunk);
+    fcntl(receivePipe[1], F_SETPIPE_SZ, spliceChunk);
+
+    // btrfs receive only writes to stderr when something goes wrong, it is kept for the error message
+    QTemporaryFile receiveLog;
+    receiveLog.open();
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    posix_spawn_file_actions_adddup2(&actions, receivePipe[0], STDIN_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, receiveLog.handle(), STDERR_FILENO);
+
+    // main() ignores SIGPIPE for the whole application, the receiver gets the default behaviour back
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t defaultSignals;
+    sigemptyset(&defaultSignals);
+    sigaddset(&defaultSignals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attributes, &defaultSignals);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF);
+
+    const QByteArray destinationPath = QFile::encodeName(destination);
+    char *const argv[] = {const_cast<char *>("btrfs"), const_cast<char *>("receive"), const_cast<char *>(destinationPath.constData()),
+                          nullptr};
+    pid_t pid = 0;
+    const int spawnError = posix_spawnp(&pid, "btrfs", &actions, &attributes, argv, environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    close(receivePipe[0]);
+
+    if (spawnError != 0) {
+        error = QObject::tr("Failed to start btrfs receive: %1").arg(errnoString(spawnError));
+        close(receivePipe[1]);
+        close(sendPipe[0]);
+        close(sendPipe[1]);
+        close(sourceFd);
+        return false;
+    }
+
+    // The send ioctl blocks until the whole stream has been written so it gets its own thread
+    int sendError = 0;
+    std::thread sender([sourceFd, parent, &sendPipe, &sendError] {
+        quint64 parentRoot = parent == nullptr ? 0 : parent->treeId;
+        btrfs_ioctl_send_args args = {};
+        args.send_fd = sendPipe[1];
+        if (parent != nullptr) {
+            args.parent_root = parentRoot;
+            args.clone_sources = &parentRoot;
+            args.clone_sources_count = 1;
+        }
+
+        if (ioctl(sourceFd, BTRFS_IOC_SEND, &args) != 0)
+            sendError = errno;
+
+        // Closing the write end is what tells the splice loop the stream is complete
+        close(sendPipe[1]);
+    });
+
+    int spliceError = 0;
+    while (true) {
+        const ssize_t moved = splice(sendPipe[0], nullptr, receivePipe[1], nullptr, spliceChunk, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (moved == 0)
+            break;
+        if (moved < 0) {
+            if (errno == EINTR)
+                continue;
+            spliceError = errno;
+            break;
+        }
+        transferred += moved;
+    }
+
+    // Closing the read end makes a send which is still running fail with EPIPE instead of blocking forever
+    close(sendPipe[0]);
+    close(receivePipe[1]);
+    sender.join();
+    close(sourceFd);
+
+    int status = 0;
+    while (waitpid(pid, &status, 0) < 0 && errno == EINTR) {
+    }
+
+    if (sendError != 0) {
+        error = QObject::tr("Send failed: %1").arg(errnoString(sendError));
+        return false;
+    }
+
+    if (spliceError != 0) {
+        error = errnoString(spliceError);
+        return false;
+    }
+
+    if (!WIFEXITED(status) || WEXITSTATUS(status) != 0) {
+        receiveLog.seek(0);
+        error = QString::fromLocal8Bit(receiveLog.readAll()).trimmed();
+        if (error.isEmpty())
+            error = QObject::tr("btrfs receive failed");
+        return false;
+    }
+
+    return true;
+}
@@ -0,0 +1,46 @@
+#ifndef REPLICATION_H
+#define REPLICATION_H
+
+#include <QList>
+#include <QString>
+#include <QStringList>
+
+#include <atomic>
+
+struct BtrfsSubvolInfo;
+
+struct ReplicationResult {
+    int sent = 0;
+    int incremental = 0;
+    int skipped = 0;
+    quint64 bytes = 0;
+    qint64 elapsedMs = 0;
+    QStringList errors;
+};
+
+// Copies snapper snapshots to another btrfs filesystem with send/receive.  The send stream is spliced from the kernel
+// straight into a btrfs receive process so nothing is buffered in user space or written to a temporary file.
+//
+// The target directory mirrors the snapper layout, each snapshot is received into <target>/<number>/snapshot next to a
+// copy of its info.xml.  A snapshot is sent incrementally against the closest snapshot the target already has, found by
+// matching the received_uuid of the copies on the target with the uuid of the source snapshots.
+//
+// The process has to ignore SIGPIPE, otherwise a btrfs receive which exits early kills it instead of failing the send
+class SnapshotReplicator {
+  public:
+    // Sends the snapshots @p numbers from the snapper snapshot directory @p snapshotDir to @p target, oldest first so
+    // each one can be used as the parent of the next.  Blocks until done.  Requires root
+    ReplicationResult replicate(const QString &snapshotDir, QList<int> numbers, const QString &target);
+
+    // The progress of the running replication, safe to call from another thread
+    quint64 bytesTransferred() const { return transferred; }
+    int currentSnapshot() const { return current; }
+
+  private:
+    bool transfer(const QString &source, const BtrfsSubvolInfo *parent, const QString &destination, QString &error);
+
+    std::atomic<quint64> transferred = 0;
+    std::atomic<int> current = 0;
+};
+
+#endif // REPLICATION_H
@@ -0,0 +1,139 @@
+#include "retention.h"
+#include "btrfs-assistant.h"
+
+#include <QDateTime>
+#include <QSet>
+
+#include <algorithm>
+
+void RetentionSimulator::setSnapshots(const QVector<SnapperSnapshots> &snapshots) {
+    timeline.clear();
+    numbered.clear();
+    numbers.clear();
+    numbers.reserve(snapshots.size());
+
+    // A post snapshot is paired with its pre snapshot when both are cleaned up by the same algorithm, the pair is then
+    // one entry on the pre snapshot
+    QHash<int, int> pres;
+    for (int i = 0; i < snapshots.size(); i++) {
+        if (snapshots.at(i).type == "pre")
+            pres.insert(snapshots.at(i).number, i);
+    }
+    QHash<int, int> posts;
+    for (int i = 0; i < snapshots.size(); i++) {
+        const SnapperSnapshots &snap = snapshots.at(i);
+        const int pre = pres.value(snap.preNumber, -1);
+        if (snap.type == "post" && pre >= 0 && snapshots.at(pre).cleanup == snap.cleanup && !posts.contains(pre))
+            posts.insert(pre, i);
+    }
+    QSet<int> pairedPosts;
+    for (const int post : qAsConst(posts))
+        pairedPosts.insert(post);
+
+    for (int i = 0; i < snapshots.size(); i++) {
+        const SnapperSnapshots &snap = snapshots.at(i);
+        numbers.append(snap.number);
+
+        if ((snap.cleanup != "timeline" && snap.cleanup != "number") || pairedPosts.contains(i))
+            continue;
+
+        // snapper buckets the dates in local time
+        const QDateTime dateTime = QDateTime::fromString(snap.time, "yyyy-MM-dd HH:mm:ss");
+        if (!dateTime.isValid())
+            continue;
+
+        // A pair is as young as its post snapshot
+        const int postIndex = posts.value(i, -1);
+        qint64 time = dateTime.toSecsSinceEpoch();
+        if (postIndex >= 0) {
+            const QDateTime postTime = QDateTime::fromString(snapshots.at(postIndex).time, "yyyy-MM-dd HH:mm:ss");
+            if (postTime.isValid())
+                time = qMax(time, postTime.toSecsSinceEpoch());
+        }
+
+        const QDate date = dateTime.date();
+        int weekYear = 0;
+        const int week = date.weekNumber(&weekYear);
+        const Entry entry = {i,
+                             postIndex,
+                             snap.number,
+                             time,
+                             date.toJulianDay() * 24 + dateTime.time().hour(),
+                             date.toJulianDay(),
+                             weekYear * 100 + week,
+                             date.year() * 12 + date.month(),
+                             date.year()};
+
+        if (snap.cleanup == "timeline")
+            timeline.append(entry);
+        else
+            numbered.append(entry);
+    }
+
+    // Both algorithms walk the snapshots from oldest to newest by number
+    const auto byNumber = [](const Entry &a, const Entry &b) { return a.number < b.number; };
+    std::sort(timeline.begin(), timeline.end(), byNumber);
+    std::sort(numbered.begin(), numbered.end(), byNumber);
+}
+
+QVector<bool> RetentionSimulator::simulate(const RetentionLimits &limits) const {
+    // Snapshots which aren't managed by either algorithm are never removed
+    QVector<bool> kept(numbers.size(), true);
+    const qint64 now = QDateTime::currentSecsSinceEpoch();
+
+    // Timeline: walking from newest to oldest, a snapshot is kept if it is the oldest snapshot in its hour, day, week,
+    // month or year and that period's limit hasn't been reached yet
+    int hourly = 0, daily = 0, weekly = 0, monthly = 0, yearly = 0;
+    for (int i = timeline.size() - 1; i >= 0; i--) {
+        const Entry &entry = timeline.at(i);
+        const Entry *previous = i > 0 ? &timeline.at(i - 1) : nullptr;
+        bool keep = false;
+
+        if (hourly < limits.hourly && (!previous || previous->hour != entry.hour)) {
+            hourly++;
+            keep = true;
+        }
+        if (daily < limits.daily && (!previous || previous->day != entry.day)) {
+            daily++;
+            keep = true;
+        }
+        if (monthly < limits.monthly && (!previous || previous->month != entry.month)) {
+            monthly++;
+            keep = true;
+        }
+        if (weekly < limits.weekly && (!previous || previous->week != entry.week)) {
+            weekly++;
+            keep = true;
+        }
+        if (yearly < limits.yearly && (!previous || previous->year != entry.year)) {
+            yearly++;
+            keep = true;
+        }
+
+        // Snapshots younger than the minimum age are always spared
+        kept[entry.index] = keep || now - entry.time < limits.timelineMinAge;
+        if (entry.postIndex >= 0)
+            kept[entry.postIndex] = kept.at(entry.index);
+    }
+
+    // Number: the newest snapshots up to the limit are kept, a pair counts as one
+    int count = 0;
+    for (int i = numbered.size() - 1; i >= 0; i--) {
+        const Entry &entry = numbered.at(i);
+        kept[entry.index] = count++ < limits.number || now - entry.time < limits.numberMinAge;
+        if (entry.postIndex >= 0)
+            kept[entry.postIndex] = kept.at(entry.index);
+    }
+
+    return kept;
+}
+
+qint64 RetentionSimulator::reclaimedSize(const QVector<bool> &kept) const {
+    qint64 size = 0;
+    for (int i = 0; i < kept.size() && i < numbers.size(); i++) {
+        if (!kept.at(i))
+            size += exclusiveSizes.value(numbers.at(i));
+    }
+
+    return size;
+}
@@ -0,0 +1,63 @@
+#ifndef RETENTION_H
+#define RETENTION_H
+
+#include <QHash>
+#include <QVector>
+
+struct SnapperSnapshots;
+
+// The snapper config values which control the timeline and number cleanup algorithms
+struct RetentionLimits {
+    int hourly = 0;
+    int daily = 0;
+    int weekly = 0;
+    int monthly = 0;
+    int yearly = 0;
+    int number = 0;
+    qint64 timelineMinAge = 1800;
+    qint64 numberMinAge = 1800;
+};
+
+// Replays snapper's timeline and number cleanup algorithms over a list of snapshots so the effect of a set of limits
+// can be previewed before they are written to the config.
+//
+// The snapshot dates are bucketed into hours, days, weeks, months and years once in setSnapshots() so each call to
+// simulate() is a single linear pass, which is cheap enough to run every time a limit changes.  Like snapper, a pre
+// snapshot and the post snapshot paired with it are counted as one and kept or removed together.
+class RetentionSimulator {
+  public:
+    void setSnapshots(const QVector<SnapperSnapshots> &snapshots);
+
+    // Sets the exclusive size in bytes of each snapshot, keyed by snapshot number
+    void setExclusiveSizes(const QHash<int, qint64> &sizes) { exclusiveSizes = sizes; }
+    bool hasExclusiveSizes() const { return !exclusiveSizes.isEmpty(); }
+
+    // Returns a vector parallel to the list passed to setSnapshots() which is true for each snapshot that would be kept
+    QVector<bool> simulate(const RetentionLimits &limits) const;
+
+    // Returns the sum of the exclusive sizes of the snapshots that @p kept marks as pruned.  Data shared only between
+    // pruned snapshots is not counted so this is a lower bound of the space that would be freed
+    qint64 reclaimedSize(const QVector<bool> &kept) const;
+
+  private:
+    struct Entry {
+        int index;
+        // The index of the post snapshot paired with this pre snapshot, or -1
+        int postIndex;
+        int number;
+        // The time of the newest snapshot of the pair, for the minimum age
+        qint64 time;
+        qint64 hour;
+        qint64 day;
+        int week;
+        int month;
+        int year;
+    };
+
+    QVector<Entry> timeline;
+    QVector<Entry> numbered;
+    QHash<int, qint64> exclusiveSizes;
+    QVector<int> numbers;
+};
+
+#endif // RETENTION_H
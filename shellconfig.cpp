@@ -0,0 +1,272 @@
+#include "shellconfig.h"
+
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+static bool isNameStart(char c) { return (c >= 'A' && c <= 'Z') || (c >= 'a' && c <= 'z') || c == '_'; }
+
+static bool isNameChar(char c) { return isNameStart(c) || (c >= '0' && c <= '9'); }
+
+static bool isBlank(char c) { return c == ' ' || c == '\t'; }
+
+// Returns the position after the line break of the line containing @p pos
+static int lineEnd(const QByteArray &data, int pos) {
+    const int newline = data.indexOf('\n', pos);
+    return newline < 0 ? data.size() : newline + 1;
+}
+
+// Decodes the shell word starting at @p pos into @p value.  Returns the position after the word, or -1 if a quote isn't
+// closed.  A quoted part may span several lines
+static int parseWord(const QByteArray &data, int pos, QByteArray &value) {
+    while (pos < data.size()) {
+        const char c = data.at(pos);
+        if (c == '\'') {
+            const int end = data.indexOf('\'', pos + 1);
+            if (end < 0)
+                return -1;
+            value += data.mid(pos + 1, end - pos - 1);
+            pos = end + 1;
+        } else if (c == '"') {
+            pos++;
+            while (true) {
+                if (pos >= data.size())
+                    return -1;
+                const char quoted = data.at(pos);
+                if (quoted == '"') {
+                    pos++;
+                    break;
+                }
+
+                // Inside double quotes a backslash only escapes these characters, an escaped line break is removed
+                const char next = pos + 1 < data.size() ? data.at(pos + 1) : '\0';
+                if (quoted == '\\' && (next == '"' || next == '\\' || next == '$' || next == '`' || next == '\n')) {
+                    if (next != '\n')
+                        value += next;
+                    pos += 2;
+                } else {
+                    value += quoted;
+                    pos++;
+                }
+            }
+        } else if (c == '\\' && pos + 1 < data.size()) {
+            if (data.at(pos + 1) != '\n')
+                value += data.at(pos + 1);
+            pos += 2;
+        } else if (isBlank(c) || c == '\n' || c == '\r' || c == ';') {
+            break;
+        } else {
+            value += c;
+            pos++;
+        }
+    }
+
+    return pos;
+}
+
+// Returns true if @p value can be written without quotes
+static bool isPlainWord(const QByteArray &value) {
+    if (value.isEmpty())
+        return false;
+
+    for (const char c : value) {
+        if (!isNameChar(c) && !QByteArray("-./:,@%+=").contains(c))
+            return false;
+    }
+
+    return true;
+}
+
+// Quotes @p value for the shell in the same style as the word @p original
+static QByteArray quote(const QString &value, const QByteArray &original) {
+    const QByteArray bytes = value.toUtf8();
+    if (original.startsWith('\'') && !bytes.contains('\''))
+        return '\'' + bytes + '\'';
+
+    if (!original.isEmpty() && !original.startsWith('"') && !original.startsWith('\'') && isPlainWord(bytes))
+        return bytes;
+
+    QByteArray quoted = "\"";
+    for (const char c : bytes) {
+        if (c == '"' || c == '\\' || c == '$' || c == '`')
+            quoted += '\\';
+        quoted += c;
+    }
+
+    return quoted + '"';
+}
+
+bool ShellConfig::load(const QString &path) {
+    QFile file(path);
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    parse(file.readAll());
+    return true;
+}
+
+void ShellConfig::parse(const QByteArray &data) {
+    nodes.clear();
+    index.clear();
+
+    int pos = 0;
+    while (pos < data.size()) {
+        Node node;
+        int end = lineEnd(data, pos);
+
+        int name = pos;
+        while (name < end && isBlank(data.at(name)))
+            name++;
+        if (data.mid(name, 6) == "export" && name + 6 < end && isBlank(data.at(name + 6))) {
+            name += 6;
+            while (name < end && isBlank(data.at(name)))
+                name++;
+        }
+
+        int nameEnd = name;
+        if (nameEnd < end && isNameStart(data.at(nameEnd))) {
+            while (nameEnd < end && isNameChar(data.at(nameEnd)))
+                nameEnd++;
+        }
+
+        // Anything that isn't a complete NAME=value assignment is kept as text
+        if (nameEnd > name && nameEnd < end && data.at(nameEnd) == '=') {
+            QByteArray value;
+            const int valueEnd = parseWord(data, nameEnd + 1, value);
+            if (valueEnd >= 0) {
+                node.key = QString::fromLatin1(data.mid(name, nameEnd - name));
+                node.valueStart = nameEnd + 1 - pos;
+                node.valueLength = valueEnd - nameEnd - 1;
+                node.value = QString::fromUtf8(value);
+                end = lineEnd(data, valueEnd);
+            }
+        }
+
+        node.text = data.mid(pos, end - pos);
+        addNode(node);
+        pos = end;
+    }
+}
+
+void ShellConfig::addNode(const Node &node) {
+    if (!node.key.isEmpty())
+        index[node.key] = nodes.size();
+    nodes.append(node);
+}
+
+bool ShellConfig::save(const QString &path, QString &error) const {
+    // QSaveFile writes a temporary file next to path and syncs it before renaming it over path
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly) || file.write(toByteArray()) < 0 || !file.commit()) {
+        error = file.errorString();
+        return false;
+    }
+
+    // Sync the directory too so the rename is on disk as well
+    const int fd = open(QFile::encodeName(QFileInfo(path).absolutePath()).constData(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd >= 0) {
+        fsync(fd);
+        close(fd);
+    }
+
+    return true;
+}
+
+QByteArray ShellConfig::toByteArray() const {
+    QByteArray data;
+    for (const Node &node : nodes)
+        data += node.text;
+
+    return data;
+}
+
+QStringList ShellConfig::keys() const {
+    QStringList keys;
+    for (int i = 0; i < nodes.size(); i++) {
+        if (!nodes.at(i).key.isEmpty() && index.value(nodes.at(i).key) == i)
+            keys.append(nodes.at(i).key);
+    }
+
+    return keys;
+}
+
+QString ShellConfig::value(const QString &key, const QString &defaultValue) const {
+    const auto it = index.constFind(key);
+    return it == index.constEnd() ? defaultValue : nodes.at(it.value()).value;
+}
+
+void ShellConfig::setValue(const QString &key, const QString &value) {
+    const auto it = index.constFind(key);
+    if (it == index.constEnd()) {
+        if (!nodes.isEmpty() && !nodes.last().text.endsWith('\n'))
+            nodes.last().text += '\n';
+
+        Node node;
+        const QByteArray quoted = quote(value, "\"");
+        node.text = key.toUtf8() + '=' + quoted + '\n';
+        node.key = key;
+        node.valueStart = node.text.indexOf('=') + 1;
+        node.valueLength = quoted.size();
+        node.value = value;
+        addNode(node);
+        return;
+    }
+
+    // Leave the text alone when nothing changes so a value that can't be quoted back identically, such as one using
+    // $VARIABLE, isn't touched
+    Node &node = nodes[it.value()];
+    if (node.value == value)
+        return;
+
+    const QByteArray quoted = quote(value, node.text.mid(node.valueStart, node.valueLength));
+    node.text.replace(node.valueStart, node.valueLength, quoted);
+    node.valueLength = quoted.size();
+    node.value = value;
+}
+
+// Where snapper keeps its configs and the files listing them, which one is used depends on the distribution
+static const QString snapperConfigDir = "/etc/snapper/configs/";
+static const QStringList snapperSysconfigFiles = {"/etc/conf.d/snapper", "/etc/sysconfig/snapper", "/etc/default/snapper"};
+
+QString snapperConfigPath(const QString &name) { return snapperConfigDir + name; }
+
+bool readSnapperConfigs(QMap<QString, QString> &configs) {
+    return readSnapperConfigs(
+        [](const QString &path) {
+            QFile file(path);
+            return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+        },
+        configs);
+}
+
+bool readSnapperConfigs(const std::function<QByteArray(const QString &)> &readFile, QMap<QString, QString> &configs) {
+    for (const QString &path : snapperSysconfigFiles) {
+        const QByteArray data = readFile(path);
+        if (data.isEmpty())
+            continue;
+        ShellConfig sysconfig;
+        sysconfig.parse(data);
+
+        QMap<QString, QString> subvolumes;
+        const QStringList names = sysconfig.value("SNAPPER_CONFIGS").simplified().split(' ');
+        for (const QString &name : names) {
+            if (name.isEmpty())
+                continue;
+
+            const QByteArray configData = readFile(snapperConfigPath(name));
+            if (configData.isEmpty())
+                return false;
+            ShellConfig config;
+            config.parse(configData);
+            subvolumes[name] = config.value("SUBVOLUME");
+        }
+
+        configs = subvolumes;
+        return true;
+    }
+
+    return false;
+}
@@ -0,0 +1,64 @@
+#ifndef SHELLCONFIG_H
+#define SHELLCONFIG_H
+
+#include <QByteArray>
+#include <QHash>
+#include <QMap>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+#include <functional>
+
+// A config file made of shell variable assignments, such as /etc/default/btrfsmaintenance and the snapper configs.
+//
+// The file is parsed once into a list of nodes which together hold every byte of it.  Comments, blank lines and anything
+// that isn't an assignment are kept verbatim and setting a value only replaces the characters of that value, so writing
+// the file back keeps the comments, quoting and order of the keys exactly as they were.  Values are not expanded, a
+// $VARIABLE is returned as it is written.
+class ShellConfig {
+  public:
+    // Reads and parses @p path.  Returns false if it can't be read
+    bool load(const QString &path);
+    void parse(const QByteArray &data);
+
+    // Writes the file atomically, the new contents are synced to disk before they replace @p path
+    bool save(const QString &path, QString &error) const;
+    QByteArray toByteArray() const;
+
+    bool contains(const QString &key) const { return index.contains(key); }
+    QStringList keys() const;
+    QString value(const QString &key, const QString &defaultValue = QString()) const;
+
+    // Changes the value of @p key in place keeping its quoting style, a key which isn't in the file yet is appended
+    void setValue(const QString &key, const QString &value);
+
+  private:
+    struct Node {
+        // The text of the node including the line break, for an assignment also any comment following it on the line
+        QByteArray text;
+        // Empty unless the node is an assignment
+        QString key;
+        int valueStart = 0;
+        int valueLength = 0;
+        QString value;
+    };
+
+    void addNode(const Node &node);
+
+    QVector<Node> nodes;
+    // The node of each key, when a key is assigned more than once the last assignment is the one the shell uses
+    QHash<QString, int> index;
+};
+
+// Returns the path of the snapper config @p name
+QString snapperConfigPath(const QString &name);
+
+// Reads the snapper config names and their subvolumes into @p configs from the config files, which is much faster than
+// running snapper.  Returns false if they can't be read
+bool readSnapperConfigs(QMap<QString, QString> &configs);
+
+// The same reading the files with @p readFile, which returns an empty array for a file that can't be read
+bool readSnapperConfigs(const std::function<QByteArray(const QString &)> &readFile, QMap<QString, QString> &configs);
+
+#endif // SHELLCONFIG_H
@@ -0,0 +1,154 @@
+#include "snapshotindex.h"
+#include "btrfs-assistant.h"
+
+#include <QDateTime>
+
+#include <algorithm>
+#include <limits>
+#include <numeric>
+
+// Splits @p text into lower case words, anything that isn't a letter or number separates words
+static QStringList tokenise(const QString &text) {
+    QStringList words;
+    QString word;
+    for (const QChar c : text) {
+        if (c.isLetterOrNumber()) {
+            word += c.toLower();
+        } else if (!word.isEmpty()) {
+            words.append(word);
+            word.clear();
+        }
+    }
+    if (!word.isEmpty())
+        words.append(word);
+
+    return words;
+}
+
+// Parses the date of a query filter.  Returns the first second of the day or minute given, or -1 if it isn't valid
+static qint64 parseQueryDate(const QString &text, bool endOfRange) {
+    QDateTime dateTime = QDateTime::fromString(text, "yyyy-MM-ddTHH:mm");
+    if (dateTime.isValid())
+        return dateTime.toSecsSinceEpoch() + (endOfRange ? 60 : 0);
+
+    const QDate date = QDate::fromString(text, Qt::ISODate);
+    if (!date.isValid())
+        return -1;
+
+    return QDateTime(endOfRange ? date.addDays(1) : date, QTime(0, 0)).toSecsSinceEpoch();
+}
+
+void SnapshotIndex::build(const QMap<QString, QVector<SnapperSnapshots>> &snapshots,
+                          const QMap<QString, QVector<SnapperSubvolume>> &subvolumes) {
+    entries.clear();
+    tokens.clear();
+    byDate.clear();
+    QHash<QString, int> tokenPositions;
+
+    // snapper list prints local time
+    for (auto it = snapshots.constBegin(); it != snapshots.constEnd(); ++it) {
+        for (const SnapperSnapshots &snap : it.value()) {
+            const qint64 epoch = QDateTime::fromString(snap.time, "yyyy-MM-dd HH:mm:ss").toSecsSinceEpoch();
+            addEntry({it.key(), QString::number(snap.number), snap.time, snap.desc, snap.type, snap.userdata, epoch, false}, snap.cleanup,
+                     tokenPositions);
+        }
+    }
+
+    // The restore mode entries come from info.xml which stores the date in UTC
+    for (auto it = subvolumes.constBegin(); it != subvolumes.constEnd(); ++it) {
+        for (const SnapperSubvolume &subvol : it.value()) {
+            QDateTime dateTime = QDateTime::fromString(subvol.time, "yyyy-MM-dd HH:mm:ss");
+            dateTime.setTimeSpec(Qt::UTC);
+            addEntry({it.key(), subvol.subvol, subvol.time, subvol.desc, subvol.type, subvol.userdata, dateTime.toSecsSinceEpoch(), true},
+                     QString(), tokenPositions);
+        }
+    }
+
+    std::sort(tokens.begin(), tokens.end(), [](const auto &a, const auto &b) { return a.first < b.first; });
+
+    byDate.resize(entries.size());
+    std::iota(byDate.begin(), byDate.end(), 0);
+    std::stable_sort(byDate.begin(), byDate.end(), [this](int a, int b) { return entries.at(a).epoch < entries.at(b).epoch; });
+}
+
+// Adds @p entry and its words to the index.  @p tokenPositions maps each word to its position in tokens
+void SnapshotIndex::addEntry(const SnapshotIndexEntry &entry, const QString &cleanup, QHash<QString, int> &tokenPositions) {
+    const int index = entries.size();
+    entries.append(entry);
+
+    const QStringList words = tokenise(entry.desc) + tokenise(entry.type) + tokenise(cleanup) + tokenise(entry.userdata) +
+                              tokenise(entry.config) + tokenise(entry.id);
+    for (const QString &word : words) {
+        auto position = tokenPositions.constFind(word);
+        if (position == tokenPositions.constEnd()) {
+            position = tokenPositions.insert(word, tokens.size());
+            tokens.append({word, {}});
+        }
+
+        // A word can occur more than once in a single entry
+        QVector<int> &postings = tokens[position.value()].second;
+        if (postings.isEmpty() || postings.last() != index)
+            postings.append(index);
+    }
+}
+
+QVector<int> SnapshotIndex::search(const QString &query, bool restore) const {
+    qint64 from = std::numeric_limits<qint64>::min();
+    qint64 to = std::numeric_limits<qint64>::max();
+    QStringList words;
+
+    const QStringList terms = query.split(' ');
+    for (const QString &term : terms) {
+        if (term.isEmpty())
+            continue;
+
+        const QString filter = term.section(':', 0, 0).toLower();
+        const QString value = term.section(':', 1);
+        if (filter == "after" || filter == "on") {
+            const qint64 date = parseQueryDate(value, false);
+            if (date >= 0)
+                from = qMax(from, date);
+        }
+        if (filter == "before" || filter == "on") {
+            const qint64 date = parseQueryDate(value, filter == "on");
+            if (date >= 0)
+                to = qMin(to, date);
+        }
+        if (filter != "after" && filter != "before" && filter != "on")
+            words += tokenise(term);
+    }
+
+    // Count the words each entry matches, an entry has to match all of them
+    QVector<int> matched;
+    if (!words.isEmpty())
+        matched.fill(0, entries.size());
+
+    for (int i = 0; i < words.size(); i++) {
+        const QString &word = words.at(i);
+        auto it = std::lower_bound(tokens.constBegin(), tokens.constEnd(), word, [](const auto &token, const QString &prefix) {
+            return token.first < prefix;
+        });
+        for (; it != tokens.constEnd() && it->first.startsWith(word); ++it) {
+            for (const int entry : it->second) {
+                // Several tokens can share the prefix, only count the entry once per word
+                if (matched.at(entry) == i)
+                    matched[entry]++;
+            }
+        }
+    }
+
+    // Walk the date range newest first
+    const auto first = std::lower_bound(byDate.constBegin(), byDate.constEnd(), from,
+                                        [this](int entry, qint64 epoch) { return entries.at(entry).epoch < epoch; });
+    const auto last = std::lower_bound(first, byDate.constEnd(), to,
+                                       [this](int entry, qint64 epoch) { return entries.at(entry).epoch < epoch; });
+
+    QVector<int> results;
+    for (auto it = last; it != first;) {
+        --it;
+        if (entries.at(*it).restore == restore && (words.isEmpty() || matched.at(*it) == words.size()))
+            results.append(*it);
+    }
+
+    return results;
+}
@@ -0,0 +1,52 @@
+#ifndef SNAPSHOTINDEX_H
+#define SNAPSHOTINDEX_H
+
+#include <QHash>
+#include <QMap>
+#include <QPair>
+#include <QString>
+#include <QVector>
+
+struct SnapperSnapshots;
+struct SnapperSubvolume;
+
+// A searchable snapshot.  In restore mode the id is the subvolume path, otherwise it is the snapper number
+struct SnapshotIndexEntry {
+    QString config;
+    QString id;
+    QString time;
+    QString desc;
+    QString type;
+    QString userdata;
+    qint64 epoch;
+    bool restore;
+};
+
+// An in-memory index over the snapshots of every snapper config.  Dates are parsed and descriptions tokenised once when
+// the index is built so a search is only lookups in sorted arrays, fast enough to run on every keystroke.
+//
+// A query is a list of words which must all match the start of a word in the description, type, cleanup algorithm,
+// userdata, config or number of a snapshot.  The words after:DATE, before:DATE and on:DATE limit the date range, DATE
+// is yyyy-MM-dd optionally followed by THH:mm
+class SnapshotIndex {
+  public:
+    void build(const QMap<QString, QVector<SnapperSnapshots>> &snapshots, const QMap<QString, QVector<SnapperSubvolume>> &subvolumes);
+
+    // Returns the indexes of the entries matching @p query newest first.  @p restore selects restore mode entries
+    QVector<int> search(const QString &query, bool restore) const;
+
+    const SnapshotIndexEntry &entry(int index) const { return entries.at(index); }
+
+  private:
+    void addEntry(const SnapshotIndexEntry &entry, const QString &cleanup, QHash<QString, int> &tokenPositions);
+
+    QVector<SnapshotIndexEntry> entries;
+
+    // Every distinct token with the entries containing it, sorted by token so a prefix is a contiguous range
+    QVector<QPair<QString, QVector<int>>> tokens;
+
+    // The entries sorted by date for range queries
+    QVector<int> byDate;
+};
+
+#endif // SNAPSHOTINDEX_H
@@ -0,0 +1,35 @@
+#include "snapshotrestore.h"
+
+#include <QDir>
+#include <QProcess>
+#include <QTime>
+
+RestoreStatus restoreSubvolume(const QString &mountpoint, const QString &target, const QString &snapshot, const QStringList &children,
+                               QString &backup) {
+    const auto path = [&mountpoint](const QString &subvolume) { return QDir::cleanPath(mountpoint + "/" + subvolume); };
+    QDir dir;
+
+    backup = "restore_backup_" + target + "_" + QTime::currentTime().toString("HHmmsszzz");
+    if (!dir.rename(path(target), path(backup)))
+        return RestoreStatus::BackupFailed;
+
+    // A snapshot stored inside the target moved along with it
+    const QString source = snapshot.startsWith(target + "/") ? backup + snapshot.mid(target.length()) : snapshot;
+
+    // Place a snapshot of the source where the target was
+    QProcess::execute("btrfs", {"subvolume", "snapshot", path(source), path(target)});
+    if (!dir.exists(path(target))) {
+        // That failed, try to put the old one back
+        dir.rename(path(backup), path(target));
+        return RestoreStatus::SnapshotFailed;
+    }
+
+    // Move the subvolumes which were nested in the target into the restored one
+    for (const QString &child : children) {
+        const QString childPath = child.startsWith(target + "/") ? child.mid(target.length() + 1) : child;
+        if (!dir.rename(path(backup + "/" + childPath), path(target + "/" + childPath)))
+            return RestoreStatus::ChildrenFailed;
+    }
+
+    return RestoreStatus::Restored;
+}
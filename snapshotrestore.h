@@ -0,0 +1,23 @@
+#ifndef SNAPSHOTRESTORE_H
+#define SNAPSHOTRESTORE_H
+
+#include <QString>
+#include <QStringList>
+
+enum class RestoreStatus {
+    Restored,
+    // The target couldn't be moved aside, nothing was changed
+    BackupFailed,
+    // The snapshot couldn't be created, the target was put back
+    SnapshotFailed,
+    // The target was restored but some of its nested subvolumes are still in the backup
+    ChildrenFailed,
+};
+
+// Replaces the subvolume @p target with a writable snapshot of @p snapshot.  Both are paths from the top level subvolume,
+// which is mounted at @p mountpoint.  The original target is renamed to a backup whose path is returned in @p backup and
+// the subvolumes @p children that were nested directly in it are moved into the restored subvolume.  Requires root
+RestoreStatus restoreSubvolume(const QString &mountpoint, const QString &target, const QString &snapshot, const QStringList &children,
+                               QString &backup);
+
+#endif // SNAPSHOTRESTORE_H
@@ -0,0 +1,141 @@
+#include "snapshottimeline.h"
+
+#include <QHash>
+
+#include <algorithm>
+
+// The internal id of a top level row is 0, the rows inside a pair have the row of their pair plus one
+static quintptr childId(int parentRow) { return static_cast<quintptr>(parentRow) + 1; }
+
+// Returns the row of the transaction @p index shows or belongs to
+static int transactionRow(const QModelIndex &index) {
+    return index.internalId() == 0 ? index.row() : static_cast<int>(index.internalId() - 1);
+}
+
+SnapshotTimelineModel::SnapshotTimelineModel(QObject *parent) : QAbstractItemModel(parent) {}
+
+void SnapshotTimelineModel::setSnapshots(const QVector<SnapperSnapshots> &newSnapshots) {
+    beginResetModel();
+    snapshots.clear();
+    transactions.clear();
+
+    // Snapshot 0 is the live subvolume, not a snapshot
+    for (const SnapperSnapshots &snapshot : newSnapshots) {
+        if (snapshot.number != 0)
+            snapshots.append(snapshot);
+    }
+    std::sort(snapshots.begin(), snapshots.end(),
+              [](const SnapperSnapshots &a, const SnapperSnapshots &b) { return a.number < b.number; });
+
+    // A post snapshot is always newer than its pre snapshot, so the pre is already a transaction when the post is reached.
+    // A post whose pre was deleted stays on its own
+    QHash<int, int> preTransactions;
+    for (int i = 0; i < snapshots.size(); i++) {
+        const SnapperSnapshots &snapshot = snapshots.at(i);
+        if (snapshot.type == "post" && preTransactions.contains(snapshot.preNumber)) {
+            transactions[preTransactions.take(snapshot.preNumber)].second = i;
+            continue;
+        }
+
+        if (snapshot.type == "pre")
+            preTransactions.insert(snapshot.number, transactions.size());
+        transactions.append({i, -1});
+    }
+    std::reverse(transactions.begin(), transactions.end());
+
+    endResetModel();
+}
+
+SnapshotTransaction SnapshotTimelineModel::transaction(const QModelIndex &index) const {
+    if (!index.isValid())
+        return {};
+
+    return transactions.at(transactionRow(index));
+}
+
+QModelIndex SnapshotTimelineModel::index(int row, int column, const QModelIndex &parent) const {
+    if (!hasIndex(row, column, parent))
+        return QModelIndex();
+
+    return createIndex(row, column, parent.isValid() ? childId(parent.row()) : 0);
+}
+
+QModelIndex SnapshotTimelineModel::parent(const QModelIndex &index) const {
+    if (!index.isValid() || index.internalId() == 0)
+        return QModelIndex();
+
+    return createIndex(transactionRow(index), 0, quintptr(0));
+}
+
+int SnapshotTimelineModel::rowCount(const QModelIndex &parent) const {
+    if (!parent.isValid())
+        return transactions.size();
+
+    // Only a pair has children and they don't have any themselves
+    if (parent.internalId() != 0 || parent.column() != 0)
+        return 0;
+    return transactions.at(parent.row()).second == -1 ? 0 : 2;
+}
+
+int SnapshotTimelineModel::columnCount(const QModelIndex &) const { return ColumnCount; }
+
+QVariant SnapshotTimelineModel::data(const QModelIndex &index, int role) const {
+    if (!index.isValid() || role != Qt::DisplayRole)
+        return QVariant();
+
+    const SnapshotTransaction &pair = transactions.at(transactionRow(index));
+
+    // A row inside a pair or a snapshot on its own shows the snapshot as snapper list does
+    if (index.internalId() != 0 || pair.second == -1) {
+        const SnapperSnapshots &snap = snapshots.at(index.internalId() != 0 && index.row() == 1 ? pair.second : pair.first);
+        switch (index.column()) {
+        case NumberColumn:
+            return snap.number;
+        case DateColumn:
+            return snap.time;
+        case TypeColumn:
+            return snap.type;
+        case CleanupColumn:
+            return snap.cleanup;
+        case DescriptionColumn:
+            return snap.desc;
+        }
+        return QVariant();
+    }
+
+    // A pair shows the span of the transaction, the pacman hook puts the command in the description of the pre snapshot
+    const SnapperSnapshots &pre = snapshots.at(pair.first);
+    const SnapperSnapshots &post = snapshots.at(pair.second);
+    switch (index.column()) {
+    case NumberColumn:
+        return QString::number(pre.number) + " - " + QString::number(post.number);
+    case DateColumn:
+        return pre.time;
+    case TypeColumn:
+        return tr("pre/post");
+    case CleanupColumn:
+        return pre.cleanup;
+    case DescriptionColumn:
+        return pre.desc.isEmpty() ? post.desc : pre.desc;
+    }
+    return QVariant();
+}
+
+QVariant SnapshotTimelineModel::headerData(int section, Qt::Orientation orientation, int role) const {
+    if (orientation != Qt::Horizontal || role != Qt::DisplayRole)
+        return QVariant();
+
+    switch (section) {
+    case NumberColumn:
+        return tr("Number", "The number associated with a snapshot");
+    case DateColumn:
+        return tr("Date/Time");
+    case TypeColumn:
+        return tr("Type");
+    case CleanupColumn:
+        return tr("Cleanup");
+    case DescriptionColumn:
+        return tr("Description");
+    }
+    return QVariant();
+}
@@ -0,0 +1,48 @@
+#ifndef SNAPSHOTTIMELINE_H
+#define SNAPSHOTTIMELINE_H
+
+#include "outputparsers.h"
+
+#include <QAbstractItemModel>
+#include <QVector>
+
+// A snapper transaction, either a pre snapshot with the post snapshot that pairs with it or a snapshot on its own.  The
+// indexes are into the snapshots of the model, second is -1 for a snapshot on its own
+struct SnapshotTransaction {
+    int first = -1;
+    int second = -1;
+};
+
+// The snapshots of a snapper config grouped into transactions, newest first, for a tree view.
+//
+// A pre/post pair is a top level row that expands into its two snapshots, any other snapshot is a top level row without
+// children.  Nothing is formatted until the view asks for a cell, so with uniform row heights the view only ever touches
+// the visible rows however many thousands of transactions there are
+class SnapshotTimelineModel : public QAbstractItemModel {
+    Q_OBJECT
+
+  public:
+    enum Column { NumberColumn, DateColumn, TypeColumn, CleanupColumn, DescriptionColumn, ColumnCount };
+
+    explicit SnapshotTimelineModel(QObject *parent = nullptr);
+
+    void setSnapshots(const QVector<SnapperSnapshots> &snapshots);
+
+    // Returns the transaction of the row at @p index, or of the pair it belongs to for a snapshot inside a pair
+    SnapshotTransaction transaction(const QModelIndex &index) const;
+
+    const SnapperSnapshots &snapshot(int index) const { return snapshots.at(index); }
+
+    QModelIndex index(int row, int column, const QModelIndex &parent = QModelIndex()) const override;
+    QModelIndex parent(const QModelIndex &index) const override;
+    int rowCount(const QModelIndex &parent = QModelIndex()) const override;
+    int columnCount(const QModelIndex &parent = QModelIndex()) const override;
+    QVariant data(const QModelIndex &index, int role = Qt::DisplayRole) const override;
+    QVariant headerData(int section, Qt::Orientation orientation, int role = Qt::DisplayRole) const override;
+
+  private:
+    QVector<SnapperSnapshots> snapshots;
+    QVector<SnapshotTransaction> transactions;
+};
+
+#endif // SNAPSHOTTIMELINE_H
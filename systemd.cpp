@@ -0,0 +1,110 @@
+#include "systemd.h"
+
+#include <QDBusConnection>
+#include <QDBusMessage>
+#include <QDBusPendingCallWatcher>
+#include <QDBusPendingReply>
+
+#include <climits>
+#include <memory>
+
+static const QString systemdService = "org.freedesktop.systemd1";
+static const QString systemdPath = "/org/freedesktop/systemd1";
+static const QString systemdManager = "org.freedesktop.systemd1.Manager";
+
+SystemdUnits::SystemdUnits(QObject *parent) : QObject(parent) {
+    // systemd only emits manager signals to clients which have subscribed
+    callManager("Subscribe");
+    QDBusConnection::systemBus().connect(systemdService, systemdPath, systemdManager, "UnitFilesChanged", this, SLOT(refresh()));
+}
+
+// Sends an asynchronous method call to the systemd manager.  A plain message is used instead of QDBusInterface to avoid
+// the blocking introspection call QDBusInterface makes on construction.  Run unprivileged, changing units needs polkit to
+// ask for a password, so the calls are allowed to wait for it without a timeout
+QDBusPendingCall SystemdUnits::callManager(const QString &method, const QVariantList &args) {
+    QDBusMessage message = QDBusMessage::createMethodCall(systemdService, systemdPath, systemdManager, method);
+    message.setArguments(args);
+    message.setInteractiveAuthorizationAllowed(true);
+    return QDBusConnection::systemBus().asyncCall(message, INT_MAX);
+}
+
+void SystemdUnits::setUnits(const QStringList &unitList) {
+    units = unitList;
+    unitStates.clear();
+    refresh();
+}
+
+// Re-queries the state of every tracked unit, called whenever systemd reports that unit files changed
+void SystemdUnits::refresh() {
+    for (const QString &unit : qAsConst(units))
+        queryUnit(unit);
+}
+
+void SystemdUnits::queryUnit(const QString &unit) {
+    auto *watcher = new QDBusPendingCallWatcher(callManager("GetUnitFileState", {unit}), this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, unit](QDBusPendingCallWatcher *call) {
+        call->deleteLater();
+
+        // The unit may have been dropped while the call was in flight
+        if (!units.contains(unit))
+            return;
+
+        // Units which aren't installed return an error, treat them as disabled
+        const QDBusPendingReply<QString> reply = *call;
+        const QString state = reply.isError() ? QString() : reply.value();
+        if (unitStates.contains(unit) && unitStates.value(unit) == state)
+            return;
+
+        unitStates[unit] = state;
+        emit unitStateChanged(unit, isEnabled(unit));
+    });
+}
+
+// Counts @p call towards the current apply and runs @p next if it succeeds
+void SystemdUnits::trackCall(const QDBusPendingCall &call, const std::function<void()> &next) {
+    pendingCalls++;
+    auto *watcher = new QDBusPendingCallWatcher(call, this);
+    connect(watcher, &QDBusPendingCallWatcher::finished, this, [this, next](QDBusPendingCallWatcher *reply) {
+        reply->deleteLater();
+
+        if (reply->isError())
+            applyErrors.append(reply->error().message());
+        else if (next)
+            next();
+
+        if (--pendingCalls == 0) {
+            emit applyFinished(applyErrors);
+            refresh();
+        }
+    });
+}
+
+void SystemdUnits::apply(const QStringList &enable, const QStringList &disable) {
+    applyErrors.clear();
+
+    if (enable.isEmpty() && disable.isEmpty()) {
+        QMetaObject::invokeMethod(
+            this, [this] { emit applyFinished(applyErrors); }, Qt::QueuedConnection);
+        return;
+    }
+
+    // The daemon is reloaded once every unit file change has succeeded, and once it has picked up the new unit files the
+    // start and stop jobs are queued all at once.  A failed change leaves the running units as they are
+    auto remaining = std::make_shared<int>(int(!enable.isEmpty()) + int(!disable.isEmpty()));
+    const auto reload = [this, enable, disable, remaining] {
+        if (--*remaining > 0)
+            return;
+
+        trackCall(callManager("Reload"), [this, enable, disable] {
+            for (const QString &unit : enable)
+                trackCall(callManager("StartUnit", {unit, QStringLiteral("replace")}));
+            for (const QString &unit : disable)
+                trackCall(callManager("StopUnit", {unit, QStringLiteral("replace")}));
+        });
+    };
+
+    if (!enable.isEmpty())
+        trackCall(callManager("EnableUnitFiles", {enable, false, false}), reload);
+    if (!disable.isEmpty())
+        trackCall(callManager("DisableUnitFiles", {disable, false}), reload);
+}
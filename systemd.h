@@ -0,0 +1,51 @@
+#ifndef SYSTEMD_H
+#define SYSTEMD_H
+
+#include <QDBusPendingCall>
+#include <QHash>
+#include <QObject>
+#include <QStringList>
+
+#include <functional>
+
+// Tracks and changes the enabled state of a fixed set of systemd units through the systemd1 D-Bus API.
+// All calls are asynchronous so the UI is never blocked waiting on systemd.
+class SystemdUnits : public QObject {
+    Q_OBJECT
+
+  public:
+    explicit SystemdUnits(QObject *parent = nullptr);
+
+    // Replaces the set of tracked units and queries their state.  unitStateChanged() is emitted as the replies arrive
+    void setUnits(const QStringList &unitList);
+
+    // Returns true if the state of the tracked unit @p unit has arrived
+    bool hasState(const QString &unit) const { return unitStates.contains(unit); }
+
+    // Returns true if @p unit is a tracked unit whose unit file is enabled
+    bool isEnabled(const QString &unit) const { return unitStates.value(unit) == "enabled"; }
+
+    // Enables and starts @p enable and disables and stops @p disable.  The unit file changes are issued as one call
+    // each, the daemon is only reloaded and the start/stop jobs only queued, in parallel, once both have succeeded.
+    // applyFinished() is emitted once every call has replied
+    void apply(const QStringList &enable, const QStringList &disable);
+
+  signals:
+    void unitStateChanged(const QString &unit, bool enabled);
+    void applyFinished(const QStringList &errors);
+
+  private slots:
+    void refresh();
+
+  private:
+    QDBusPendingCall callManager(const QString &method, const QVariantList &args = QVariantList());
+    void queryUnit(const QString &unit);
+    void trackCall(const QDBusPendingCall &call, const std::function<void()> &next = nullptr);
+
+    QStringList units;
+    QHash<QString, QString> unitStates;
+    QStringList applyErrors;
+    int pendingCalls = 0;
+};
+
+#endif // SYSTEMD_H
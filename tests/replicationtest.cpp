@@ -0,0 +1,190 @@
+#include "btrfsioctl.h"
+#include "replication.h"
+
+#include <QDir>
+#include <QFile>
+#include <QProcess>
+#include <QRandomGenerator>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QtTest>
+
+#include <csignal>
+#include <unistd.h>
+
+/*
+ *
+ * Tests of the send/receive replication between two btrfs filesystems on loopback images.
+ *
+ * The source is laid out like a snapper config, numbered directories holding a read-only snapshot and its info.xml.  The
+ * target is made too small for the last snapshot so the cleanup of a failed receive is covered too.  It needs root, the
+ * btrfs tools and loop devices and is skipped without them.
+ *
+ */
+
+// Big enough for mkfs.btrfs, the target only has room for the small snapshots
+static const qint64 sourceImageSize = 512 * 1024 * 1024;
+static const qint64 targetImageSize = 160 * 1024 * 1024;
+
+// Runs @p program with @p args and returns true if it succeeded
+static bool run(const QString &program, const QStringList &args) {
+    QProcess process;
+    process.setProcessChannelMode(QProcess::ForwardedChannels);
+    process.start(program, args);
+    return process.waitForFinished(-1) && process.exitStatus() == QProcess::NormalExit && process.exitCode() == 0;
+}
+
+// Writes @p size random bytes to @p path, random so compression can't make them fit
+static bool writeRandomFile(const QString &path, qint64 size) {
+    QFile file(path);
+    if (!file.open(QIODevice::WriteOnly))
+        return false;
+
+    QByteArray block(1024 * 1024, Qt::Uninitialized);
+    for (qint64 written = 0; written < size; written += block.size()) {
+        QRandomGenerator::global()->fillRange(reinterpret_cast<quint32 *>(block.data()), block.size() / sizeof(quint32));
+        if (file.write(block.constData(), qMin<qint64>(block.size(), size - written)) < 0)
+            return false;
+    }
+
+    return file.flush() && fsync(file.handle()) == 0;
+}
+
+static QByteArray readFile(const QString &path) {
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+class ReplicationTest : public QObject {
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();
+    void cleanupTestCase();
+    void fullThenIncremental();
+    void skipsReceived();
+    void removesPartialReceive();
+
+  private:
+    // Creates the image @p name of @p size bytes, formats it and mounts it.  Returns the mountpoint
+    QString mountImage(const QString &name, qint64 size);
+    // Takes snapshot @p number of the live subvolume into the snapshot directory
+    void takeSnapshot(int number);
+
+    QTemporaryDir dir;
+    QStringList mountpoints;
+    QString live;
+    QString snapshotDir;
+    QString target;
+};
+
+QString ReplicationTest::mountImage(const QString &name, qint64 size) {
+    const QString image = dir.filePath(name + ".img");
+    const QString mountpoint = dir.filePath(name);
+    QFile file(image);
+    if (!file.open(QIODevice::WriteOnly) || !file.resize(size))
+        return QString();
+    file.close();
+
+    if (!QDir().mkpath(mountpoint) || !run("mkfs.btrfs", {"-q", "-f", image}) || !run("mount", {"-o", "loop", image, mountpoint}))
+        return QString();
+
+    mountpoints.append(mountpoint);
+    return mountpoint;
+}
+
+void ReplicationTest::takeSnapshot(int number) {
+    const QString numberDir = snapshotDir + "/" + QString::number(number);
+    QVERIFY(QDir().mkpath(numberDir));
+    QVERIFY(createSnapshot(live, numberDir + "/snapshot", true));
+
+    QFile info(numberDir + "/info.xml");
+    QVERIFY(info.open(QIODevice::WriteOnly));
+    info.write(QString("<?xml version=\"1.0\"?>\n<snapshot>\n  <type>single</type>\n  <num>%1</num>\n</snapshot>\n").arg(number).toUtf8());
+}
+
+void ReplicationTest::initTestCase() {
+    if (geteuid() != 0)
+        QSKIP("Needs root to set up the loop devices");
+    if (QStandardPaths::findExecutable("mkfs.btrfs").isEmpty() || QStandardPaths::findExecutable("btrfs").isEmpty())
+        QSKIP("Needs the btrfs tools");
+
+    // A receive that exits early has to fail the send instead of killing the test, as in the application
+    signal(SIGPIPE, SIG_IGN);
+
+    QVERIFY(dir.isValid());
+    const QString source = mountImage("source", sourceImageSize);
+    const QString targetMount = mountImage("target", targetImageSize);
+    if (source.isEmpty() || targetMount.isEmpty())
+        QSKIP("Failed to mount the loopback images");
+
+    live = source + "/live";
+    snapshotDir = source + "/.snapshots";
+    target = targetMount + "/replica";
+    QVERIFY(run("btrfs", {"-q", "subvolume", "create", live}));
+    QVERIFY(QDir().mkpath(snapshotDir));
+    QVERIFY(QDir().mkpath(target));
+
+    // Snapshot 2 only adds a file to snapshot 1, snapshot 3 doesn't fit on the target
+    QVERIFY(writeRandomFile(live + "/first", 4 * 1024 * 1024));
+    takeSnapshot(1);
+    QVERIFY(writeRandomFile(live + "/second", 1024 * 1024));
+    takeSnapshot(2);
+    QVERIFY(writeRandomFile(live + "/third", 256 * 1024 * 1024));
+    takeSnapshot(3);
+}
+
+void ReplicationTest::cleanupTestCase() {
+    for (const QString &mountpoint : qAsConst(mountpoints))
+        run("umount", {mountpoint});
+}
+
+void ReplicationTest::fullThenIncremental() {
+    SnapshotReplicator replicator;
+    const ReplicationResult result = replicator.replicate(snapshotDir, {2, 1}, target);
+    QVERIFY2(result.errors.isEmpty(), qPrintable(result.errors.join('\n')));
+    QCOMPARE(result.sent, 2);
+    QCOMPARE(result.incremental, 1);
+    QVERIFY(result.bytes > 0);
+
+    // The copies are read-only snapshots received from the originals, with their info.xml next to them
+    for (const int number : {1, 2}) {
+        const QString copy = target + "/" + QString::number(number);
+        BtrfsSubvolInfo original;
+        BtrfsSubvolInfo received;
+        QVERIFY(readSubvolInfo(snapshotDir + "/" + QString::number(number) + "/snapshot", original));
+        QVERIFY(readSubvolInfo(copy + "/snapshot", received));
+        QVERIFY(received.readOnly);
+        QCOMPARE(received.receivedUuid, original.uuid);
+        QCOMPARE(readFile(copy + "/info.xml"), readFile(snapshotDir + "/" + QString::number(number) + "/info.xml"));
+    }
+
+    QCOMPARE(readFile(target + "/2/snapshot/first"), readFile(snapshotDir + "/2/snapshot/first"));
+    QCOMPARE(readFile(target + "/2/snapshot/second"), readFile(snapshotDir + "/2/snapshot/second"));
+    QVERIFY(!QFile::exists(target + "/1/snapshot/second"));
+}
+
+void ReplicationTest::skipsReceived() {
+    SnapshotReplicator replicator;
+    const ReplicationResult result = replicator.replicate(snapshotDir, {1, 2}, target);
+    QVERIFY(result.errors.isEmpty());
+    QCOMPARE(result.sent, 0);
+    QCOMPARE(result.skipped, 2);
+}
+
+void ReplicationTest::removesPartialReceive() {
+    // The target runs out of space half way through, nothing of the snapshot may be left behind
+    SnapshotReplicator replicator;
+    ReplicationResult result = replicator.replicate(snapshotDir, {3}, target);
+    QCOMPARE(result.sent, 0);
+    QCOMPARE(result.errors.size(), 1);
+    QVERIFY2(!QFileInfo::exists(target + "/3"), qPrintable(result.errors.join('\n')));
+
+    // So another attempt fails the same way instead of finding a different snapshot with the number
+    result = replicator.replicate(snapshotDir, {3}, target);
+    QCOMPARE(result.errors.size(), 1);
+    QVERIFY(!result.errors.at(0).contains("already on the target"));
+}
+
+QTEST_GUILESS_MAIN(ReplicationTest)
+#include "replicationtest.moc"
@@ -0,0 +1,142 @@
+#include "shellconfig.h"
+
+#include <QFile>
+#include <QTemporaryDir>
+#include <QtTest>
+
+/*
+ *
+ * Tests of the ShellConfig round trip through a file.
+ *
+ * The btrfsmaintenance and snapper configs are edited in place, so loading and saving a file has to give back every byte
+ * that wasn't changed: the comments, the quoting of each value and the keys the application knows nothing about.
+ *
+ */
+
+// Shaped like /etc/default/btrfsmaintenance with the cases the parser has to keep as they are
+static const QByteArray sampleConfig = "# btrfsmaintenance settings\n"
+                                       "export BTRFS_LOG_OUTPUT=\"stdout\"\n"
+                                       "\n"
+                                       "## Path:           System/File systems/btrfs\n"
+                                       "BTRFS_BALANCE_PERIOD=\"weekly\"  # how often\n"
+                                       "BTRFS_SCRUB_PERIOD='monthly'\n"
+                                       "BTRFS_DEFRAG_PATHS=auto\n"
+                                       "UNKNOWN_KEY=\"$HOME/foo\"\n"
+                                       "BTRFS_BALANCE_DUSAGE=\"5 10\n"
+                                       "20\"\n"
+                                       "not an assignment\n";
+
+static QByteArray readFile(const QString &path) {
+    QFile file(path);
+    return file.open(QIODevice::ReadOnly) ? file.readAll() : QByteArray();
+}
+
+static bool writeFile(const QString &path, const QByteArray &data) {
+    QFile file(path);
+    return file.open(QIODevice::WriteOnly) && file.write(data) == data.size();
+}
+
+class ShellConfigTest : public QObject {
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();
+    void unchangedRoundTrip();
+    void changedRoundTrip();
+    void appendsMissingKey();
+    void lastAssignmentWins();
+    void loadMissingFile();
+
+  private:
+    QTemporaryDir dir;
+};
+
+void ShellConfigTest::initTestCase() { QVERIFY(dir.isValid()); }
+
+void ShellConfigTest::unchangedRoundTrip() {
+    const QString path = dir.filePath("unchanged");
+    QVERIFY(writeFile(path, sampleConfig));
+
+    ShellConfig config;
+    QVERIFY(config.load(path));
+    QCOMPARE(config.value("BTRFS_LOG_OUTPUT"), QString("stdout"));
+    QCOMPARE(config.value("BTRFS_BALANCE_PERIOD"), QString("weekly"));
+    QCOMPARE(config.value("BTRFS_SCRUB_PERIOD"), QString("monthly"));
+    QCOMPARE(config.value("BTRFS_DEFRAG_PATHS"), QString("auto"));
+    QCOMPARE(config.value("UNKNOWN_KEY"), QString("$HOME/foo"));
+    QCOMPARE(config.value("BTRFS_BALANCE_DUSAGE"), QString("5 10\n20"));
+    QCOMPARE(config.keys(), QStringList({"BTRFS_LOG_OUTPUT", "BTRFS_BALANCE_PERIOD", "BTRFS_SCRUB_PERIOD", "BTRFS_DEFRAG_PATHS",
+                                         "UNKNOWN_KEY", "BTRFS_BALANCE_DUSAGE"}));
+
+    // Setting a key to the value it already has doesn't touch the file either
+    config.setValue("UNKNOWN_KEY", "$HOME/foo");
+    QString error;
+    QVERIFY2(config.save(path, error), qPrintable(error));
+    QCOMPARE(readFile(path), sampleConfig);
+}
+
+void ShellConfigTest::changedRoundTrip() {
+    const QString path = dir.filePath("changed");
+    QVERIFY(writeFile(path, sampleConfig));
+
+    ShellConfig config;
+    QVERIFY(config.load(path));
+    config.setValue("BTRFS_BALANCE_PERIOD", "monthly");
+    config.setValue("BTRFS_SCRUB_PERIOD", "weekly");
+    config.setValue("BTRFS_DEFRAG_PATHS", "/ /home");
+    QString error;
+    QVERIFY2(config.save(path, error), qPrintable(error));
+
+    // Only the values change, each keeping its quoting unless the new value needs quotes
+    QByteArray expected = sampleConfig;
+    expected.replace("BTRFS_BALANCE_PERIOD=\"weekly\"", "BTRFS_BALANCE_PERIOD=\"monthly\"");
+    expected.replace("BTRFS_SCRUB_PERIOD='monthly'", "BTRFS_SCRUB_PERIOD='weekly'");
+    expected.replace("BTRFS_DEFRAG_PATHS=auto", "BTRFS_DEFRAG_PATHS=\"/ /home\"");
+    QCOMPARE(readFile(path), expected);
+
+    ShellConfig reloaded;
+    QVERIFY(reloaded.load(path));
+    QCOMPARE(reloaded.value("BTRFS_BALANCE_PERIOD"), QString("monthly"));
+    QCOMPARE(reloaded.value("BTRFS_SCRUB_PERIOD"), QString("weekly"));
+    QCOMPARE(reloaded.value("BTRFS_DEFRAG_PATHS"), QString("/ /home"));
+    QCOMPARE(reloaded.value("UNKNOWN_KEY"), QString("$HOME/foo"));
+    QCOMPARE(reloaded.toByteArray(), expected);
+}
+
+void ShellConfigTest::appendsMissingKey() {
+    // The last line has no line break, the new key must still go on a line of its own
+    const QString path = dir.filePath("append");
+    QVERIFY(writeFile(path, "# comment\nBTRFS_SCRUB_PERIOD=none"));
+
+    ShellConfig config;
+    QVERIFY(config.load(path));
+    config.setValue("BTRFS_SCRUB_MOUNTPOINTS", "/ \"quoted\"");
+    QString error;
+    QVERIFY2(config.save(path, error), qPrintable(error));
+    QCOMPARE(readFile(path), QByteArray("# comment\nBTRFS_SCRUB_PERIOD=none\nBTRFS_SCRUB_MOUNTPOINTS=\"/ \\\"quoted\\\"\"\n"));
+
+    ShellConfig reloaded;
+    QVERIFY(reloaded.load(path));
+    QCOMPARE(reloaded.value("BTRFS_SCRUB_PERIOD"), QString("none"));
+    QCOMPARE(reloaded.value("BTRFS_SCRUB_MOUNTPOINTS"), QString("/ \"quoted\""));
+}
+
+void ShellConfigTest::lastAssignmentWins() {
+    // As in the shell the last assignment is the value, and the one that is changed
+    ShellConfig config;
+    config.parse("KEY=1\nKEY=2\n");
+    QCOMPARE(config.value("KEY"), QString("2"));
+    QCOMPARE(config.keys(), QStringList({"KEY"}));
+
+    config.setValue("KEY", "3");
+    QCOMPARE(config.toByteArray(), QByteArray("KEY=1\nKEY=3\n"));
+}
+
+void ShellConfigTest::loadMissingFile() {
+    ShellConfig config;
+    QVERIFY(!config.load(dir.filePath("missing")));
+    QVERIFY(config.keys().isEmpty());
+}
+
+QTEST_GUILESS_MAIN(ShellConfigTest)
+#include "shellconfigtest.moc"
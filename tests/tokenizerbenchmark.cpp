@@ -0,0 +1,232 @@
+#include "tokenizer.h"
+
+#include <QFile>
+#include <QMap>
+#include <QRegExp>
+#include <QtTest>
+
+/*
+ *
+ * Benchmarks of the tokenizer against the QStringList split chains it replaced.
+ *
+ * Each pair of functions parses the same captured output the old way and the new way.  They keep the logic of the
+ * old loops so only the splitting differs, and the results of both are compared before anything is timed.
+ *
+ */
+
+struct UsageTotals {
+    long totalSize = 0;
+    long allocatedSize = 0;
+    long usedSize = 0;
+    long freeSize = 0;
+    long dataSize = 0;
+    long metaSize = 0;
+    long sysSize = 0;
+};
+
+struct SnapshotRow {
+    int number;
+    QString time;
+    QString cleanup;
+
+    bool operator==(const SnapshotRow &other) const { return number == other.number && time == other.time && cleanup == other.cleanup; }
+};
+
+static QByteArray readCapture(const QString &name) {
+    QFile file(QFINDTESTDATA("data/" + name));
+    if (!file.open(QIODevice::ReadOnly))
+        return QByteArray();
+
+    return file.readAll();
+}
+
+// The process output used to be trimmed into a QString before it was split, that conversion is part of the old cost
+static UsageTotals usageSplit(const QByteArray &output) {
+    UsageTotals usage;
+    const QStringList lines = QString::fromUtf8(output).trimmed().split('\n');
+    for (const QString &line : lines) {
+        const QString type = line.split(':').at(0).trimmed();
+        if (type == "Device size") {
+            usage.totalSize = line.split(':').at(1).trimmed().toLong();
+        } else if (type == "Device allocated") {
+            usage.allocatedSize = line.split(':').at(1).trimmed().toLong();
+        } else if (type == "Used") {
+            usage.usedSize = line.split(':').at(1).trimmed().toLong();
+        } else if (type == "Free (estimated)") {
+            usage.freeSize = line.split(':').at(1).split(QRegExp("\\s+"), Qt::SkipEmptyParts).at(0).trimmed().toLong();
+        } else if (type.startsWith("Data,")) {
+            usage.dataSize = line.split(':').at(2).split(',').at(0).trimmed().toLong();
+        } else if (type.startsWith("Metadata,")) {
+            usage.metaSize = line.split(':').at(2).split(',').at(0).trimmed().toLong();
+        } else if (type.startsWith("System,")) {
+            usage.sysSize = line.split(':').at(2).split(',').at(0).trimmed().toLong();
+        }
+    }
+
+    return usage;
+}
+
+static UsageTotals usageTokenizer(const QByteArray &output) {
+    UsageTotals usage;
+    LineTokenizer lines(output);
+    std::string_view line;
+    while (lines.next(line)) {
+        const std::string_view type = trimmed(field(line, ':', 0));
+        if (type == "Device size") {
+            usage.totalSize = toLong(field(line, ':', 1));
+        } else if (type == "Device allocated") {
+            usage.allocatedSize = toLong(field(line, ':', 1));
+        } else if (type == "Used") {
+            usage.usedSize = toLong(field(line, ':', 1));
+        } else if (type == "Free (estimated)") {
+            usage.freeSize = toLong(word(field(line, ':', 1), 0));
+        } else if (type.starts_with("Data,")) {
+            usage.dataSize = toLong(field(field(line, ':', 2), ',', 0));
+        } else if (type.starts_with("Metadata,")) {
+            usage.metaSize = toLong(field(field(line, ':', 2), ',', 0));
+        } else if (type.starts_with("System,")) {
+            usage.sysSize = toLong(field(field(line, ':', 2), ',', 0));
+        }
+    }
+
+    return usage;
+}
+
+static QMap<QString, QString> subvolumesSplit(const QByteArray &output) {
+    QMap<QString, QString> subvolumes;
+    const QStringList lines = QString::fromUtf8(output).trimmed().split('\n');
+    for (const QString &line : lines) {
+        if (!line.isEmpty())
+            subvolumes[line.split(' ').at(1)] = line.split(' ').at(8);
+    }
+
+    return subvolumes;
+}
+
+// The old split dropped everything after the first space of a path, wordsFrom() keeps it
+static QMap<QString, QString> subvolumesTokenizer(const QByteArray &output) {
+    QMap<QString, QString> subvolumes;
+    LineTokenizer lines(output);
+    std::string_view line;
+    while (lines.next(line)) {
+        if (!line.empty())
+            subvolumes[toQString(word(line, 1))] = toQString(wordsFrom(line, 8));
+    }
+
+    return subvolumes;
+}
+
+// The old command piped the list through tail -n +4 instead of skipping the header lines itself
+static QVector<SnapshotRow> snapshotsSplit(const QByteArray &output) {
+    QVector<SnapshotRow> snapshots;
+    QStringList lines = QString::fromUtf8(output).trimmed().split('\n');
+    lines.erase(lines.begin(), lines.begin() + 3);
+    for (const QString &snap : qAsConst(lines))
+        snapshots.append({snap.split('|').at(0).trimmed().toInt(), snap.split('|').at(1).trimmed(), snap.split('|').at(2).trimmed()});
+
+    return snapshots;
+}
+
+static QVector<SnapshotRow> snapshotsTokenizer(const QByteArray &output) {
+    QVector<SnapshotRow> snapshots;
+    LineTokenizer lines(output);
+    lines.skip(3);
+    std::string_view snap;
+    while (lines.next(snap)) {
+        if (trimmed(snap).empty())
+            continue;
+        snapshots.append({static_cast<int>(toLong(field(snap, '|', 0))), toQString(trimmed(field(snap, '|', 1))),
+                          toQString(trimmed(field(snap, '|', 2)))});
+    }
+
+    return snapshots;
+}
+
+class TokenizerBenchmark : public QObject {
+    Q_OBJECT
+
+  private slots:
+    void initTestCase();
+
+    void filesystemUsageSplit();
+    void filesystemUsageTokenizer();
+    void subvolumeListSplit();
+    void subvolumeListTokenizer();
+    void snapperListSplit();
+    void snapperListTokenizer();
+
+  private:
+    QByteArray usage;
+    QByteArray subvolumes;
+    QByteArray snapshots;
+};
+
+// Both ways have to agree before their timings mean anything
+void TokenizerBenchmark::initTestCase() {
+    usage = readCapture("fi-usage-converting.txt");
+    subvolumes = readCapture("subvolume-list-50k.txt");
+    snapshots = readCapture("snapper-list-10k.txt");
+    QVERIFY(!usage.isEmpty());
+    QVERIFY(!subvolumes.isEmpty());
+    QVERIFY(!snapshots.isEmpty());
+
+    const UsageTotals oldUsage = usageSplit(usage);
+    const UsageTotals newUsage = usageTokenizer(usage);
+    QCOMPARE(newUsage.totalSize, oldUsage.totalSize);
+    QCOMPARE(newUsage.allocatedSize, oldUsage.allocatedSize);
+    QCOMPARE(newUsage.usedSize, oldUsage.usedSize);
+    QCOMPARE(newUsage.freeSize, oldUsage.freeSize);
+    QCOMPARE(newUsage.dataSize, oldUsage.dataSize);
+    QCOMPARE(newUsage.metaSize, oldUsage.metaSize);
+    QCOMPARE(newUsage.sysSize, oldUsage.sysSize);
+
+    // Only the path with a space in it differs
+    QMap<QString, QString> oldSubvolumes = subvolumesSplit(subvolumes);
+    QMap<QString, QString> newSubvolumes = subvolumesTokenizer(subvolumes);
+    QCOMPARE(newSubvolumes.size(), 50000);
+    QCOMPARE(oldSubvolumes.take("261"), QString("@data/Virtual"));
+    QCOMPARE(newSubvolumes.take("261"), QString("@data/Virtual Machines"));
+    QCOMPARE(newSubvolumes, oldSubvolumes);
+
+    QCOMPARE(snapshotsTokenizer(snapshots), snapshotsSplit(snapshots));
+}
+
+void TokenizerBenchmark::filesystemUsageSplit() {
+    QBENCHMARK {
+        usageSplit(usage);
+    }
+}
+
+void TokenizerBenchmark::filesystemUsageTokenizer() {
+    QBENCHMARK {
+        usageTokenizer(usage);
+    }
+}
+
+void TokenizerBenchmark::subvolumeListSplit() {
+    QBENCHMARK {
+        subvolumesSplit(subvolumes);
+    }
+}
+
+void TokenizerBenchmark::subvolumeListTokenizer() {
+    QBENCHMARK {
+        subvolumesTokenizer(subvolumes);
+    }
+}
+
+void TokenizerBenchmark::snapperListSplit() {
+    QBENCHMARK {
+        snapshotsSplit(snapshots);
+    }
+}
+
+void TokenizerBenchmark::snapperListTokenizer() {
+    QBENCHMARK {
+        snapshotsTokenizer(snapshots);
+    }
+}
+
+QTEST_GUILESS_MAIN(TokenizerBenchmark)
+
+#include "tokenizerbenchmark.moc"
@@ -0,0 +1,156 @@
+#ifndef TOKENIZER_H
+#define TOKENIZER_H
+
+#include <QByteArray>
+#include <QFile>
+#include <QString>
+
+#include <charconv>
+#include <string_view>
+
+/*
+ *
+ * Allocation free helpers for parsing command output.
+ *
+ * All functions operate on views into the raw QByteArray returned by a process so a line can be split into fields
+ * without creating any intermediate QStringList or QString objects.  Only the final values that are stored are
+ * converted using toQString() or toLong().
+ *
+ */
+
+// Returns a view over the full contents of @p data.  @p data must outlive the view
+inline std::string_view toView(const QByteArray &data) { return std::string_view(data.constData(), data.size()); }
+
+// Converts a view to a QString, this is the only place where the parsers allocate
+inline QString toQString(std::string_view view) { return QString::fromUtf8(view.data(), static_cast<int>(view.size())); }
+
+// Returns @p view with leading and trailing whitespace removed
+inline std::string_view trimmed(std::string_view view) {
+    const std::string_view whitespace = " \t\r\n\v\f";
+    const size_t start = view.find_first_not_of(whitespace);
+    if (start == std::string_view::npos)
+        return std::string_view();
+
+    const size_t end = view.find_last_not_of(whitespace);
+    return view.substr(start, end - start + 1);
+}
+
+// Returns the field at @p index when @p line is split on @p separator, or an empty view if there aren't enough fields
+inline std::string_view field(std::string_view line, char separator, int index) {
+    size_t start = 0;
+    for (int i = 0; i < index; i++) {
+        const size_t pos = line.find(separator, start);
+        if (pos == std::string_view::npos)
+            return std::string_view();
+        start = pos + 1;
+    }
+
+    const size_t end = line.find(separator, start);
+    return line.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+}
+
+// Returns everything from the field at @p index to the end of the line.  Used for a last column which may contain @p separator
+inline std::string_view fieldsFrom(std::string_view line, char separator, int index) {
+    size_t start = 0;
+    for (int i = 0; i < index; i++) {
+        const size_t pos = line.find(separator, start);
+        if (pos == std::string_view::npos)
+            return std::string_view();
+        start = pos + 1;
+    }
+
+    return line.substr(start);
+}
+
+// Returns the whitespace separated word at @p index, runs of whitespace are treated as a single separator like awk does
+inline std::string_view word(std::string_view line, int index) {
+    const std::string_view whitespace = " \t";
+    size_t start = line.find_first_not_of(whitespace);
+    for (int i = 0; i < index && start != std::string_view::npos; i++) {
+        const size_t end = line.find_first_of(whitespace, start);
+        if (end == std::string_view::npos)
+            return std::string_view();
+        start = line.find_first_not_of(whitespace, end);
+    }
+
+    if (start == std::string_view::npos)
+        return std::string_view();
+
+    const size_t end = line.find_first_of(whitespace, start);
+    return line.substr(start, end == std::string_view::npos ? std::string_view::npos : end - start);
+}
+
+// Returns everything from the word at @p index to the end of the line.  Used for trailing values which may contain spaces
+inline std::string_view wordsFrom(std::string_view line, int index) {
+    const std::string_view first = word(line, index);
+    if (first.empty())
+        return std::string_view();
+
+    return trimmed(line.substr(first.data() - line.data()));
+}
+
+// Parses a leading integer from @p view, returns @p defaultValue when there isn't one
+inline long toLong(std::string_view view, long defaultValue = 0) {
+    view = trimmed(view);
+    long value = defaultValue;
+    if (std::from_chars(view.data(), view.data() + view.size(), value).ec != std::errc())
+        return defaultValue;
+
+    return value;
+}
+
+// Decodes the octal escapes /proc/self/mountinfo uses for spaces and other special characters in paths
+inline QString unescapeMountPath(std::string_view path) {
+    QByteArray decoded;
+    for (size_t i = 0; i < path.size(); i++) {
+        if (path[i] == '\\' && i + 3 < path.size()) {
+            decoded += static_cast<char>((path[i + 1] - '0') * 64 + (path[i + 2] - '0') * 8 + (path[i + 3] - '0'));
+            i += 3;
+        } else {
+            decoded += path[i];
+        }
+    }
+
+    return QFile::decodeName(decoded);
+}
+
+// Iterates over the lines in a block of command output without copying them
+class LineTokenizer {
+  public:
+    explicit LineTokenizer(std::string_view data) : data(data) {}
+    explicit LineTokenizer(const QByteArray &data) : data(toView(data)) {}
+
+    // Sets @p line to the next line and returns true, or returns false when the output is exhausted
+    bool next(std::string_view &line) {
+        if (pos >= data.size())
+            return false;
+
+        const size_t end = data.find('\n', pos);
+        if (end == std::string_view::npos) {
+            line = data.substr(pos);
+            pos = data.size();
+        } else {
+            line = data.substr(pos, end - pos);
+            pos = end + 1;
+        }
+
+        // Handle CRLF output
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+
+        return true;
+    }
+
+    // Skips the next @p count lines, the equivalent of piping through tail -n +(count + 1)
+    void skip(int count) {
+        std::string_view unused;
+        for (int i = 0; i < count && next(unused); i++) {
+        }
+    }
+
+  private:
+    std::string_view data;
+    size_t pos = 0;
+};
+
+#endif // TOKENIZER_H
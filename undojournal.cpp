@@ -0,0 +1,390 @@
+#include "undojournal.h"
+#include "btrfsioctl.h"
+#include "shellconfig.h"
+
+#include <QDataStream>
+#include <QDateTime>
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QProcess>
+#include <QSaveFile>
+
+// The directory of the top level subvolume the safety snapshots are kept in, one directory per operation
+static const QString safetyDir = ".btrfs-assistant-undo";
+
+// Bumped whenever the layout of the journal changes
+static const quint32 journalVersion = 1;
+
+static QDataStream &operator<<(QDataStream &stream, const UndoEntry &entry) {
+    return stream << entry.id << qint32(entry.kind) << entry.uuid << entry.subvolume << entry.name << entry.backup << entry.children
+                  << entry.config << entry.snapshots;
+}
+
+static QDataStream &operator>>(QDataStream &stream, UndoEntry &entry) {
+    qint32 kind = 0;
+    stream >> entry.id >> kind >> entry.uuid >> entry.subvolume >> entry.name >> entry.backup >> entry.children >> entry.config >>
+        entry.snapshots;
+    entry.kind = UndoEntry::Kind(kind);
+    return stream;
+}
+
+bool UndoJournal::load() {
+    journal.clear();
+    readable = true;
+    QFile file(path);
+    if (!file.exists())
+        return true;
+
+    readable = false;
+    if (!file.open(QIODevice::ReadOnly))
+        return false;
+
+    QDataStream stream(&file);
+    quint32 version = 0;
+    stream >> version;
+    if (version != journalVersion)
+        return false;
+
+    QVector<UndoEntry> entries;
+    while (!stream.atEnd()) {
+        UndoEntry entry;
+        stream >> entry;
+        if (stream.status() != QDataStream::Ok)
+            return false;
+        entries.append(entry);
+    }
+
+    journal = entries;
+    readable = true;
+    return true;
+}
+
+bool UndoJournal::save(QString &error) const {
+    // Saving would replace the entries that couldn't be read, their safety snapshots would be left behind for good
+    if (!readable) {
+        error = QObject::tr("The undo history %1 can't be read").arg(path);
+        return false;
+    }
+
+    QDir().mkpath(QFileInfo(path).absolutePath());
+    QSaveFile file(path);
+    if (!file.open(QIODevice::WriteOnly)) {
+        error = file.errorString();
+        return false;
+    }
+
+    QDataStream stream(&file);
+    stream << journalVersion;
+    for (const UndoEntry &entry : journal)
+        stream << entry;
+
+    if (!file.commit()) {
+        error = file.errorString();
+        return false;
+    }
+
+    return true;
+}
+
+// Reads the journal again, entries may have been pruned by another process since it was last read
+bool UndoJournal::reload(QString &error) {
+    if (load())
+        return true;
+
+    error = QObject::tr("The undo history %1 can't be read").arg(path);
+    return false;
+}
+
+bool UndoJournal::append(const UndoEntry &entry, QString &error) {
+    if (!reload(error))
+        return false;
+
+    journal.append(entry);
+    if (save(error))
+        return true;
+
+    journal.removeLast();
+    return false;
+}
+
+// Creates the directory for the safety snapshots of @p entry, only root can look inside
+static bool makeSafetySnapshotDir(const QString &topLevel, const UndoEntry &entry, QString &error) {
+    const QString dir = safetySnapshotDir(topLevel, entry);
+    if (!QDir().mkpath(dir)) {
+        error = QObject::tr("Failed to create %1").arg(dir);
+        return false;
+    }
+    QFile::setPermissions(QDir::cleanPath(topLevel + "/" + safetyDir), QFile::ReadOwner | QFile::WriteOwner | QFile::ExeOwner);
+
+    return true;
+}
+
+bool UndoJournal::recordSubvolumeDelete(const QString &topLevel, const QString &uuid, const QString &subvolume, QString &error) {
+    UndoEntry entry;
+    entry.id = QDateTime::currentMSecsSinceEpoch();
+    entry.kind = UndoEntry::DeleteSubvolume;
+    entry.uuid = uuid;
+    entry.subvolume = subvolume;
+    if (!makeSafetySnapshotDir(topLevel, entry, error))
+        return false;
+
+    const QString dir = safetySnapshotDir(topLevel, entry);
+    if (!createSnapshot(QDir::cleanPath(topLevel + "/" + subvolume), dir + "/subvolume", true)) {
+        error = QObject::tr("Failed to create a safety snapshot of %1").arg(subvolume);
+        QDir().rmdir(dir);
+        return false;
+    }
+
+    if (!append(entry, error)) {
+        pruneSafetySnapshots(topLevel, entry);
+        return false;
+    }
+
+    return true;
+}
+
+bool UndoJournal::recordConfigDelete(const QString &topLevel, const QString &uuid, const QString &name, QString &error) {
+    QFile configFile(snapperConfigPath(name));
+    ShellConfig config;
+    if (!configFile.open(QIODevice::ReadOnly)) {
+        error = QObject::tr("Failed to read the config %1").arg(name);
+        return false;
+    }
+
+    UndoEntry entry;
+    entry.id = QDateTime::currentMSecsSinceEpoch();
+    entry.kind = UndoEntry::DeleteSnapperConfig;
+    entry.uuid = uuid;
+    entry.name = name;
+    entry.config = configFile.readAll();
+    config.parse(entry.config);
+    entry.subvolume = config.value("SUBVOLUME");
+    if (!makeSafetySnapshotDir(topLevel, entry, error))
+        return false;
+
+    // Snapshots of snapshots, the info.xml next to each one is copied so snapper lists them again after an undo
+    const QString dir = safetySnapshotDir(topLevel, entry);
+    const QString snapshotsDir = QDir::cleanPath(entry.subvolume + "/.snapshots");
+    const QStringList numbers = QDir(snapshotsDir).entryList(QDir::Dirs | QDir::NoDotAndDotDot);
+    for (const QString &number : numbers) {
+        bool isNumber = false;
+        number.toUInt(&isNumber);
+        const QString snapshot = snapshotsDir + "/" + number + "/snapshot";
+        if (!isNumber || !isSubvolume(snapshot))
+            continue;
+
+        if (!createSnapshot(snapshot, dir + "/" + number, true) ||
+            !QFile::copy(snapshotsDir + "/" + number + "/info.xml", dir + "/" + number + ".xml")) {
+            error = QObject::tr("Failed to create a safety snapshot of %1").arg(snapshot);
+            pruneSafetySnapshots(topLevel, entry);
+            return false;
+        }
+        entry.snapshots.append(number);
+    }
+
+    if (!append(entry, error)) {
+        pruneSafetySnapshots(topLevel, entry);
+        return false;
+    }
+
+    return true;
+}
+
+bool UndoJournal::recordRestore(const QString &uuid, const QString &target, const QString &backup, const QStringList &children,
+                                QString &error) {
+    UndoEntry entry;
+    entry.id = QDateTime::currentMSecsSinceEpoch();
+    entry.kind = UndoEntry::RestoreSnapshot;
+    entry.uuid = uuid;
+    entry.subvolume = target;
+    entry.backup = backup;
+    entry.children = children;
+    return append(entry, error);
+}
+
+// Puts the subvolume deleted by @p entry back from its safety snapshot
+static bool undoSubvolumeDelete(const QString &topLevel, const UndoEntry &entry, QString &error) {
+    const QString path = QDir::cleanPath(topLevel + "/" + entry.subvolume);
+    if (QFileInfo::exists(path)) {
+        error = QObject::tr("%1 exists already").arg(entry.subvolume);
+        return false;
+    }
+
+    if (!createSnapshot(safetySnapshotDir(topLevel, entry) + "/subvolume", path, false)) {
+        error = QObject::tr("Failed to recreate %1").arg(entry.subvolume);
+        return false;
+    }
+
+    return true;
+}
+
+// Creates the snapper config deleted by @p entry again and puts its snapshots back
+static bool undoConfigDelete(const QString &topLevel, const UndoEntry &entry, QString &error) {
+    if (QFile::exists(snapperConfigPath(entry.name))) {
+        error = QObject::tr("A config named %1 exists already").arg(entry.name);
+        return false;
+    }
+
+    // Snapper registers the config and creates the .snapshots subvolume, the settings are replaced by the saved ones after
+    if (QProcess::execute("snapper", {"-c", entry.name, "create-config", entry.subvolume}) != 0) {
+        error = QObject::tr("Failed to create the config %1").arg(entry.name);
+        return false;
+    }
+
+    QSaveFile configFile(snapperConfigPath(entry.name));
+    if (!configFile.open(QIODevice::WriteOnly) || configFile.write(entry.config) != entry.config.size() || !configFile.commit()) {
+        error = QObject::tr("Failed to write the config %1").arg(entry.name);
+        return false;
+    }
+
+    const QString dir = safetySnapshotDir(topLevel, entry);
+    const QString snapshotsDir = QDir::cleanPath(entry.subvolume + "/.snapshots");
+    QStringList failed;
+    for (const QString &number : entry.snapshots) {
+        const QString snapshotDir = snapshotsDir + "/" + number;
+        if (!QDir().mkpath(snapshotDir) || !QFile::copy(dir + "/" + number + ".xml", snapshotDir + "/info.xml") ||
+            !createSnapshot(dir + "/" + number, snapshotDir + "/snapshot", true))
+            failed.append(number);
+    }
+
+    if (!failed.isEmpty()) {
+        error = QObject::tr("Failed to restore the snapshots %1").arg(failed.join(", "));
+        return false;
+    }
+
+    return true;
+}
+
+// Puts the subvolume replaced by the restore of @p entry back.  The restored subvolume is kept next to it like the backup
+// of a restore, it may have been used since
+static bool undoRestore(const QString &topLevel, const UndoEntry &entry, QString &error) {
+    const auto path = [&topLevel](const QString &subvolume) { return QDir::cleanPath(topLevel + "/" + subvolume); };
+    QDir dir;
+
+    if (!isSubvolume(path(entry.backup))) {
+        error = QObject::tr("The backup %1 is gone").arg(entry.backup);
+        return false;
+    }
+
+    // Move the nested subvolumes back into the original first, they'd be moved away with the restored subvolume otherwise
+    for (const QString &child : entry.children) {
+        const QString childPath = child.startsWith(entry.subvolume + "/") ? child.mid(entry.subvolume.length() + 1) : child;
+        if (!dir.rename(path(entry.subvolume + "/" + childPath), path(entry.backup + "/" + childPath))) {
+            error = QObject::tr("Failed to move %1 back").arg(child);
+            return false;
+        }
+    }
+
+    const QString undone = "restore_undone_" + entry.subvolume + "_" + QDateTime::currentDateTime().toString("yyyyMMddHHmmss");
+    if (!dir.rename(path(entry.subvolume), path(undone))) {
+        error = QObject::tr("Failed to move %1 aside").arg(entry.subvolume);
+        return false;
+    }
+
+    if (!dir.rename(path(entry.backup), path(entry.subvolume))) {
+        dir.rename(path(undone), path(entry.subvolume));
+        error = QObject::tr("Failed to move %1 back to %2").arg(entry.backup, entry.subvolume);
+        return false;
+    }
+
+    return true;
+}
+
+int UndoJournal::indexOf(qint64 id) const {
+    for (int i = 0; i < journal.size(); i++) {
+        if (journal.at(i).id == id)
+            return i;
+    }
+
+    return -1;
+}
+
+bool UndoJournal::undo(qint64 id, const QString &topLevel, QString &error) {
+    if (!reload(error))
+        return false;
+
+    const int index = indexOf(id);
+    if (index < 0) {
+        error = QObject::tr("The operation is no longer in the undo history");
+        return false;
+    }
+
+    const UndoEntry entry = journal.at(index);
+    bool ok = false;
+    switch (entry.kind) {
+    case UndoEntry::DeleteSubvolume:
+        ok = undoSubvolumeDelete(topLevel, entry, error);
+        break;
+    case UndoEntry::DeleteSnapperConfig:
+        ok = undoConfigDelete(topLevel, entry, error);
+        break;
+    case UndoEntry::RestoreSnapshot:
+        ok = undoRestore(topLevel, entry, error);
+        break;
+    }
+    if (!ok)
+        return false;
+
+    journal.remove(index);
+    pruneSafetySnapshots(topLevel, entry);
+    return save(error);
+}
+
+void UndoJournal::discard(qint64 id, const QString &topLevel) {
+    QString error;
+    const int index = reload(error) ? indexOf(id) : -1;
+    if (index < 0)
+        return;
+
+    pruneSafetySnapshots(topLevel, journal.takeAt(index));
+    save(error);
+}
+
+QVector<UndoEntry> UndoJournal::expired(qint64 retentionSeconds) const {
+    const qint64 cutoff = QDateTime::currentMSecsSinceEpoch() - retentionSeconds * 1000;
+    QVector<UndoEntry> entries;
+    for (const UndoEntry &entry : journal) {
+        if (entry.id < cutoff)
+            entries.append(entry);
+    }
+
+    return entries;
+}
+
+void UndoJournal::remove(const QList<qint64> &ids) {
+    QString error;
+    if (ids.isEmpty() || !reload(error))
+        return;
+
+    QVector<UndoEntry> kept;
+    for (const UndoEntry &entry : qAsConst(journal)) {
+        if (!ids.contains(entry.id))
+            kept.append(entry);
+    }
+
+    journal = kept;
+    save(error);
+}
+
+QString safetySnapshotDir(const QString &topLevel, const UndoEntry &entry) {
+    return QDir::cleanPath(topLevel + "/" + safetyDir + "/" + QString::number(entry.id));
+}
+
+bool isSafetySnapshot(const QString &subvolume) { return subvolume.startsWith(safetyDir + "/"); }
+
+void pruneSafetySnapshots(const QString &topLevel, const UndoEntry &entry) {
+    // A restore keeps no safety snapshots, its backup is left to the user like that of any other restore
+    if (entry.kind == UndoEntry::RestoreSnapshot)
+        return;
+
+    const QString dir = safetySnapshotDir(topLevel, entry);
+    const QFileInfoList contents = QDir(dir).entryInfoList(QDir::AllEntries | QDir::NoDotAndDotDot | QDir::Hidden | QDir::System);
+    for (const QFileInfo &info : contents) {
+        if (isSubvolume(info.filePath()))
+            deleteSubvolume(info.filePath());
+        else
+            QFile::remove(info.filePath());
+    }
+    QDir().rmdir(dir);
+}
@@ -0,0 +1,100 @@
+#ifndef UNDOJOURNAL_H
+#define UNDOJOURNAL_H
+
+#include <QByteArray>
+#include <QString>
+#include <QStringList>
+#include <QVector>
+
+// Where the application and the pruning of btrfs-assistant-helper keep the journal
+static const QString undoJournalPath = "/var/lib/btrfs-assistant/undo.journal";
+
+// A destructive operation that can be undone
+struct UndoEntry {
+    enum Kind : qint32 {
+        DeleteSubvolume,
+        DeleteSnapperConfig,
+        RestoreSnapshot,
+    };
+
+    // When the operation was done, in milliseconds since the epoch.  It also names the directory of its safety snapshots
+    qint64 id = 0;
+    Kind kind = DeleteSubvolume;
+    QString uuid;
+    // The deleted subvolume or the restore target, as a path from the top level.  For a snapper config, the mountpoint of
+    // the subvolume it was for
+    QString subvolume;
+    // The name of the snapper config
+    QString name;
+    // The subvolume the restore target was moved to
+    QString backup;
+    // The subvolumes which were moved from the backup into the restored subvolume
+    QStringList children;
+    // The contents of the snapper config file and the numbers of its snapshots
+    QByteArray config;
+    QStringList snapshots;
+};
+
+// Keeps a journal of destructive operations so they can be undone for a while afterwards.
+//
+// Before a subvolume or a snapper config is deleted the subvolumes are snapshotted read-only into a directory of the top
+// level subvolume.  The snapshots are instant and take no space until the originals are gone, so the operation can be
+// undone by snapshotting them back.  A restore already keeps the original subvolume as its backup and is undone by moving
+// it back.  The journal itself is a small file listing the operations.  The safety snapshots of the entries older than the
+// retention time are deleted with pruneSafetySnapshots(), which can run in the background, and the entries are removed
+// once that is under way.  A timer prunes them from another process too, so the file is read again before every change.
+// A journal that can't be read is never written, so nothing it still lists is lost.
+class UndoJournal {
+  public:
+    explicit UndoJournal(const QString &path) : path(path) {}
+
+    // Reads the journal, a missing file is an empty journal.  Returns false if it can't be read, nothing can be recorded
+    // then
+    bool load();
+
+    const QVector<UndoEntry> &entries() const { return journal; }
+
+    // Snapshots the subvolume @p subvolume of the filesystem @p uuid, whose top level is mounted at @p topLevel, before it
+    // is deleted.  Returns false and sets @p error on failure, the subvolume shouldn't be deleted then
+    bool recordSubvolumeDelete(const QString &topLevel, const QString &uuid, const QString &subvolume, QString &error);
+
+    // Saves the snapper config @p name and snapshots its snapshots before the config is deleted
+    bool recordConfigDelete(const QString &topLevel, const QString &uuid, const QString &name, QString &error);
+
+    // Records a restore of @p target which moved it to @p backup and @p children from @p backup into the restored subvolume
+    bool recordRestore(const QString &uuid, const QString &target, const QString &backup, const QStringList &children, QString &error);
+
+    // Undoes the operation @p id and removes it from the journal
+    bool undo(qint64 id, const QString &topLevel, QString &error);
+
+    // Removes the operation @p id from the journal and deletes its safety snapshots, for when the operation itself failed
+    void discard(qint64 id, const QString &topLevel);
+
+    // Returns the entries older than @p retentionSeconds
+    QVector<UndoEntry> expired(qint64 retentionSeconds) const;
+
+    // Removes the operations @p ids from the journal without touching their safety snapshots
+    void remove(const QList<qint64> &ids);
+
+  private:
+    bool reload(QString &error);
+    bool append(const UndoEntry &entry, QString &error);
+    int indexOf(qint64 id) const;
+    bool save(QString &error) const;
+
+    QString path;
+    QVector<UndoEntry> journal;
+    // Cleared when the file exists but can't be read
+    bool readable = true;
+};
+
+// Returns the directory in the top level mounted at @p topLevel holding the safety snapshots of @p entry
+QString safetySnapshotDir(const QString &topLevel, const UndoEntry &entry);
+
+// Returns true if the path from the top level @p subvolume is a safety snapshot
+bool isSafetySnapshot(const QString &subvolume);
+
+// Deletes the safety snapshots of @p entry.  Requires root
+void pruneSafetySnapshots(const QString &topLevel, const UndoEntry &entry);
+
+#endif // UNDOJOURNAL_H
@@ -0,0 +1,125 @@
+#include "usagehistory.h"
+
+#include <QFile>
+
+#include <cerrno>
+#include <fcntl.h>
+#include <unistd.h>
+
+static const quint32 historyMagic = 0x48554142; // "BAUH"
+static const quint32 historyVersion = 1;
+
+// A trend fitted to less history than this is mostly noise
+static const qint64 minimumSpan = 3600;
+static const int minimumSamples = 6;
+
+bool UsageHistory::load() {
+    history.clear();
+
+    const int fd = open(QFile::encodeName(path).constData(), O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return errno == ENOENT;
+
+    Header stored = {};
+    if (pread(fd, &stored, sizeof(stored), 0) == sizeof(stored) && stored.magic == historyMagic && stored.version == historyVersion &&
+        stored.capacity == capacity && stored.next < capacity && stored.count <= capacity) {
+        QVector<UsageSample> slots(capacity);
+        const ssize_t size = capacity * sizeof(UsageSample);
+        if (pread(fd, slots.data(), size, sizeof(Header)) == size) {
+            header = stored;
+
+            // The oldest sample is at next once the buffer has wrapped
+            const quint32 first = header.count < capacity ? 0 : header.next;
+            history.reserve(header.count);
+            for (quint32 i = 0; i < header.count; i++)
+                history.append(slots.at((first + i) % capacity));
+        }
+    }
+
+    close(fd);
+    return true;
+}
+
+bool UsageHistory::writeHeader(int fd) { return pwrite(fd, &header, sizeof(header), 0) == sizeof(header); }
+
+bool UsageHistory::append(const UsageSample &sample) {
+    const int fd = open(QFile::encodeName(path).constData(), O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    // Start a new file, or a fresh one if the stored history is from an incompatible version
+    if (header.magic != historyMagic) {
+        header = {historyMagic, historyVersion, capacity, 0, 0, 0, 0, 0};
+        if (ftruncate(fd, sizeof(Header) + capacity * sizeof(UsageSample)) != 0) {
+            close(fd);
+            return false;
+        }
+    }
+
+    bool ok = pwrite(fd, &sample, sizeof(sample), sizeof(Header) + header.next * sizeof(UsageSample)) == sizeof(sample);
+    if (ok) {
+        header.next = (header.next + 1) % capacity;
+        header.count = qMin(header.count + 1, capacity);
+        ok = writeHeader(fd);
+    }
+
+    if (ok) {
+        if (history.size() >= static_cast<int>(capacity))
+            history.removeFirst();
+        history.append(sample);
+    }
+
+    close(fd);
+    return ok;
+}
+
+bool UsageHistory::setLastAlert(bool metadata, qint64 time) {
+    if (header.magic != historyMagic)
+        return false;
+
+    (metadata ? header.lastMetadataAlert : header.lastDataAlert) = time;
+
+    const int fd = open(QFile::encodeName(path).constData(), O_WRONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    const bool ok = writeHeader(fd);
+    close(fd);
+    return ok;
+}
+
+qint64 secondsUntilFull(const QVector<UsageSample> &samples, quint64 UsageSample::*field, qint64 window) {
+    if (samples.isEmpty())
+        return -1;
+
+    // Least squares over the window, times are relative to the newest sample to keep the sums small
+    const qint64 now = samples.last().time;
+    double sumT = 0, sumY = 0, sumTT = 0, sumTY = 0;
+    int count = 0;
+    qint64 oldest = now;
+    for (const UsageSample &sample : samples) {
+        if (sample.time < now - window)
+            continue;
+
+        const double t = sample.time - now;
+        const double y = sample.*field;
+        sumT += t;
+        sumY += y;
+        sumTT += t * t;
+        sumTY += t * y;
+        oldest = qMin(oldest, sample.time);
+        count++;
+    }
+
+    const double denominator = count * sumTT - sumT * sumT;
+    if (count < minimumSamples || now - oldest < minimumSpan || denominator <= 0)
+        return -1;
+
+    // The slope is in bytes per second, the intercept is the fitted free space now
+    const double slope = (count * sumTY - sumT * sumY) / denominator;
+    const double intercept = (sumY - slope * sumT) / count;
+    if (slope >= 0)
+        return -1;
+
+    return intercept <= 0 ? 0 : static_cast<qint64>(intercept / -slope);
+}
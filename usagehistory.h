@@ -0,0 +1,57 @@
+#ifndef USAGEHISTORY_H
+#define USAGEHISTORY_H
+
+#include <QString>
+#include <QVector>
+
+// The free space of a filesystem at one point in time, in bytes
+struct UsageSample {
+    qint64 time;
+    quint64 dataFree;
+    quint64 metadataFree;
+};
+
+// A fixed size ring buffer of usage samples kept in a file.  Appending a sample rewrites only the header and a single
+// slot so sampling every few minutes costs a couple of small writes and the file never grows.
+class UsageHistory {
+  public:
+    explicit UsageHistory(const QString &path, quint32 capacity = 2016) : path(path), capacity(capacity) {}
+
+    // Reads the history, a missing or damaged file is treated as empty.  Returns false if the file can't be opened
+    bool load();
+
+    // Adds @p sample, overwriting the oldest sample when the buffer is full.  Returns false on failure
+    bool append(const UsageSample &sample);
+
+    // The samples oldest first
+    const QVector<UsageSample> &samples() const { return history; }
+
+    // The time of the last alert for data or metadata, used to avoid repeating the same notification
+    qint64 lastAlert(bool metadata) const { return metadata ? header.lastMetadataAlert : header.lastDataAlert; }
+    bool setLastAlert(bool metadata, qint64 time);
+
+  private:
+    struct Header {
+        quint32 magic;
+        quint32 version;
+        quint32 capacity;
+        quint32 next;
+        quint32 count;
+        quint32 reserved;
+        qint64 lastDataAlert;
+        qint64 lastMetadataAlert;
+    };
+
+    bool writeHeader(int fd);
+
+    QString path;
+    quint32 capacity;
+    Header header = {};
+    QVector<UsageSample> history;
+};
+
+// Fits a line through the samples of the last @p window seconds using @p field and returns the number of seconds until
+// it reaches zero.  Returns -1 when the free space isn't shrinking or there isn't enough history to tell
+qint64 secondsUntilFull(const QVector<UsageSample> &samples, quint64 UsageSample::*field, qint64 window);
+
+#endif // USAGEHISTORY_H